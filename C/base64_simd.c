@@ -0,0 +1,159 @@
+// base64_simd.c
+#include "base64_simd.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+#endif
+
+/*
+ *  AVX2 decoding follows Muła & Lemire, "Faster Base64 Encoding and Decoding
+ *  using AVX2 Instructions": 32 characters are validated and translated with
+ *  three pshufb nibble lookups, then packed 4x6 -> 3x8 bits with
+ *  maddubs/madd and one shuffle + permute. NEON deinterleaves 64 characters
+ *  with vld4 and re-packs with vst3. Everything else goes through the scalar
+ *  table, which also handles tails and padding.
+ */
+
+static const uint8_t dec_table[256] = {
+#define X 0xFF
+  X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X, X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,
+  X,X,X,X,X,X,X,X,X,X,X,62,X,X,X,63, 52,53,54,55,56,57,58,59,60,61,X,X,X,X,X,X,
+  X,0,1,2,3,4,5,6,7,8,9,10,11,12,13,14, 15,16,17,18,19,20,21,22,23,24,25,X,X,X,X,X,
+  X,26,27,28,29,30,31,32,33,34,35,36,37,38,39,40, 41,42,43,44,45,46,47,48,49,50,51,X,X,X,X,X,
+  X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X, X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,
+  X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X, X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,
+  X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X, X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,
+  X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X, X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,X,
+#undef X
+};
+
+size_t b64_decoded_len(const char *in, size_t len){
+  while(len && in[len-1] == '=') len--;
+  return len / 4 * 3 + (len % 4 ? len % 4 - 1 : 0);
+}
+
+#if defined(__AVX2__)
+
+// Translate + pack 32 chars into 24 bytes (written as 32, last 8 garbage).
+// Returns 0 if any character is outside the base64 alphabet.
+static inline int dec32_avx2(const char *in, uint8_t *out){
+  const __m256i lut_lo = _mm256_setr_epi8(
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+  __m256i v   = _mm256_loadu_si256((const __m256i*)in);
+  __m256i hin = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+  __m256i lo  = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(v, mask_2f));
+  __m256i hi  = _mm256_shuffle_epi8(lut_hi, hin);
+  if(!_mm256_testz_si256(lo, hi)) return 0;
+
+  __m256i eq_2f = _mm256_cmpeq_epi8(v, mask_2f);
+  __m256i roll  = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hin));
+  v = _mm256_add_epi8(v, roll);
+
+  // 00aaaaaa 00bbbbbb 00cccccc 00dddddd -> aaaaaabb bbbbcccc ccdddddd
+  v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+  v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+  v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+  _mm256_storeu_si256((__m256i*)out, v);
+  return 1;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static inline uint8x16_t translate_neon(uint8x16_t c, uint8x16_t *bad){
+  uint8x16_t up  = vsubq_u8(c, vdupq_n_u8('A'));
+  uint8x16_t low = vsubq_u8(c, vdupq_n_u8('a' - 26));
+  uint8x16_t dig = vaddq_u8(c, vdupq_n_u8(52 - '0'));
+  uint8x16_t r   = vdupq_n_u8(0xFF);
+  r = vbslq_u8(vcleq_u8(vsubq_u8(c, vdupq_n_u8('A')), vdupq_n_u8(25)), up, r);
+  r = vbslq_u8(vcleq_u8(vsubq_u8(c, vdupq_n_u8('a')), vdupq_n_u8(25)), low, r);
+  r = vbslq_u8(vcleq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(9)), dig, r);
+  r = vbslq_u8(vceqq_u8(c, vdupq_n_u8('+')), vdupq_n_u8(62), r);
+  r = vbslq_u8(vceqq_u8(c, vdupq_n_u8('/')), vdupq_n_u8(63), r);
+  *bad = vorrq_u8(*bad, vcgtq_u8(r, vdupq_n_u8(63)));
+  return r;
+}
+
+// Translate + pack 64 chars into 48 bytes. Returns 0 on an invalid char.
+static inline int dec64_neon(const char *in, uint8_t *out){
+  uint8x16x4_t c = vld4q_u8((const uint8_t*)in);
+  uint8x16_t bad = vdupq_n_u8(0);
+  uint8x16_t a = translate_neon(c.val[0], &bad);
+  uint8x16_t b = translate_neon(c.val[1], &bad);
+  uint8x16_t d = translate_neon(c.val[2], &bad);
+  uint8x16_t e = translate_neon(c.val[3], &bad);
+  if(vmaxvq_u8(bad)) return 0;
+  uint8x16x3_t o;
+  o.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+  o.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(d, 2));
+  o.val[2] = vorrq_u8(vshlq_n_u8(d, 6), e);
+  vst3q_u8(out, o);
+  return 1;
+}
+
+#endif
+
+int64_t b64_decode(const char *in, size_t len, uint8_t *out, size_t cap){
+  size_t need = b64_decoded_len(in, len);
+  if(need > cap) return -1;
+  while(len && in[len-1] == '=') len--;
+  if(len % 4 == 1) return -1;
+
+  size_t i = 0, o = 0;
+#if defined(__AVX2__)
+  // each step writes 32 bytes for 24 decoded: keep 8 bytes of headroom
+  while(len - i >= 32 && cap - o >= 32){
+    if(!dec32_avx2(in + i, out + o)) return -1;
+    i += 32; o += 24;
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  while(len - i >= 64 && cap - o >= 48){
+    if(!dec64_neon(in + i, out + o)) return -1;
+    i += 64; o += 48;
+  }
+#endif
+  for(; len - i >= 4; i += 4){
+    uint8_t a = dec_table[(uint8_t)in[i]],   b = dec_table[(uint8_t)in[i+1]];
+    uint8_t c = dec_table[(uint8_t)in[i+2]], d = dec_table[(uint8_t)in[i+3]];
+    if((a | b | c | d) & 0x80) return -1;
+    out[o++] = (uint8_t)(a << 2 | b >> 4);
+    out[o++] = (uint8_t)(b << 4 | c >> 2);
+    out[o++] = (uint8_t)(c << 6 | d);
+  }
+  if(len - i >= 2){
+    uint8_t a = dec_table[(uint8_t)in[i]], b = dec_table[(uint8_t)in[i+1]];
+    if((a | b) & 0x80) return -1;
+    out[o++] = (uint8_t)(a << 2 | b >> 4);
+    if(len - i == 3){
+      uint8_t c = dec_table[(uint8_t)in[i+2]];
+      if(c & 0x80) return -1;
+      out[o++] = (uint8_t)(b << 4 | c >> 2);
+    }
+  }
+  return (int64_t)o;
+}
+
+int b64_decode_floats(const char *in, size_t len, float *out, uint32_t cap){
+  size_t bytes = b64_decoded_len(in, len);
+  if(bytes % 4 || bytes / 4 > cap) return -1;
+  if(b64_decode(in, len, (uint8_t*)out, bytes) != (int64_t)bytes) return -1;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  uint32_t *u = (uint32_t*)out;
+  for(size_t i = 0; i < bytes / 4; i++) u[i] = __builtin_bswap32(u[i]);
+#endif
+  return (int)(bytes / 4);
+}
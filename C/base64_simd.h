@@ -0,0 +1,17 @@
+// base64_simd.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the decoded data for `len` base64 characters (padding included).
+size_t b64_decoded_len(const char *in, size_t len);
+
+// Decode standard base64 ('=' padding optional) into out[cap]. Returns the
+// number of bytes written, or -1 on an invalid character or when the
+// output does not fit.
+int64_t b64_decode(const char *in, size_t len, uint8_t *out, size_t cap);
+
+// Decode a base64 string of little-endian float32 values (what
+// OpenAI-compatible servers send for encoding_format: "base64") straight
+// into out[cap]. Returns the number of floats, or -1.
+int b64_decode_floats(const char *in, size_t len, float *out, uint32_t cap);
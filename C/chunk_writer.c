@@ -0,0 +1,209 @@
+// chunk_writer.c
+#include "chunk_writer.h"
+#include "chunks.h"
+#include "content_hash.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct ChunkWriter {
+  int      fd;
+  char    *path;
+  char    *model;
+  uint8_t *buf;
+  size_t   cap, len;
+  uint64_t offset;          // bytes on disk
+  uint32_t count, dim;
+  int      id_hash;         // CW_ID_*
+};
+
+static char g_err[512];
+
+static void set_err(const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(g_err, sizeof g_err, fmt, ap);
+  va_end(ap);
+}
+
+const char* cw_error(void){ return g_err; }
+
+static int write_all(int fd, const void *p, size_t n){
+  const uint8_t *s = p;
+  while(n){
+    ssize_t w = write(fd, s, n);
+    if(w < 0){ if(errno == EINTR) continue; return -1; }
+    s += w; n -= (size_t)w;
+  }
+  return 0;
+}
+
+static int drain(ChunkWriter *cw){
+  if(!cw->len) return 0;
+  if(write_all(cw->fd, cw->buf, cw->len) != 0){
+    set_err("write %s: %s", cw->path, strerror(errno));
+    return -1;
+  }
+  cw->offset += cw->len;
+  cw->len = 0;
+  return 0;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v){
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+// Append bytes, draining the buffer when full. Data that would not fit an
+// empty buffer bypasses it.
+static int put(ChunkWriter *cw, const void *p, size_t n){
+  if(cw->len + n > cw->cap && drain(cw) != 0) return -1;
+  if(n > cw->cap){
+    if(write_all(cw->fd, p, n) != 0){ set_err("write %s: %s", cw->path, strerror(errno)); return -1; }
+    cw->offset += n;
+    return 0;
+  }
+  memcpy(cw->buf + cw->len, p, n);
+  cw->len += n;
+  return 0;
+}
+
+static int put_u32v(ChunkWriter *cw, uint32_t v){
+  uint8_t b[4];
+  put_u32(b, v);
+  return put(cw, b, 4);
+}
+
+static int put_str(ChunkWriter *cw, const char *s, size_t n){
+  return put_u32v(cw, (uint32_t)n) || put(cw, s, n) ? -1 : 0;
+}
+
+static int put_header(ChunkWriter *cw, uint32_t dim, uint32_t n){
+  return put_u32v(cw, CI_MAGIC) || put_u32v(cw, CI_VERSION)
+      || put_str(cw, cw->model, strlen(cw->model))
+      || put_u32v(cw, dim) || put_u32v(cw, n) ? -1 : 0;
+}
+
+ChunkWriter* cw_open(const char *path, const char *model,
+                     uint64_t offset, uint32_t count, size_t cap){
+  int fd = offset ? open(path, O_RDWR | O_CLOEXEC)
+                  : open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd < 0){ set_err("open %s: %s", path, strerror(errno)); return NULL; }
+
+  ChunkWriter *cw = calloc(1, sizeof *cw);
+  cw->fd    = fd;
+  cw->path  = strdup(path);
+  cw->model = strdup(model ? model : "");
+  cw->cap   = cap ? cap : (1u << 20);
+  cw->buf   = malloc(cw->cap);
+
+  if(offset){
+    // the header is already there; recover dim from it
+    size_t ml = strlen(cw->model);
+    uint8_t d[4];
+    if(ftruncate(fd, (off_t)offset) != 0 || lseek(fd, (off_t)offset, SEEK_SET) < 0
+       || pread(fd, d, 4, (off_t)(12 + ml)) != 4){
+      set_err("resume %s: %s", path, strerror(errno));
+      cw_close(cw);
+      return NULL;
+    }
+    cw->dim    = d[0] | d[1] << 8 | d[2] << 16 | (uint32_t)d[3] << 24;
+    cw->offset = offset;
+    cw->count  = count;
+  }
+  return cw;
+}
+
+void cw_set_id_hash(ChunkWriter *cw, int kind){ cw->id_hash = kind; }
+
+// Content id over "file\0" + start + end + text. The 128-bit hash folds the
+// location into its seed instead of building the concatenation.
+static size_t make_id(ChunkWriter *cw, const char *file, uint32_t start, uint32_t end,
+                      const char *text, size_t text_len, uint8_t out[CH_SHA256_LEN]){
+  size_t fl = strlen(file);
+  if(cw->id_hash == CW_ID_SHA256){
+    uint8_t *tmp = malloc(fl + 9 + text_len);
+    memcpy(tmp, file, fl + 1);
+    put_u32(tmp + fl + 1, start);
+    put_u32(tmp + fl + 5, end);
+    memcpy(tmp + fl + 9, text, text_len);
+    ch_sha256(tmp, fl + 9 + text_len, out);
+    free(tmp);
+    return CH_SHA256_LEN;
+  }
+  uint8_t loc[CH_HASH128_LEN];
+  uint64_t seed;
+  ch_hash128(file, fl, (uint64_t)start << 32 | end, loc);
+  memcpy(&seed, loc, 8);
+  ch_hash128(text, text_len, seed, out);
+  return CH_HASH128_LEN;
+}
+
+int cw_add(ChunkWriter *cw,
+           const char *id, const char *parent, const char *file, const char *ext,
+           uint32_t start, uint32_t end,
+           const char *text, size_t text_len,
+           const float *emb, uint32_t dim){
+  if(cw->offset == 0 && cw->len == 0){
+    cw->dim = dim;
+    if(put_header(cw, dim, 0) != 0) return -1;
+  } else if(dim != cw->dim){
+    set_err("embedding dim %u does not match index dim %u", dim, cw->dim);
+    return -1;
+  }
+  uint8_t hid[CH_SHA256_LEN];
+  size_t  id_len = id ? strlen(id) : make_id(cw, file, start, end, text, text_len, hid);
+  if(put_str(cw, id ? id : (const char*)hid, id_len) || put_str(cw, parent, strlen(parent))
+     || put_str(cw, file, strlen(file)) || put_str(cw, ext, strlen(ext))
+     || put_u32v(cw, start) || put_u32v(cw, end)
+     || put_str(cw, text, text_len)
+     || put_u32v(cw, dim) || put(cw, emb, (size_t)dim * sizeof(float)))
+    return -1;
+  cw->count++;
+  return 0;
+}
+
+int64_t cw_flush(ChunkWriter *cw){
+  if(drain(cw) != 0) return -1;
+  if(fdatasync(cw->fd) != 0){ set_err("sync %s: %s", cw->path, strerror(errno)); return -1; }
+  return (int64_t)cw->offset;
+}
+
+uint32_t cw_count(ChunkWriter *cw){ return cw->count; }
+uint32_t cw_dim  (ChunkWriter *cw){ return cw->dim; }
+
+void cw_close(ChunkWriter *cw){
+  if(!cw) return;
+  if(cw->fd >= 0) close(cw->fd);
+  free(cw->buf);
+  free(cw->model);
+  free(cw->path);
+  free(cw);
+}
+
+static int finish(ChunkWriter *cw, const char *final_path){
+  if(cw->offset == 0 && cw->len == 0 && put_header(cw, 0, 0) != 0) return -1;
+  if(drain(cw) != 0) return -1;
+  // N follows magic, version, model and dim
+  uint8_t n[4];
+  put_u32(n, cw->count);
+  if(pwrite(cw->fd, n, 4, (off_t)(16 + strlen(cw->model))) != 4 || fsync(cw->fd) != 0){
+    set_err("finish %s: %s", cw->path, strerror(errno));
+    return -1;
+  }
+  if(final_path && rename(cw->path, final_path) != 0){
+    set_err("rename %s: %s", final_path, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int cw_finish(ChunkWriter *cw, const char *final_path){
+  int rc = finish(cw, final_path);
+  cw_close(cw);
+  return rc;
+}
@@ -0,0 +1,49 @@
+// chunk_writer.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming chunks.bin writer (layout in chunks.h). Records go through one
+// fixed-size buffer, so memory stays bounded by `cap` no matter how many
+// chunks are written; a record larger than the buffer is written directly.
+// The header is emitted with the first record (its dim becomes the file's
+// dim) and N is patched in by cw_finish.
+typedef struct ChunkWriter ChunkWriter;
+
+// Create `path`, or reopen it to continue after a checkpoint: when
+// `offset` > 0 the file is truncated to `offset` and already holds `count`
+// records. cap == 0 selects a 1 MiB buffer. Returns NULL on error.
+ChunkWriter* cw_open(const char *path, const char *model,
+                     uint64_t offset, uint32_t count, size_t cap);
+
+// How cw_add derives ids when none is given: 128-bit content hash
+// (default) or SHA-256, over file, line range and text.
+#define CW_ID_HASH128 0
+#define CW_ID_SHA256  1
+void cw_set_id_hash(ChunkWriter *cw, int kind);
+
+// Append one record. `id` may be NULL to store the content hash selected
+// with cw_set_id_hash. Returns 0, or -1 on a write error or a dim that does
+// not match the file's.
+int cw_add(ChunkWriter *cw,
+           const char *id, const char *parent, const char *file, const char *ext,
+           uint32_t start, uint32_t end,
+           const char *text, size_t text_len,
+           const float *emb, uint32_t dim);
+
+// Write out the buffer and sync it to disk. Returns the durable file size
+// (the offset to resume from), or -1 on error.
+int64_t cw_flush(ChunkWriter *cw);
+
+uint32_t cw_count(ChunkWriter *cw);
+uint32_t cw_dim  (ChunkWriter *cw);
+
+// Flush, patch N into the header, sync and rename the file to `final_path`
+// (kept in place when NULL). The writer is freed either way; returns 0 or -1.
+int cw_finish(ChunkWriter *cw, const char *final_path);
+
+// Close without finishing; what was flushed stays on disk.
+void cw_close(ChunkWriter *cw);
+
+// Description of the last error (static buffer, not thread-safe).
+const char* cw_error(void);
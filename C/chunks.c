@@ -1,87 +1,776 @@
 // chunks.c
 #include "chunks.h"
 #include "cosine_simd.h"
+#include "epoch.h"
+#include "thread_pool.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// Bump‐allocator arena
-typedef struct {
-  uint8_t *base;
-  size_t   sz;
-} Arena;
+// One loaded chunks.bin. Chunks point into `buf`, so a segment lives until
+// the last snapshot referencing it is reclaimed.
+typedef struct Segment Segment;
 
 // Chunk record
 typedef struct {
   const char *id, *parent, *file, *ext, *text;
+  uint32_t     id_len;       // ids are raw hash bytes and may contain NUL
   uint32_t     start_ln, end_ln;
   uint32_t     dim;
   float       *emb;
+  Segment     *seg;
+  const int8_t *code;        // int8 code for ci_search_deadline, once built
+  float        code_scale;   // 0 for chunks of another dim
 } Chunk;
 
+enum { CODES_NONE, CODES_BUILDING, CODES_READY };
+
+struct Segment {
+  _Atomic uint32_t refs;    // snapshots holding this segment
+  uint8_t    *buf;
+  size_t      sz;
+  size_t      map_sz;       // non-zero when buf is a read-only shared mapping
+  uint32_t    n;
+  Chunk      *chunks;
+  const char *model;
+  uint32_t    dim;
+
+  // codes are built on first use by one thread; `coded` goes NONE ->
+  // BUILDING -> READY and other searchers wait on code_cv meanwhile
+  pthread_mutex_t code_mu;
+  pthread_cond_t  code_cv;
+  atomic_int  coded;
+  int8_t     *codes;        // n x dim
+};
+
+// Immutable view readers search. Slots keep their index across appends
+// and deletes; a deleted chunk leaves a NULL slot.
+typedef struct {
+  uint32_t    N;
+  Chunk     **slot;
+  uint32_t    nseg;
+  Segment   **segs;
+  const char *model;        // embedding model the vectors came from
+  uint32_t    dim;
+} Snapshot;
+
+// Counters and histograms behind ci_stats_get: relaxed atomics, bumped once
+// per call so concurrent readers only share a few cache lines.
+typedef struct {
+  _Atomic uint64_t count, sum_ns, max_ns, b[CI_HIST_BUCKETS];
+} Hist;
+
+typedef struct {
+  _Atomic uint64_t queries, scanned, pruned, rescored;
+  _Atomic uint64_t cache_hits, prep_hits, prep_builds;
+  Hist load, search, meta;
+} Stats;
+
+// Rows one search visited; flushed into Stats when it returns.
+typedef struct {
+  uint64_t scanned, pruned, rescored;
+} Scan;
+
 // Index
 struct ChunkIndex {
-  Arena      arena;
-  uint32_t   N;
-  Chunk     *chunks;
+  _Atomic(Snapshot*) snap;
+  pthread_mutex_t    write_mu;  // serialises writers only
+  int                shared;    // ci_reload goes through the prepared cache
+  char              *cache;     // explicit cache path, NULL = <file>.prep
+
+  _Atomic uint64_t   last_used; // µs clock of the last search, for LRU
+  Stats              stats;
+
+  // registry entry when opened through ci_open; guarded by g_reg_mu
+  char              *reg_path;  // canonical path
+  struct stat        reg_st;    // of reg_path when (re)loaded
+  uint32_t           reg_refs;
+  uint64_t           cold_at;   // last_used when its mapped pages were dropped
+  struct ChunkIndex *reg_next;
 };
 
-static const char* read_str(Arena *A, uint8_t **p){
-  uint32_t L = *(uint32_t*)(*p); *p+=4;
-  const char *s = (const char*)(*p);
-  *p += L;
+static pthread_mutex_t g_reg_mu = PTHREAD_MUTEX_INITIALIZER;
+static ChunkIndex     *g_reg;
+static size_t          g_budget;  // 0 = no budget: free on last close
+
+// Length-prefixed string. The bytes are moved back over their own prefix so
+// the string can be NUL-terminated in place without touching the next field.
+static const char* read_str(uint8_t **p, const uint8_t *end){
+  if(end - *p < 4) return NULL;
+  uint32_t L; memcpy(&L, *p, 4);
+  if((size_t)(end - *p - 4) < L) return NULL;
+  char *s = (char*)(*p);
+  memmove(s, s + 4, L);
+  s[L] = 0;
+  *p += 4 + L;
   return s;
 }
 
-ChunkIndex* ci_load(const char *fname){
+static int read_u32(uint8_t **p, const uint8_t *end, uint32_t *v){
+  if(end - *p < 4) return 0;
+  memcpy(v, *p, 4);
+  *p += 4;
+  return 1;
+}
+
+static uint64_t now_ns(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_us(void){ return now_ns() / 1000u; }
+
+// Log-linear buckets (HDR style, 3 significant bits): exact below 8 ns,
+// then 8 buckets per power of two, so any value is within 12.5%.
+static uint32_t hist_bucket(uint64_t v){
+  if(v < 8) return (uint32_t)v;
+  uint32_t e = 63 - (uint32_t)__builtin_clzll(v);
+  return (e - 2) * 8 + (uint32_t)((v >> (e - 3)) & 7);
+}
+
+static void hist_add(Hist *h, uint64_t ns){
+  atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+  atomic_fetch_add_explicit(&h->b[hist_bucket(ns)], 1, memory_order_relaxed);
+  uint64_t m = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+  while(ns > m && !atomic_compare_exchange_weak_explicit(&h->max_ns, &m, ns,
+                                                          memory_order_relaxed, memory_order_relaxed));
+}
+
+#define STAT_ADD(ci, field, n) atomic_fetch_add_explicit(&(ci)->stats.field, (n), memory_order_relaxed)
+
+static void seg_free(Segment *s){
+  if(s->map_sz) munmap(s->buf, s->map_sz);
+  else          free(s->buf);
+  free(s->chunks);
+  free(s->codes);
+  pthread_mutex_destroy(&s->code_mu);
+  pthread_cond_destroy(&s->code_cv);
+  free(s);
+}
+
+static void seg_release(Segment *s){
+  if(atomic_fetch_sub(&s->refs, 1) == 1) seg_free(s);
+}
+
+static Segment* seg_load(const char *fname){
   FILE *f = fopen(fname,"rb");
   if(!f) return NULL;
   fseek(f,0,SEEK_END);
   size_t filesize = ftell(f);
   fseek(f,0,SEEK_SET);
 
-  uint8_t *buf = malloc(filesize);
-  fread(buf,1,filesize,f);
+  uint8_t *buf = malloc(filesize ? filesize : 1);
+  if(fread(buf,1,filesize,f) != filesize){ fclose(f); free(buf); return NULL; }
   fclose(f);
 
-  uint8_t *p = buf;
-  uint32_t N = *(uint32_t*)p; p+=4;
+  uint8_t *p = buf, *end = buf + filesize;
+  Segment *sg = calloc(1,sizeof*sg);
+  sg->buf   = buf;
+  sg->sz    = filesize;
+  sg->model = "";
+  pthread_mutex_init(&sg->code_mu, NULL);
+  pthread_cond_init(&sg->code_cv, NULL);
 
-  ChunkIndex *ci = calloc(1,sizeof*ci);
-  ci->arena.base = buf;
-  ci->arena.sz   = filesize;
-  ci->N          = N;
-  ci->chunks     = calloc(N,sizeof(Chunk));
+  uint32_t N, magic = 0, version = 0;
+  if(!read_u32(&p,end,&magic)) goto fail;
+  if(magic == CI_MAGIC){
+    if(!read_u32(&p,end,&version) || version > CI_VERSION) goto fail;
+    if(!(sg->model = read_str(&p,end))) goto fail;
+    if(!read_u32(&p,end,&sg->dim) || !read_u32(&p,end,&N)) goto fail;
+  } else {
+    N = magic;  // legacy files start with the chunk count
+  }
+  if(N > (size_t)(end - p) / 32) goto fail;  // every record is >= 32 bytes
+
+  sg->n      = N;
+  sg->chunks = calloc(N ? N : 1,sizeof(Chunk));
 
   for(uint32_t i=0;i<N;i++){
-    Chunk *c = &ci->chunks[i];
-    c->id       = read_str(&ci->arena,&p);
-    c->parent   = read_str(&ci->arena,&p);
-    c->file     = read_str(&ci->arena,&p);
-    c->ext      = read_str(&ci->arena,&p);
-    c->start_ln = *(uint32_t*)p; p+=4;
-    c->end_ln   = *(uint32_t*)p; p+=4;
-    c->text     = read_str(&ci->arena,&p);
-    c->dim      = *(uint32_t*)p; p+=4;
+    Chunk *c = &sg->chunks[i];
+    uint8_t *id_at = p;
+    if(!(c->id     = read_str(&p,end))) goto fail;
+    c->id_len = (uint32_t)(p - id_at - 4);
+    if(!(c->parent = read_str(&p,end))) goto fail;
+    if(!(c->file   = read_str(&p,end))) goto fail;
+    if(!(c->ext    = read_str(&p,end))) goto fail;
+    if(!read_u32(&p,end,&c->start_ln) || !read_u32(&p,end,&c->end_ln)) goto fail;
+    if(!(c->text   = read_str(&p,end))) goto fail;
+    if(!read_u32(&p,end,&c->dim)) goto fail;
+    if((size_t)(end - p) / sizeof(float) < c->dim) goto fail;
     c->emb      = (float*)p;
+    c->seg      = sg;
     norm_simd(c->emb, c->dim); 
     p += sizeof(float)*c->dim;
   }
+  if(!sg->dim && N) sg->dim = sg->chunks[0].dim;
+
+  return sg;
+
+fail:
+  seg_free(sg);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------------
+ * Shared prepared index
+ *
+ * A prepared cache holds a segment exactly as seg_load leaves it (strings
+ * NUL-terminated in place, vectors normalised) plus a table of field
+ * offsets, keyed by the size, mtime and inode of the chunks.bin it came
+ * from. Every process maps it read-only and MAP_SHARED, so the page cache
+ * holds one copy per machine and only the Chunk table is private.
+ * ------------------------------------------------------------------- */
+
+#define CI_PREP_MAGIC   0x50435041u  // "APCP"
+#define CI_PREP_VERSION 1
+
+typedef struct {
+  uint32_t magic, version;
+  uint64_t src_size, src_mtime_ns, src_ino, src_dev;
+  uint64_t model;               // body offset
+  uint32_t dim, n;
+  uint64_t table_off, body_off, body_len;
+} PrepHeader;
+
+// body offsets of one chunk's fields
+typedef struct {
+  uint64_t id, parent, file, ext, text, emb;
+  uint32_t id_len, start_ln, end_ln, dim;
+} PrepChunk;
+
+static void prep_key(const struct stat *st, PrepHeader *h){
+#ifdef __APPLE__
+  struct timespec mt = st->st_mtimespec;
+#else
+  struct timespec mt = st->st_mtim;
+#endif
+  h->src_size     = (uint64_t)st->st_size;
+  h->src_mtime_ns = (uint64_t)mt.tv_sec * 1000000000u + (uint64_t)mt.tv_nsec;
+  h->src_ino      = (uint64_t)st->st_ino;
+  h->src_dev      = (uint64_t)st->st_dev;
+}
+
+// n bytes at off followed by the NUL read_str left there
+static int str_ok(const uint8_t *body, uint64_t len, uint64_t off, uint64_t n){
+  return off < len && n < len - off && body[off + n] == 0;
+}
+
+static int cstr_ok(const uint8_t *body, uint64_t len, uint64_t off){
+  return off < len && memchr(body + off, 0, len - off);
+}
+
+// Map `cache` if it was prepared from the file described by `st`.
+static Segment* seg_map(const char *cache, const struct stat *st){
+  int fd = open(cache, O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return NULL;
+  struct stat cs;
+  void *m = MAP_FAILED;
+  if(fstat(fd, &cs) == 0 && (size_t)cs.st_size >= sizeof(PrepHeader))
+    m = mmap(NULL, (size_t)cs.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(m == MAP_FAILED) return NULL;
+
+  size_t sz = (size_t)cs.st_size;
+  Segment *sg = calloc(1,sizeof*sg);
+  sg->buf    = m;
+  sg->map_sz = sz;
+  pthread_mutex_init(&sg->code_mu, NULL);
+  pthread_cond_init(&sg->code_cv, NULL);
+
+  PrepHeader h, want;
+  memcpy(&h, m, sizeof h);
+  prep_key(st, &want);
+  if(h.magic != CI_PREP_MAGIC || h.version != CI_PREP_VERSION ||
+     h.src_size != want.src_size || h.src_mtime_ns != want.src_mtime_ns ||
+     h.src_ino != want.src_ino || h.src_dev != want.src_dev) goto fail;
+  if(h.body_off > sz || h.body_len > sz - h.body_off) goto fail;
+  if(h.table_off > sz || h.n > (sz - h.table_off) / sizeof(PrepChunk)) goto fail;
+
+  const uint8_t *body = sg->buf + h.body_off;
+  if(!cstr_ok(body, h.body_len, h.model)) goto fail;
+  sg->model  = (const char*)body + h.model;
+  sg->dim    = h.dim;
+  sg->sz     = h.body_len;
+  sg->n      = h.n;
+  sg->chunks = calloc(h.n ? h.n : 1, sizeof(Chunk));
+
+  for(uint32_t i = 0; i < h.n; i++){
+    PrepChunk pc;
+    memcpy(&pc, sg->buf + h.table_off + (size_t)i * sizeof pc, sizeof pc);
+    if(!str_ok(body, h.body_len, pc.id, pc.id_len)) goto fail;
+    if(pc.emb > h.body_len || pc.dim > (h.body_len - pc.emb) / sizeof(float)) goto fail;
+    if(!cstr_ok(body, h.body_len, pc.parent) || !cstr_ok(body, h.body_len, pc.file) ||
+       !cstr_ok(body, h.body_len, pc.ext)    || !cstr_ok(body, h.body_len, pc.text)) goto fail;
+    Chunk *c = &sg->chunks[i];
+    c->id       = (const char*)body + pc.id;
+    c->id_len   = pc.id_len;
+    c->parent   = (const char*)body + pc.parent;
+    c->file     = (const char*)body + pc.file;
+    c->ext      = (const char*)body + pc.ext;
+    c->text     = (const char*)body + pc.text;
+    c->start_ln = pc.start_ln;
+    c->end_ln   = pc.end_ln;
+    c->dim      = pc.dim;
+    c->emb      = (float*)(body + pc.emb);
+    c->seg      = sg;
+  }
+  return sg;
+
+fail:
+  seg_free(sg);
+  return NULL;
+}
+
+static int write_all(int fd, const void *p, size_t n){
+  const uint8_t *b = p;
+  while(n){
+    ssize_t w = write(fd, b, n);
+    if(w < 0) return -1;
+    b += w; n -= (size_t)w;
+  }
+  return 0;
+}
+
+// Write `sg` (private, as loaded by seg_load) to `cache` atomically.
+static int prep_write(const Segment *sg, const char *cache, const struct stat *st){
+  PrepHeader h = {0};
+  h.magic     = CI_PREP_MAGIC;
+  h.version   = CI_PREP_VERSION;
+  prep_key(st, &h);
+  h.dim       = sg->dim;
+  h.n         = sg->n;
+  h.table_off = sizeof h;
+  h.body_off  = (h.table_off + (uint64_t)sg->n * sizeof(PrepChunk) + 63) & ~(uint64_t)63;
+  // a legacy file's "" model is not in the buffer: append a NUL for it
+  int legacy  = !*sg->model;
+  h.model     = legacy ? sg->sz : (uint64_t)((const uint8_t*)sg->model - sg->buf);
+  h.body_len  = sg->sz + legacy;
+  uint8_t pad[64] = {0};
+
+  size_t plen = strlen(cache);
+  char *tmp = malloc(plen + 32);
+  snprintf(tmp, plen + 32, "%s.tmp.%ld", cache, (long)getpid());
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(fd < 0){ free(tmp); return -1; }
+
+  int rc = 0;
+  rc |= write_all(fd, &h, sizeof h);
+  for(uint32_t i = 0; i < sg->n && !rc; i++){
+    const Chunk *c = &sg->chunks[i];
+    PrepChunk pc = {
+      (uint64_t)((const uint8_t*)c->id     - sg->buf),
+      (uint64_t)((const uint8_t*)c->parent - sg->buf),
+      (uint64_t)((const uint8_t*)c->file   - sg->buf),
+      (uint64_t)((const uint8_t*)c->ext    - sg->buf),
+      (uint64_t)((const uint8_t*)c->text   - sg->buf),
+      (uint64_t)((const uint8_t*)c->emb    - sg->buf),
+      c->id_len, c->start_ln, c->end_ln, c->dim
+    };
+    rc |= write_all(fd, &pc, sizeof pc);
+  }
+  if(!rc) rc |= write_all(fd, pad, h.body_off - h.table_off - (uint64_t)sg->n * sizeof(PrepChunk));
+  if(!rc) rc |= write_all(fd, sg->buf, sg->sz);
+  if(!rc && legacy) rc |= write_all(fd, pad, 1);
+  if(!rc) rc |= fdatasync(fd);
+  rc |= close(fd);
+  if(!rc) rc = rename(tmp, cache);
+  if(rc) unlink(tmp);
+  free(tmp);
+  return rc ? -1 : 0;
+}
+
+// Map the prepared cache of `fname`, preparing it first when it is missing
+// or stale. Falls back to a private load when the cache cannot be written.
+static Segment* seg_shared(const char *fname, const char *cache, int *built){
+  char *def = NULL;
+  *built = 0;
+  if(!cache){
+    size_t n = strlen(fname) + 6;
+    def = malloc(n);
+    snprintf(def, n, "%s.prep", fname);
+    cache = def;
+  }
+  struct stat st, st2;
+  Segment *sg = NULL;
+  if(stat(fname, &st) == 0 && !(sg = seg_map(cache, &st))){
+    *built = 1;
+    sg = seg_load(fname);
+    // only publish what was read from an unchanged file
+    PrepHeader a = {0}, b = {0};
+    prep_key(&st, &a);
+    if(sg && stat(fname, &st2) == 0 && (prep_key(&st2, &b), memcmp(&a, &b, sizeof a) == 0) &&
+       prep_write(sg, cache, &st) == 0){
+      Segment *m = seg_map(cache, &st);
+      if(m){ seg_free(sg); sg = m; }
+    }
+  }
+  free(def);
+  return sg;
+}
+
+static void snap_free(void *p){
+  Snapshot *s = p;
+  for(uint32_t k = 0; k < s->nseg; k++) seg_release(s->segs[k]);
+  free(s->segs);
+  free(s->slot);
+  free(s);
+}
+
+// Snapshot with `nslot` slot capacity and room for `nseg` segments.
+static Snapshot* snap_new(uint32_t nslot, uint32_t nseg){
+  Snapshot *s = calloc(1,sizeof*s);
+  s->slot  = malloc((nslot ? nslot : 1) * sizeof(Chunk*));
+  s->segs  = malloc((nseg ? nseg : 1) * sizeof(Segment*));
+  s->model = "";
+  if(!s->slot || !s->segs){ free(s->slot); free(s->segs); free(s); return NULL; }
+  return s;
+}
+
+static void snap_add_seg(Snapshot *s, Segment *sg){
+  atomic_fetch_add(&sg->refs, 1);
+  s->segs[s->nseg++] = sg;
+}
+
+static void snap_add_chunks(Snapshot *s, Segment *sg){
+  snap_add_seg(s, sg);
+  for(uint32_t i = 0; i < sg->n; i++) s->slot[s->N++] = &sg->chunks[i];
+  if(!s->dim){ s->dim = sg->dim; s->model = sg->model; }
+}
+
+// Install `s` and retire the snapshot it replaces. Caller holds write_mu.
+static void publish(ChunkIndex *ci, Snapshot *s){
+  Snapshot *old = atomic_exchange(&ci->snap, s);
+  if(old) ebr_retire(old, snap_free);
+  ebr_reclaim();
+}
+
+static ChunkIndex* index_new(Segment *sg){
+  if(!sg) return NULL;
+  Snapshot *s = snap_new(sg->n, 1);
+  if(!s){ seg_free(sg); return NULL; }
+  snap_add_chunks(s, sg);
+
+  ChunkIndex *ci = calloc(1,sizeof*ci);
+  atomic_init(&ci->snap, s);
+  atomic_init(&ci->last_used, now_us());
+  pthread_mutex_init(&ci->write_mu, NULL);
+  return ci;
+}
+
+ChunkIndex* ci_load(const char *fname){
+  uint64_t t0 = now_ns();
+  ChunkIndex *ci = index_new(seg_load(fname));
+  if(ci) hist_add(&ci->stats.load, now_ns() - t0);
+  return ci;
+}
 
+ChunkIndex* ci_load_shared(const char *fname, const char *cache_path){
+  uint64_t t0 = now_ns();
+  int built;
+  ChunkIndex *ci = index_new(seg_shared(fname, cache_path, &built));
+  if(ci){
+    ci->shared = 1;
+    ci->cache  = cache_path ? strdup(cache_path) : NULL;
+    STAT_ADD(ci, prep_hits, !built);
+    STAT_ADD(ci, prep_builds, built);
+    hist_add(&ci->stats.load, now_ns() - t0);
+  }
   return ci;
 }
 
 void ci_free(ChunkIndex *ci){
-  free(ci->arena.base);
-  free(ci->chunks);
+  if(!ci) return;
+  snap_free(atomic_load(&ci->snap));
+  ebr_reclaim();
+  pthread_mutex_destroy(&ci->write_mu);
+  free(ci->cache);
+  free(ci->reg_path);
   free(ci);
 }
 
+/* ---------------------------------------------------------------------
+ * Registry and memory budget
+ *
+ * With a budget set, a closed index stays cached so switching back to a
+ * project is instant. Whenever the registry grows or shrinks, indexes are
+ * visited least recently searched first (the newest is spared) until the
+ * total fits: unreferenced ones are freed, referenced ones go cold, i.e.
+ * their mapped pages are dropped from this process and are faulted back
+ * from the page cache by the next search. Private (non-shared) buffers
+ * can only be freed, so budgeted setups should load through the cache.
+ * ------------------------------------------------------------------- */
+
+#ifdef __APPLE__
+typedef char mincore_vec;
+#else
+typedef unsigned char mincore_vec;
+#endif
+
+// Bytes of `sg` in memory; `mapped` gets the share that is a file mapping.
+static size_t seg_resident(Segment *sg, size_t *mapped){
+  size_t n = (size_t)sg->n * sizeof(Chunk);
+  if(atomic_load_explicit(&sg->coded, memory_order_acquire) == CODES_READY) n += (size_t)sg->n * sg->dim;
+  if(!sg->map_sz){ *mapped = 0; return n + sg->sz; }
+
+  size_t pg = (size_t)sysconf(_SC_PAGESIZE), pages = (sg->map_sz + pg - 1) / pg, in = 0;
+  mincore_vec *vec = malloc(pages);
+  if(vec && mincore(sg->buf, sg->map_sz, vec) == 0)
+    for(size_t i = 0; i < pages; i++) in += vec[i] & 1;
+  else
+    in = pages;
+  free(vec);
+  *mapped = in * pg;
+  return n + *mapped;
+}
+
+static size_t resident(ChunkIndex *ci, size_t *mapped){
+  ebr_enter();
+  Snapshot *s = atomic_load(&ci->snap);
+  size_t n = sizeof *s + (size_t)s->N * sizeof(Chunk*), m = 0;
+  for(uint32_t k = 0; k < s->nseg; k++){
+    size_t mk;
+    n += seg_resident(s->segs[k], &mk);
+    m += mk;
+  }
+  ebr_exit();
+  if(mapped) *mapped = m;
+  return n;
+}
+
+size_t ci_resident_bytes(ChunkIndex *ci){
+  return resident(ci, NULL);
+}
+
+static void go_cold(ChunkIndex *ci){
+  ebr_enter();
+  Snapshot *s = atomic_load(&ci->snap);
+  for(uint32_t k = 0; k < s->nseg; k++)
+    if(s->segs[k]->map_sz) madvise(s->segs[k]->buf, s->segs[k]->map_sz, MADV_DONTNEED);
+  ebr_exit();
+  ci->cold_at = atomic_load_explicit(&ci->last_used, memory_order_relaxed);
+}
+
+// Budgeted bytes: a cold index costs only its private memory until it is
+// searched again.
+static size_t charged(ChunkIndex *ci){
+  size_t mapped, n = resident(ci, &mapped);
+  int cold = ci->cold_at && ci->cold_at == atomic_load_explicit(&ci->last_used, memory_order_relaxed);
+  return cold ? n - mapped : n;
+}
+
+// Caller holds g_reg_mu; unreferenced victims are moved to *freed.
+static void enforce_budget(ChunkIndex **freed){
+  if(!g_budget) return;
+  size_t total = 0, count = 0;
+  for(ChunkIndex *ci = g_reg; ci; ci = ci->reg_next){ total += charged(ci); count++; }
+  if(count < 2) return;
+
+  ChunkIndex **order = malloc(count * sizeof *order);
+  if(!order) return;
+  size_t n = 0;
+  for(ChunkIndex *ci = g_reg; ci; ci = ci->reg_next) order[n++] = ci;
+  // insertion sort by last use: registries hold a handful of projects
+  for(size_t i = 1; i < n; i++)
+    for(size_t j = i; j > 0 && atomic_load(&order[j-1]->last_used) > atomic_load(&order[j]->last_used); j--){
+      ChunkIndex *t = order[j]; order[j] = order[j-1]; order[j-1] = t;
+    }
+
+  for(size_t i = 0; i + 1 < n && total > g_budget; i++){
+    ChunkIndex *ci = order[i];
+    size_t before = charged(ci);
+    if(ci->reg_refs == 0){
+      for(ChunkIndex **pp = &g_reg; *pp; pp = &(*pp)->reg_next)
+        if(*pp == ci){ *pp = ci->reg_next; break; }
+      ci->reg_next = *freed;
+      *freed = ci;
+      total -= before;
+    } else {
+      go_cold(ci);
+      total -= before - charged(ci);
+    }
+  }
+  free(order);
+}
+
+static void free_list(ChunkIndex *ci){
+  while(ci){
+    ChunkIndex *next = ci->reg_next;
+    ci_free(ci);
+    ci = next;
+  }
+}
+
+static ChunkIndex* reg_find(const char *real){
+  for(ChunkIndex *ci = g_reg; ci; ci = ci->reg_next)
+    if(strcmp(ci->reg_path, real) == 0){ ci->reg_refs++; return ci; }
+  return NULL;
+}
+
+ChunkIndex* ci_open(const char *fname, int shared){
+  char real[PATH_MAX];
+  struct stat st;
+  if(!realpath(fname, real) || stat(real, &st) != 0) return NULL;
+  pthread_mutex_lock(&g_reg_mu);
+  ChunkIndex *ci = reg_find(real);
+  int stale = ci && (ci->reg_st.st_ino != st.st_ino || ci->reg_st.st_size != st.st_size ||
+                     ci->reg_st.st_mtime != st.st_mtime);
+  if(stale) ci->reg_st = st;
+  pthread_mutex_unlock(&g_reg_mu);
+  if(ci){
+    // a cached index whose file was rebuilt since
+    if(stale) ci_reload(ci, real);
+    atomic_store(&ci->last_used, now_us());
+    STAT_ADD(ci, cache_hits, 1);
+    return ci;
+  }
+
+  // load outside the lock; when two opens race, the first to register wins
+  ChunkIndex *fresh = shared ? ci_load_shared(real, NULL) : ci_load(real), *freed = NULL;
+  if(!fresh) return NULL;
+  pthread_mutex_lock(&g_reg_mu);
+  if(!(ci = reg_find(real))){
+    fresh->reg_path = strdup(real);
+    fresh->reg_st   = st;
+    fresh->reg_refs = 1;
+    fresh->reg_next = g_reg;
+    g_reg = ci = fresh;
+    fresh = NULL;
+    enforce_budget(&freed);
+  }
+  pthread_mutex_unlock(&g_reg_mu);
+  ci_free(fresh);
+  free_list(freed);
+  return ci;
+}
+
+void ci_close(ChunkIndex *ci){
+  if(!ci) return;
+  if(ci->reg_path){
+    ChunkIndex *freed = NULL;
+    pthread_mutex_lock(&g_reg_mu);
+    int last = --ci->reg_refs == 0 && !g_budget;
+    if(last)
+      for(ChunkIndex **pp = &g_reg; *pp; pp = &(*pp)->reg_next)
+        if(*pp == ci){ *pp = ci->reg_next; break; }
+    if(!last) enforce_budget(&freed);
+    pthread_mutex_unlock(&g_reg_mu);
+    free_list(freed);
+    if(!last) return;
+  }
+  ci_free(ci);
+}
+
+void ci_set_budget(size_t bytes){
+  ChunkIndex *freed = NULL;
+  pthread_mutex_lock(&g_reg_mu);
+  g_budget = bytes;
+  if(bytes) enforce_budget(&freed);
+  else
+    // no budget: nothing is cached any more
+    for(ChunkIndex **pp = &g_reg; *pp; )
+      if((*pp)->reg_refs == 0){
+        ChunkIndex *ci = *pp;
+        *pp = ci->reg_next;
+        ci->reg_next = freed;
+        freed = ci;
+      } else pp = &(*pp)->reg_next;
+  pthread_mutex_unlock(&g_reg_mu);
+  free_list(freed);
+}
+
+int32_t ci_append(ChunkIndex *ci, const char *fname){
+  uint64_t t0 = now_ns();
+  Segment *sg = seg_load(fname);
+  if(!sg) return -1;
+  pthread_mutex_lock(&ci->write_mu);
+  Snapshot *cur = atomic_load(&ci->snap), *s = NULL;
+  int compatible = !cur->dim || !sg->n ||
+                   (sg->dim == cur->dim && strcmp(sg->model, cur->model) == 0);
+  if(compatible && cur->N <= UINT32_MAX - sg->n)
+    s = snap_new(cur->N + sg->n, cur->nseg + 1);
+  if(!s){
+    pthread_mutex_unlock(&ci->write_mu);
+    seg_free(sg);
+    return -1;
+  }
+  memcpy(s->slot, cur->slot, cur->N * sizeof(Chunk*));
+  s->N     = cur->N;
+  s->dim   = cur->dim;
+  s->model = cur->model;
+  for(uint32_t k = 0; k < cur->nseg; k++) snap_add_seg(s, cur->segs[k]);
+  snap_add_chunks(s, sg);
+  publish(ci, s);
+  pthread_mutex_unlock(&ci->write_mu);
+  hist_add(&ci->stats.load, now_ns() - t0);
+  return (int32_t)sg->n;
+}
+
+int32_t ci_delete_file(ChunkIndex *ci, const char *file){
+  pthread_mutex_lock(&ci->write_mu);
+  Snapshot *cur = atomic_load(&ci->snap);
+  Snapshot *s = snap_new(cur->N, cur->nseg);
+  if(!s){ pthread_mutex_unlock(&ci->write_mu); return -1; }
+
+  // segments left without a live chunk are dropped with the old snapshot
+  uint32_t *live = calloc(cur->nseg ? cur->nseg : 1, sizeof(uint32_t));
+  int32_t removed = 0;
+  for(uint32_t i = 0; i < cur->N; i++){
+    Chunk *c = cur->slot[i];
+    if(c && strcmp(c->file, file) == 0){ c = NULL; removed++; }
+    s->slot[i] = c;
+    if(c) for(uint32_t k = 0; k < cur->nseg; k++)
+      if(cur->segs[k] == c->seg){ live[k]++; break; }
+  }
+  s->N     = cur->N;
+  s->dim   = cur->dim;
+  s->model = cur->model;
+  for(uint32_t k = 0; k < cur->nseg; k++)
+    if(live[k] || cur->segs[k]->model == cur->model) snap_add_seg(s, cur->segs[k]);
+  free(live);
+
+  if(removed) publish(ci, s);
+  else        snap_free(s);
+  pthread_mutex_unlock(&ci->write_mu);
+  return removed;
+}
+
+int ci_reload(ChunkIndex *ci, const char *fname){
+  uint64_t t0 = now_ns();
+  int built = 0;
+  Segment *sg = ci->shared ? seg_shared(fname, ci->cache, &built) : seg_load(fname);
+  if(!sg) return -1;
+  if(ci->shared){
+    STAT_ADD(ci, prep_hits, !built);
+    STAT_ADD(ci, prep_builds, built);
+  }
+  Snapshot *s = snap_new(sg->n, 1);
+  if(!s){ seg_free(sg); return -1; }
+  snap_add_chunks(s, sg);
+  pthread_mutex_lock(&ci->write_mu);
+  publish(ci, s);
+  pthread_mutex_unlock(&ci->write_mu);
+  hist_add(&ci->stats.load, now_ns() - t0);
+  return 0;
+}
+
+void ci_pin  (void){ ebr_enter(); }
+void ci_unpin(void){ ebr_exit(); }
+
 // simple min‐heap top‐K
 typedef struct { double score; uint32_t idx; } Pair;
-static void sift_down(Pair *h, int K){
-  int i=0;
+static void sift_down(Pair *h, int K, int i){
   while(1){
     int c=2*i+1; if(c>=K)break;
     if(c+1<K && h[c+1].score < h[c].score) c++;
@@ -92,17 +781,59 @@ static void sift_down(Pair *h, int K){
   }
 }
 
-uint32_t ci_search(ChunkIndex *ci,
-                   const float *q, uint32_t dim,
-                   uint32_t K, uint32_t *out_i,
-                   double   *out_s)
+// Per-thread search scratch, grown on demand and freed at thread exit, so
+// concurrent searches share nothing but the snapshot they read.
+enum { SCR_HEAP, SCR_CAND, SCR_Q8, SCR_N };
+typedef struct { void *p[SCR_N]; size_t cap[SCR_N]; } Scratch;
+
+static pthread_key_t          scratch_key;
+static pthread_once_t         scratch_once = PTHREAD_ONCE_INIT;
+static _Thread_local Scratch *t_scratch;
+
+static void scratch_free(void *p){
+  Scratch *s = p;
+  for(int k = 0; k < SCR_N; k++) free(s->p[k]);
+  free(s);
+}
+
+static void scratch_key_init(void){ pthread_key_create(&scratch_key, scratch_free); }
+
+static void* scratch(int k, size_t bytes){
+  Scratch *s = t_scratch;
+  if(!s){
+    pthread_once(&scratch_once, scratch_key_init);
+    if(!(s = calloc(1,sizeof*s))) return NULL;
+    pthread_setspecific(scratch_key, s);
+    t_scratch = s;
+  }
+  if(s->cap[k] < bytes){
+    void *p = realloc(s->p[k], bytes);
+    if(!p) return NULL;
+    s->p[k]   = p;
+    s->cap[k] = bytes;
+  }
+  return s->p[k];
+}
+
+// chunks scanned between looks at the cancellation flag
+#define CANCEL_BLOCK 1024
+
+static uint32_t search_snap(const Snapshot *s,
+                            const float *q, uint32_t dim,
+                            uint32_t K, uint32_t *out_i,
+                            double   *out_s, const int *cancel,
+                            Scan     *st)
 {
-  Pair *heap = calloc(K, sizeof(Pair));
+  Pair *heap = K ? scratch(SCR_HEAP, K * sizeof(Pair)) : NULL;
+  if(!heap) return 0;
   uint32_t sz = 0;
 
-  for (uint32_t i = 0; i < ci->N; i++) {
-    Chunk *c = &ci->chunks[i];
-    if (c->dim != dim) continue;
+  for (uint32_t i = 0; i < s->N; i++) {
+    if (cancel && i % CANCEL_BLOCK == 0 && __atomic_load_n(cancel, __ATOMIC_RELAXED))
+      break;
+    const Chunk *c = s->slot[i];
+    if (!c || c->dim != dim) { st->pruned++; continue; }
+    st->scanned++;
 
     double sc_val;
     f32_dot_product_simd(
@@ -115,14 +846,14 @@ uint32_t ci_search(ChunkIndex *ci,
     if (sz < K) {
       heap[sz++] = (Pair){ sc_val, i };
       if (sz == K) {
-        for (int p = (K - 2) / 2; p >= 0; p--) {
-          sift_down(heap, K);
+        for (int p = (int)K / 2 - 1; p >= 0; p--) {
+          sift_down(heap, K, p);
         }
       }
     }
     else if (sc_val > heap[0].score) {
       heap[0] = (Pair){ sc_val, i };
-      sift_down(heap, K);
+      sift_down(heap, K, 0);
     }
   }
 
@@ -130,15 +861,361 @@ uint32_t ci_search(ChunkIndex *ci,
     out_i[j] = heap[j].idx;
     out_s[j] = heap[j].score;
   }
-  free(heap);
   return sz;
 }
 
-// getters
-const char* ci_get_id     (ChunkIndex*ci,uint32_t i){return ci->chunks[i].id;}
-const char* ci_get_parent (ChunkIndex*ci,uint32_t i){return ci->chunks[i].parent;}
-const char* ci_get_file   (ChunkIndex*ci,uint32_t i){return ci->chunks[i].file;}
-const char* ci_get_ext    (ChunkIndex*ci,uint32_t i){return ci->chunks[i].ext;}
-uint32_t    ci_get_start  (ChunkIndex*ci,uint32_t i){return ci->chunks[i].start_ln;}
-uint32_t    ci_get_end    (ChunkIndex*ci,uint32_t i){return ci->chunks[i].end_ln;}
-const char* ci_get_text   (ChunkIndex*ci,uint32_t i){return ci->chunks[i].text;}
+static void count_search(ChunkIndex *ci, const Scan *st, uint64_t t0){
+  STAT_ADD(ci, queries, 1);
+  STAT_ADD(ci, scanned, st->scanned);
+  STAT_ADD(ci, pruned, st->pruned);
+  if(st->rescored) STAT_ADD(ci, rescored, st->rescored);
+  hist_add(&ci->stats.search, now_ns() - t0);
+}
+
+uint32_t ci_search(ChunkIndex *ci,
+                   const float *q, uint32_t dim,
+                   uint32_t K, uint32_t *out_i,
+                   double   *out_s)
+{
+  return ci_search_cancellable(ci, q, dim, K, out_i, out_s, NULL);
+}
+
+uint32_t ci_search_cancellable(ChunkIndex *ci,
+                               const float *q, uint32_t dim,
+                               uint32_t K, uint32_t *out_i,
+                               double   *out_s, const int *cancel)
+{
+  uint64_t t0 = now_ns();
+  Scan st = {0};
+  atomic_store_explicit(&ci->last_used, t0 / 1000u, memory_order_relaxed);
+  ebr_enter();
+  uint32_t n = search_snap(atomic_load(&ci->snap), q, dim, K, out_i, out_s, cancel, &st);
+  ebr_exit();
+  count_search(ci, &st, t0);
+  return n;
+}
+
+// getters: deleted and out-of-range slots read as empty
+#define CI_GETTER(T, name, field, none)                 \
+  T name(ChunkIndex *ci, uint32_t i){                   \
+    uint64_t t0 = now_ns();                             \
+    ebr_enter();                                        \
+    const Snapshot *s = atomic_load(&ci->snap);         \
+    const Chunk *c = i < s->N ? s->slot[i] : NULL;      \
+    T r = c ? c->field : (none);                        \
+    ebr_exit();                                         \
+    hist_add(&ci->stats.meta, now_ns() - t0);           \
+    return r;                                           \
+  }
+
+CI_GETTER(const char*, ci_get_id,     id,       "")
+CI_GETTER(uint32_t,    ci_get_id_len, id_len,   0)
+CI_GETTER(const char*, ci_get_parent, parent,   "")
+CI_GETTER(const char*, ci_get_file,   file,     "")
+CI_GETTER(const char*, ci_get_ext,    ext,      "")
+CI_GETTER(uint32_t,    ci_get_start,  start_ln, 0)
+CI_GETTER(uint32_t,    ci_get_end,    end_ln,   0)
+CI_GETTER(const char*, ci_get_text,   text,     "")
+
+const char* ci_get_model(ChunkIndex *ci){
+  ebr_enter();
+  const char *m = atomic_load(&ci->snap)->model;
+  ebr_exit();
+  return m;
+}
+
+uint32_t ci_get_dim(ChunkIndex *ci){
+  ebr_enter();
+  uint32_t d = atomic_load(&ci->snap)->dim;
+  ebr_exit();
+  return d;
+}
+
+uint32_t ci_count(ChunkIndex *ci){
+  ebr_enter();
+  uint32_t n = atomic_load(&ci->snap)->N;
+  ebr_exit();
+  return n;
+}
+
+/* ---------------------------------------------------------------------
+ * Anytime search
+ *
+ * Every vector also gets an int8 code (symmetric, per-vector scale). A
+ * deadline search first ranks the whole index by code dot products, which
+ * touch a quarter of the memory of the float scan, and publishes the top K
+ * of that pass. It then rescores the best candidates with exact float dot
+ * products, best first, until the deadline, and returns the merged top K.
+ * ------------------------------------------------------------------- */
+
+typedef struct {
+  Segment  *sg;
+  uint32_t  lo, hi;
+} CodeJob;
+
+static void code_range(void *arg){
+  CodeJob *j = arg;
+  Segment *sg = j->sg;
+  for(uint32_t i = j->lo; i < j->hi; i++){
+    Chunk *c = &sg->chunks[i];
+    c->code       = sg->codes + (size_t)i * sg->dim;
+    c->code_scale = c->dim == sg->dim ? f32_quantize_i8_simd(c->emb, sg->codes + (size_t)i * sg->dim, sg->dim) : 0;
+  }
+}
+
+// The builder fans the quantisation out on the pool without holding
+// code_mu, so a search running on a pool thread can never block the tasks
+// it waits for.
+static int seg_codes(Segment *sg){
+  if(atomic_load_explicit(&sg->coded, memory_order_acquire) == CODES_READY) return 1;
+  if(!sg->dim) return 0;
+  pthread_mutex_lock(&sg->code_mu);
+  while(atomic_load_explicit(&sg->coded, memory_order_relaxed) == CODES_BUILDING)
+    pthread_cond_wait(&sg->code_cv, &sg->code_mu);
+  int st = atomic_load_explicit(&sg->coded, memory_order_relaxed);
+  if(st == CODES_NONE) atomic_store_explicit(&sg->coded, CODES_BUILDING, memory_order_relaxed);
+  pthread_mutex_unlock(&sg->code_mu);
+  if(st == CODES_READY) return 1;
+
+  int8_t *codes = malloc((size_t)sg->n * sg->dim + 1);
+  if(codes){
+    sg->codes = codes;
+    // one slice per pool thread
+    ThreadPool *tp = tp_global();
+    TpGroup g = TP_GROUP_INIT;
+    CodeJob jobs[64];
+    uint32_t nt = tp_size(tp) ? tp_size(tp) : 1;
+    if(nt > 64) nt = 64;
+    uint32_t step = (sg->n + nt - 1) / nt;
+    for(uint32_t t = 0; t < nt; t++){
+      uint32_t lo = t * step, hi = lo + step < sg->n ? lo + step : sg->n;
+      jobs[t] = (CodeJob){ sg, lo < sg->n ? lo : sg->n, hi };
+      tp_submit(tp, &g, code_range, &jobs[t]);
+    }
+    tp_wait(tp, &g);
+  }
+  pthread_mutex_lock(&sg->code_mu);
+  atomic_store_explicit(&sg->coded, codes ? CODES_READY : CODES_NONE, memory_order_release);
+  pthread_cond_broadcast(&sg->code_cv);
+  pthread_mutex_unlock(&sg->code_mu);
+  return codes != NULL;
+}
+
+static int ensure_codes(const Snapshot *s){
+  for(uint32_t k = 0; k < s->nseg; k++)
+    if(s->segs[k]->dim == s->dim && !seg_codes(s->segs[k])) return 0;
+  return s->N && s->dim;
+}
+
+static int by_score_desc(const void *a, const void *b){
+  double x = ((const Pair*)a)->score, y = ((const Pair*)b)->score;
+  return (x < y) - (x > y);
+}
+
+// Push into a size-K min-heap that is built once full.
+static void heap_push(Pair *heap, uint32_t *sz, uint32_t K, double score, uint32_t idx){
+  if(*sz < K){
+    heap[(*sz)++] = (Pair){ score, idx };
+    if(*sz == K)
+      for(int p = (int)K / 2 - 1; p >= 0; p--) sift_down(heap, (int)K, p);
+  } else if(score > heap[0].score){
+    heap[0] = (Pair){ score, idx };
+    sift_down(heap, (int)K, 0);
+  }
+}
+
+static uint32_t emit(const Pair *p, uint32_t n, uint32_t K, uint32_t *out_i, double *out_s){
+  if(n > K) n = K;
+  for(uint32_t j = 0; j < n; j++){ out_i[j] = p[j].idx; out_s[j] = p[j].score; }
+  return n;
+}
+
+static uint32_t deadline_snap(const Snapshot *s,
+                              const float *q, uint32_t dim,
+                              uint32_t K, uint32_t budget_us,
+                              uint32_t *out_i, double *out_s,
+                              ci_partial_fn on_partial, void *ud,
+                              const int *cancel, Scan *st)
+{
+  if(budget_us == 0 || dim != s->dim || K == 0 || !ensure_codes(s)){
+    uint32_t n = search_snap(s, q, dim, K, out_i, out_s, cancel, st);
+    Pair *p = scratch(SCR_CAND, (n ? n : 1) * sizeof(Pair));
+    if(!p) return 0;
+    for(uint32_t j = 0; j < n; j++) p[j] = (Pair){ out_s[j], out_i[j] };
+    qsort(p, n, sizeof(Pair), by_score_desc);
+    return emit(p, n, K, out_i, out_s);
+  }
+  uint64_t deadline = now_us() + budget_us;
+
+  // coarse pass over the whole index, keeping a candidate pool a few times
+  // larger than K; only cancel cuts it short, the budget is for refinement
+  uint32_t R = K * 4 < 64 ? 64 : K * 4;
+  Pair    *cand = scratch(SCR_CAND, R * sizeof(Pair));
+  int8_t  *q8   = scratch(SCR_Q8, dim);
+  if(!cand || !q8) return 0;
+  float    qs   = f32_quantize_i8_simd(q, q8, dim);
+  uint32_t nc   = 0;
+  for(uint32_t i = 0; i < s->N; i++){
+    if(i % CANCEL_BLOCK == 0 && i && cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED))
+      break;
+    const Chunk *c = s->slot[i];
+    if(!c || c->code_scale == 0){ st->pruned++; continue; }
+    st->scanned++;
+    int32_t dot = i8_dot_product_simd(q8, c->code, dim);
+    heap_push(cand, &nc, R, (double)dot * qs * c->code_scale, i);
+  }
+  qsort(cand, nc, sizeof(Pair), by_score_desc);
+  if(on_partial){
+    uint32_t n = emit(cand, nc, K, out_i, out_s);
+    on_partial(ud, out_i, out_s, n);
+  }
+
+  // refinement: exact scores for the most promising candidates first
+  for(uint32_t j = 0; j < nc; j++){
+    if((j & 7) == 0 && j &&
+       ((cancel && __atomic_load_n(cancel, __ATOMIC_RELAXED)) || now_us() > deadline))
+      break;
+    f32_dot_product_simd(q, s->slot[cand[j].idx]->emb, &cand[j].score, dim);
+    st->rescored++;
+  }
+  qsort(cand, nc, sizeof(Pair), by_score_desc);
+  return emit(cand, nc, K, out_i, out_s);
+}
+
+uint32_t ci_search_deadline(ChunkIndex *ci,
+                            const float *q, uint32_t dim,
+                            uint32_t K, uint32_t budget_us,
+                            uint32_t *out_i, double *out_s,
+                            ci_partial_fn on_partial, void *ud,
+                            const int *cancel)
+{
+  uint64_t t0 = now_ns();
+  Scan st = {0};
+  atomic_store_explicit(&ci->last_used, t0 / 1000u, memory_order_relaxed);
+  ebr_enter();
+  uint32_t n = deadline_snap(atomic_load(&ci->snap), q, dim, K, budget_us,
+                             out_i, out_s, on_partial, ud, cancel, &st);
+  ebr_exit();
+  count_search(ci, &st, t0);
+  return n;
+}
+
+/* ---------------------------------------------------------------------
+ * Federated search: one scan per index on the pool, then a K-way merge
+ * of the per-index top-K lists (each already best first).
+ * ------------------------------------------------------------------- */
+
+typedef struct {
+  ChunkIndex  *ci;
+  const float *q;
+  uint32_t     dim, K, budget_us, n;
+  uint32_t    *idxs;
+  double      *scores;
+} MultiJob;
+
+static void multi_one(void *arg){
+  MultiJob *j = arg;
+  j->n = ci_search_deadline(j->ci, j->q, j->dim, j->K, j->budget_us,
+                            j->idxs, j->scores, NULL, NULL, NULL);
+}
+
+uint32_t ci_search_multi(ChunkIndex **cis, uint32_t n,
+                         const float *q, uint32_t dim,
+                         uint32_t K, uint32_t budget_us,
+                         uint32_t *out_src, uint32_t *out_i, double *out_s)
+{
+  if(n == 0 || K == 0) return 0;
+  MultiJob *jobs = calloc(n, sizeof *jobs);
+  uint32_t *idxs = malloc((size_t)n * K * sizeof *idxs);
+  double   *scs  = malloc((size_t)n * K * sizeof *scs);
+  uint32_t *head = calloc(n, sizeof *head);
+  uint32_t  hits = 0;
+  if(!jobs || !idxs || !scs || !head) goto done;
+
+  ThreadPool *tp = tp_global();
+  TpGroup g = TP_GROUP_INIT;
+  for(uint32_t k = 0; k < n; k++){
+    jobs[k] = (MultiJob){ cis[k], q, dim, K, budget_us, 0,
+                          idxs + (size_t)k * K, scs + (size_t)k * K };
+    // scores under another embedding space would not be comparable
+    if(cis[k] && ci_get_dim(cis[k]) == dim) tp_submit(tp, &g, multi_one, &jobs[k]);
+  }
+  tp_wait(tp, &g);
+
+  // a handful of indexes: a linear scan over the list heads is enough
+  while(hits < K){
+    uint32_t best = n;
+    for(uint32_t k = 0; k < n; k++)
+      if(head[k] < jobs[k].n && (best == n || jobs[k].scores[head[k]] > jobs[best].scores[head[best]]))
+        best = k;
+    if(best == n) break;
+    out_src[hits] = best;
+    out_i[hits]   = jobs[best].idxs[head[best]];
+    out_s[hits]   = jobs[best].scores[head[best]];
+    head[best]++;
+    hits++;
+  }
+
+done:
+  free(jobs); free(idxs); free(scs); free(head);
+  return hits;
+}
+
+/* ---------------------------------------------------------------------
+ * Statistics
+ * ------------------------------------------------------------------- */
+
+static void hist_get(Hist *h, CiHist *out){
+  out->count  = atomic_load_explicit(&h->count, memory_order_relaxed);
+  out->sum_ns = atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+  out->max_ns = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+  for(uint32_t b = 0; b < CI_HIST_BUCKETS; b++)
+    out->buckets[b] = atomic_load_explicit(&h->b[b], memory_order_relaxed);
+}
+
+static void hist_reset(Hist *h){
+  atomic_store_explicit(&h->count, 0, memory_order_relaxed);
+  atomic_store_explicit(&h->sum_ns, 0, memory_order_relaxed);
+  atomic_store_explicit(&h->max_ns, 0, memory_order_relaxed);
+  for(uint32_t b = 0; b < CI_HIST_BUCKETS; b++)
+    atomic_store_explicit(&h->b[b], 0, memory_order_relaxed);
+}
+
+void ci_stats_get(ChunkIndex *ci, CiStats *out){
+  Stats *st = &ci->stats;
+  out->queries       = atomic_load_explicit(&st->queries, memory_order_relaxed);
+  out->rows_scanned  = atomic_load_explicit(&st->scanned, memory_order_relaxed);
+  out->rows_pruned   = atomic_load_explicit(&st->pruned, memory_order_relaxed);
+  out->rows_rescored = atomic_load_explicit(&st->rescored, memory_order_relaxed);
+  out->cache_hits    = atomic_load_explicit(&st->cache_hits, memory_order_relaxed);
+  out->prep_hits     = atomic_load_explicit(&st->prep_hits, memory_order_relaxed);
+  out->prep_builds   = atomic_load_explicit(&st->prep_builds, memory_order_relaxed);
+  hist_get(&st->load, &out->load);
+  hist_get(&st->search, &out->search);
+  hist_get(&st->meta, &out->meta);
+}
+
+void ci_stats_reset(ChunkIndex *ci){
+  Stats *st = &ci->stats;
+  _Atomic uint64_t *c[] = { &st->queries, &st->scanned, &st->pruned, &st->rescored,
+                            &st->cache_hits, &st->prep_hits, &st->prep_builds };
+  for(size_t k = 0; k < sizeof c / sizeof c[0]; k++) atomic_store_explicit(c[k], 0, memory_order_relaxed);
+  hist_reset(&st->load);
+  hist_reset(&st->search);
+  hist_reset(&st->meta);
+}
+
+uint64_t ci_hist_quantile(const CiHist *h, double q){
+  if(!h->count) return 0;
+  uint64_t rank = (uint64_t)(q * (double)(h->count - 1)) + 1, seen = 0;
+  for(uint32_t b = 0; b < CI_HIST_BUCKETS; b++){
+    seen += h->buckets[b];
+    if(seen < rank) continue;
+    if(b < 8) return b;
+    // upper edge of the bucket, capped by the largest value seen
+    uint32_t e = b / 8 + 2;
+    uint64_t hi = ((uint64_t)(8 + b % 8 + 1) << (e - 3)) - 1;
+    return hi < h->max_ns ? hi : h->max_ns;
+  }
+  return h->max_ns;
+}
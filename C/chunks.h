@@ -1,18 +1,87 @@
 // chunks.h
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 
+// chunks.bin layout (little-endian):
+//   u32 magic "APCI", u32 version, str model, u32 dim, u32 N
+//   N x { str id, str parent, str file, str ext, u32 start, u32 end,
+//         str text, u32 dim, f32 emb[dim] }
+// where str is u32 length + bytes. Legacy files start directly with N.
+// id is the raw content hash of the chunk (16 bytes, or 32 for SHA-256
+// ids); files written before that hold 64 hex characters instead.
+#define CI_MAGIC   0x49435041u
+#define CI_VERSION 2
+
 // Opaque handle
+//
+// Thread safety: any number of threads may search and read one index at
+// once; the read path takes no locks and each thread keeps its own search
+// scratch. Writers (ci_append, ci_delete_file, ci_reload) are serialised
+// among themselves and never block readers: they publish a new snapshot
+// and the old one is freed by epoch-based reclamation once no reader can
+// still see it. Results are slot indices, which stay stable across appends
+// and deletes (a deleted slot reads as "" / 0) and are reset by a reload.
+// Strings returned by the getters stay valid until their chunk is deleted
+// or the index reloaded; a caller racing such writers brackets the search
+// and the getter calls with ci_pin/ci_unpin. ci_free must not race with
+// any other call on the index.
 typedef struct ChunkIndex ChunkIndex;
 
 // Load the entire chunks.bin into an arena and parse headers.
-// Returns NULL on error.
+// Returns NULL on error (missing, truncated or newer-version file).
 ChunkIndex* ci_load(const char *filename);
 
+// Like ci_load, but through a prepared cache (cache_path, or <filename>.prep
+// when NULL) that every process maps read-only, so concurrent editors share
+// one copy of the index. A missing or stale cache (the key is the size,
+// mtime and inode of `filename`) is rebuilt atomically; when it cannot be
+// written the index is loaded privately. ci_reload keeps using the cache.
+ChunkIndex* ci_load_shared(const char *filename, const char *cache_path);
+
 // Free everything (arena + index array)
 void ci_free(ChunkIndex *ci);
 
+// Process-wide registry: every ci_open of the same file (by canonical
+// path) returns the same index, loaded on first use (through the prepared
+// cache when `shared`; the first opener decides) and freed by the last
+// ci_close. Returns NULL on error. Release registry handles with ci_close,
+// never ci_free.
+ChunkIndex* ci_open(const char *filename, int shared);
+void        ci_close(ChunkIndex *ci);
+
+// Memory budget for the registry (0, the default, disables it). With a
+// budget, closed indexes stay cached for a later ci_open; whenever the
+// registry changes, the least recently searched indexes (never the most
+// recent one) are freed if unreferenced, or else go cold: their shared
+// mapping is dropped from this process until they are searched again.
+// Private copies (not loaded through the cache) can only be freed.
+void   ci_set_budget(size_t bytes);
+
+// Bytes the index holds in memory: private buffers and tables, plus pages
+// of its shared mapping currently in the page cache.
+size_t ci_resident_bytes(ChunkIndex *ci);
+
+// Append the chunks of another chunks.bin built with the same model and
+// dimension. Returns the number of chunks added, or -1.
+int32_t ci_append(ChunkIndex *ci, const char *filename);
+
+// Delete every chunk of `file`. Returns the number removed, or -1.
+int32_t ci_delete_file(ChunkIndex *ci, const char *file);
+
+// Replace the whole index with `filename`. Returns 0, or -1 and keeps the
+// current contents.
+int     ci_reload(ChunkIndex *ci, const char *filename);
+
+// Keep every snapshot visible to this thread alive until ci_unpin.
+// Nestable; must be paired on the same thread.
+void ci_pin  (void);
+void ci_unpin(void);
+
+// Number of slots, including deleted ones.
+uint32_t ci_count(ChunkIndex *ci);
+
 // Query top-K nearest neighbors by dot-product on unit vectors.
 //   qemb: float32[dim]  (must be normalized already)
 // Returns the number of hits (≤ K), and fills out_idxs[.] and out_scores[.]
@@ -25,11 +94,97 @@ uint32_t ci_search(
   double      *out_scores
 );
 
+// ci_search that stops early once *cancel becomes non-zero (checked every
+// 1024 chunks; set it atomically from another thread). The hits
+// found so far are returned.
+uint32_t ci_search_cancellable(
+  ChunkIndex *ci,
+  const float *qemb,
+  uint32_t     dim,
+  uint32_t     K,
+  uint32_t    *out_idxs,
+  double      *out_scores,
+  const int   *cancel
+);
+
+// Anytime search with a time budget in microseconds. Ranks the whole index
+// by int8 codes (always to completion, only `cancel` stops it), reports
+// that provisional top K through on_partial (may be NULL; called on the
+// searching thread), then rescores candidates with exact dot products
+// until the budget runs out. Hits are returned best first; candidates not
+// rescored in time keep their approximate score. budget_us == 0 means an
+// exact search. The codes are built on first use.
+typedef void (*ci_partial_fn)(void *ud, const uint32_t *idxs, const double *scores, uint32_t n);
+
+uint32_t ci_search_deadline(
+  ChunkIndex   *ci,
+  const float  *qemb,
+  uint32_t      dim,
+  uint32_t      K,
+  uint32_t      budget_us,
+  uint32_t     *out_idxs,
+  double       *out_scores,
+  ci_partial_fn on_partial,
+  void         *ud,
+  const int    *cancel
+);
+
+// Search n indexes (built with the same embedding model) in parallel and
+// merge their hits into one best-first list of at most K. Hit j is slot
+// out_idxs[j] of cis[out_src[j]]. NULL entries and indexes of another
+// dimension are skipped. budget_us as for ci_search_deadline.
+uint32_t ci_search_multi(
+  ChunkIndex  **cis,
+  uint32_t      n,
+  const float  *qemb,
+  uint32_t      dim,
+  uint32_t      K,
+  uint32_t      budget_us,
+  uint32_t     *out_src,
+  uint32_t     *out_idxs,
+  double       *out_scores
+);
+
+// Statistics, kept per index with relaxed atomics (no locks on any path):
+// every search counts the slots it scored and those it skipped (deleted,
+// or with another dimension), the anytime search the candidates it
+// rescored exactly; ci_open counts registry hits, the prepared cache how
+// often it was mapped as is or had to be (re)built. Latency histograms
+// cover loads (ci_load*, ci_append, ci_reload), searches and metadata
+// getters. Buckets are log-linear in nanoseconds (exact below 8 ns, then
+// 8 per power of two: within 12.5%).
+#define CI_HIST_BUCKETS 496
+
+typedef struct {
+  uint64_t count, sum_ns, max_ns;
+  uint64_t buckets[CI_HIST_BUCKETS];
+} CiHist;
+
+typedef struct {
+  uint64_t queries;
+  uint64_t rows_scanned, rows_pruned, rows_rescored;
+  uint64_t cache_hits, prep_hits, prep_builds;
+  CiHist   load, search, meta;
+} CiStats;
+
+// Snapshot of the counters (each read atomically, not all at one instant).
+void     ci_stats_get  (ChunkIndex *ci, CiStats *out);
+void     ci_stats_reset(ChunkIndex *ci);
+
+// Latency at quantile q (0..1) in ns, to the bucket's resolution.
+uint64_t ci_hist_quantile(const CiHist *h, double q);
+
 // Metadata getters
 const char* ci_get_id      (ChunkIndex*, uint32_t idx);
+uint32_t    ci_get_id_len  (ChunkIndex*, uint32_t idx);
 const char* ci_get_parent  (ChunkIndex*, uint32_t idx);
 const char* ci_get_file    (ChunkIndex*, uint32_t idx);
 const char* ci_get_ext     (ChunkIndex*, uint32_t idx);
 uint32_t    ci_get_start   (ChunkIndex*, uint32_t idx);
 uint32_t    ci_get_end     (ChunkIndex*, uint32_t idx);
 const char* ci_get_text    (ChunkIndex*, uint32_t idx);
+
+// Embedding model recorded at build time ("" for legacy files, HX_MODEL for
+// the built-in hashing embedder) and the index dimension.
+const char* ci_get_model   (ChunkIndex*);
+uint32_t    ci_get_dim     (ChunkIndex*);
@@ -0,0 +1,355 @@
+// content_hash.c
+#include "content_hash.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    #include <cpuid.h>
+    #include <immintrin.h>
+#endif
+
+/* ---------------------------------------------------------------------
+ * 128-bit stripe hash
+ * ------------------------------------------------------------------- */
+
+#define P32_1 0x9E3779B1u
+#define P64_1 0x9E3779B185EBCA87ull
+#define P64_2 0xC2B2AE3D27D4EB4Full
+#define P64_3 0x165667B19E3779F9ull
+
+#define SECRET_LEN   192
+#define STRIPE       64
+#define STRIPES_BLK  ((SECRET_LEN - STRIPE) / 8)   // stripes per scramble
+
+static const uint8_t secret[SECRET_LEN] = {
+  0xf4, 0x65, 0xb9, 0xa1, 0x6a, 0x9e, 0x78, 0x6e, 0x4f, 0x45, 0x09, 0x80, 0x18, 0x5d, 0xc4, 0x06,
+  0xec, 0x81, 0x4c, 0x72, 0xa8, 0xb8, 0x8b, 0xf8, 0x9b, 0x74, 0xa8, 0x51, 0x6a, 0x89, 0x39, 0x1b,
+  0xea, 0xa2, 0x7e, 0x74, 0x0c, 0x9f, 0xcb, 0x53, 0xe1, 0x32, 0x45, 0x1f, 0xbe, 0x9a, 0x82, 0x2c,
+  0x3c, 0xab, 0x16, 0xc9, 0x3a, 0x13, 0x84, 0xc5, 0xc3, 0x8a, 0xc9, 0x41, 0x90, 0x78, 0xe5, 0x3e,
+  0xa6, 0xb0, 0x8c, 0x36, 0x8c, 0x48, 0xb8, 0xf3, 0x09, 0x3d, 0xb1, 0x3c, 0xdd, 0xec, 0x7e, 0x65,
+  0xf6, 0xde, 0x5b, 0x05, 0xe0, 0x26, 0xd3, 0xc2, 0x7b, 0xdb, 0xbb, 0xe0, 0x3f, 0xa0, 0x21, 0x86,
+  0x2f, 0xa9, 0x3a, 0x98, 0x55, 0x75, 0x1f, 0x8e, 0x19, 0x4d, 0xcc, 0x00, 0x16, 0x0f, 0x4e, 0xb5,
+  0xab, 0x80, 0x1d, 0x97, 0x97, 0x3f, 0xbb, 0x84, 0x55, 0x12, 0x52, 0x75, 0x5c, 0x82, 0x29, 0x7d,
+  0x86, 0x7f, 0x7f, 0x2b, 0x10, 0x17, 0xcf, 0xc3, 0x64, 0x4f, 0x91, 0x83, 0xa0, 0xe9, 0x66, 0x34,
+  0xac, 0x85, 0x44, 0x5a, 0x2b, 0x8d, 0x1a, 0xd8, 0xd7, 0x9e, 0x0b, 0x10, 0x2b, 0x60, 0x01, 0xdb,
+  0x0d, 0xf1, 0x25, 0x18, 0x92, 0x8a, 0x03, 0xa9, 0x6a, 0x2f, 0xca, 0x0d, 0xd9, 0xf1, 0xf5, 0xed,
+  0x4c, 0x63, 0xd2, 0x7b, 0xd6, 0x6a, 0x49, 0x54, 0x69, 0x72, 0x40, 0xf5, 0xd4, 0x01, 0x7c, 0xdd,
+};
+
+static inline uint64_t rd64(const void *p){ uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint32_t rd32(const void *p){ uint32_t v; memcpy(&v, p, 4); return v; }
+static inline void     wr64(void *p, uint64_t v){ memcpy(p, &v, 8); }
+
+static inline uint64_t mul_fold64(uint64_t a, uint64_t b){
+  __uint128_t m = (__uint128_t)a * b;
+  return (uint64_t)m ^ (uint64_t)(m >> 64);
+}
+
+static inline uint64_t avalanche(uint64_t h){
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ull;
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t mix16(const uint8_t *in, const uint8_t *sec, uint64_t seed){
+  return mul_fold64(rd64(in) ^ (rd64(sec) + seed), rd64(in + 8) ^ (rd64(sec + 8) - seed));
+}
+
+static void hash_0to16(const uint8_t *p, size_t len, uint64_t seed, uint64_t *lo, uint64_t *hi){
+  if(len > 8){
+    uint64_t a = rd64(p) ^ (rd64(secret + 32) + seed);
+    uint64_t b = rd64(p + len - 8) ^ (rd64(secret + 40) - seed);
+    uint64_t c = rd64(p) ^ (rd64(secret + 48) - seed);
+    uint64_t d = rd64(p + len - 8) ^ (rd64(secret + 56) + seed);
+    *lo = avalanche(len + mul_fold64(a, b));
+    *hi = avalanche(len * P64_2 + mul_fold64(c, d));
+  } else if(len >= 4){
+    uint64_t v = ((uint64_t)rd32(p) << 32 | rd32(p + len - 4)) + len;
+    *lo = avalanche(mul_fold64(v ^ (rd64(secret + 8) + seed), P64_1 + (len << 2)));
+    *hi = avalanche(mul_fold64(v ^ (rd64(secret + 16) - seed), P64_2 + (len << 2)));
+  } else if(len){
+    uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[len >> 1] << 24 | p[len - 1] | (uint32_t)len << 8;
+    *lo = avalanche((v ^ (rd32(secret) + seed)) * P64_1);
+    *hi = avalanche((v ^ (rd32(secret + 4) - seed)) * P64_3);
+  } else {
+    *lo = avalanche(seed ^ rd64(secret + 56) ^ rd64(secret + 64));
+    *hi = avalanche(seed ^ rd64(secret + 72) ^ rd64(secret + 80));
+  }
+}
+
+// 17..240 bytes: 16-byte blocks folded with mix16 into two accumulators,
+// reading both ends first so every byte counts for short inputs too.
+static void hash_17to240(const uint8_t *p, size_t len, uint64_t seed, uint64_t *lo, uint64_t *hi){
+  uint64_t a = len * P64_1, b = 0;
+  size_t nb = len / 16;
+  for(size_t i = 0; i < nb; i++){
+    const uint8_t *s = secret + (i * 16) % (SECRET_LEN - 16);
+    a += mix16(p + i * 16, s, seed);
+    b += mix16(p + i * 16, s + 3, seed) ^ rd64(p + i * 16 + 8);
+  }
+  a += mix16(p + len - 16, secret + 119, -seed);
+  b ^= mix16(p + len - 16, secret + 103, seed) + rd64(p + len - 16);
+  *lo = avalanche(a);
+  *hi = avalanche(a * P64_2 + b * P64_3 + (len - seed) * P64_1);
+}
+
+#if defined(__AVX2__)
+static inline void accumulate(uint64_t *acc, const uint8_t *in, const uint8_t *sec){
+  for(int i = 0; i < 2; i++){
+    __m256i a = _mm256_loadu_si256((const __m256i*)acc + i);
+    __m256i d = _mm256_loadu_si256((const __m256i*)in  + i);
+    __m256i k = _mm256_xor_si256(d, _mm256_loadu_si256((const __m256i*)sec + i));
+    __m256i p = _mm256_mul_epu32(k, _mm256_shuffle_epi32(k, _MM_SHUFFLE(0,3,0,1)));
+    a = _mm256_add_epi64(a, _mm256_shuffle_epi32(d, _MM_SHUFFLE(1,0,3,2)));
+    _mm256_storeu_si256((__m256i*)acc + i, _mm256_add_epi64(a, p));
+  }
+}
+static inline void scramble(uint64_t *acc, const uint8_t *sec){
+  const __m256i prime = _mm256_set1_epi32((int)P32_1);
+  for(int i = 0; i < 2; i++){
+    __m256i a = _mm256_loadu_si256((const __m256i*)acc + i);
+    a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*)sec + i));
+    __m256i lo = _mm256_mul_epu32(a, prime);
+    __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+    _mm256_storeu_si256((__m256i*)acc + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+  }
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline void accumulate(uint64_t *acc, const uint8_t *in, const uint8_t *sec){
+  for(int i = 0; i < 4; i++){
+    uint64x2_t a = vld1q_u64(acc + 2*i);
+    uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(in  + 16*i));
+    uint64x2_t k = veorq_u64(d, vreinterpretq_u64_u8(vld1q_u8(sec + 16*i)));
+    uint32x2_t klo = vmovn_u64(k), khi = vshrn_n_u64(k, 32);
+    a = vaddq_u64(a, vextq_u64(d, d, 1));
+    vst1q_u64(acc + 2*i, vmlal_u32(a, klo, khi));
+  }
+}
+static inline void scramble(uint64_t *acc, const uint8_t *sec){
+  for(int i = 0; i < 4; i++){
+    uint64x2_t a = vld1q_u64(acc + 2*i);
+    a = veorq_u64(a, vshrq_n_u64(a, 47));
+    a = veorq_u64(a, vreinterpretq_u64_u8(vld1q_u8(sec + 16*i)));
+    uint32x2_t lo = vmovn_u64(a), hi = vshrn_n_u64(a, 32);
+    uint64x2_t r = vshlq_n_u64(vmull_u32(hi, vdup_n_u32(P32_1)), 32);
+    vst1q_u64(acc + 2*i, vmlal_u32(r, lo, vdup_n_u32(P32_1)));
+  }
+}
+#else
+static inline void accumulate(uint64_t *acc, const uint8_t *in, const uint8_t *sec){
+  for(int i = 0; i < 8; i++){
+    uint64_t d = rd64(in + 8*i), k = d ^ rd64(sec + 8*i);
+    acc[i ^ 1] += d;
+    acc[i] += (k & 0xFFFFFFFFu) * (k >> 32);
+  }
+}
+static inline void scramble(uint64_t *acc, const uint8_t *sec){
+  for(int i = 0; i < 8; i++){
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= rd64(sec + 8*i);
+    acc[i] = a * P32_1;
+  }
+}
+#endif
+
+static uint64_t merge(const uint64_t *acc, const uint8_t *sec, uint64_t start){
+  uint64_t r = start;
+  for(int i = 0; i < 4; i++)
+    r += mul_fold64(acc[2*i] ^ rd64(sec + 16*i), acc[2*i+1] ^ rd64(sec + 16*i + 8));
+  return avalanche(r);
+}
+
+static void hash_long(const uint8_t *p, size_t len, uint64_t seed, uint64_t *lo, uint64_t *hi){
+  uint64_t acc[8] = { P32_1, P64_1, P64_2, P64_3, 0x85EBCA77u, 0xC2B2AE3Du, P64_1 ^ seed, 0x27D4EB2Fu };
+  const size_t blk = STRIPE * STRIPES_BLK;
+  size_t nblk = (len - 1) / blk;
+  for(size_t b = 0; b < nblk; b++){
+    for(size_t s = 0; s < STRIPES_BLK; s++)
+      accumulate(acc, p + b * blk + s * STRIPE, secret + s * 8);
+    scramble(acc, secret + SECRET_LEN - STRIPE);
+  }
+  size_t rest = ((len - 1) - nblk * blk) / STRIPE;
+  for(size_t s = 0; s < rest; s++)
+    accumulate(acc, p + nblk * blk + s * STRIPE, secret + s * 8);
+  accumulate(acc, p + len - STRIPE, secret + SECRET_LEN - STRIPE - 7);
+
+  *lo = merge(acc, secret + 11, len * P64_1 ^ seed);
+  *hi = merge(acc, secret + SECRET_LEN - STRIPE - 11, ~(len * P64_2) - seed);
+}
+
+void ch_hash128(const void *data, size_t len, uint64_t seed, uint8_t out[16]){
+  const uint8_t *p = data;
+  uint64_t lo, hi;
+  if(len <= 16)       hash_0to16  (p, len, seed, &lo, &hi);
+  else if(len <= 240) hash_17to240(p, len, seed, &lo, &hi);
+  else                hash_long   (p, len, seed, &lo, &hi);
+  wr64(out, lo);
+  wr64(out + 8, hi);
+}
+
+/* ---------------------------------------------------------------------
+ * SHA-256
+ * ------------------------------------------------------------------- */
+
+static const uint32_t K256[64] = {
+  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2,
+};
+
+typedef void (*sha_blocks_fn)(uint32_t st[8], const uint8_t *p, size_t nblk);
+
+#define ROR(x,n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha_blocks_portable(uint32_t st[8], const uint8_t *p, size_t nblk){
+  for(; nblk--; p += 64){
+    uint32_t w[64];
+    for(int i = 0; i < 16; i++)
+      w[i] = (uint32_t)p[4*i] << 24 | (uint32_t)p[4*i+1] << 16 | (uint32_t)p[4*i+2] << 8 | p[4*i+3];
+    for(int i = 16; i < 64; i++){
+      uint32_t s0 = ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3);
+      uint32_t s1 = ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10);
+      w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+    uint32_t a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+    for(int i = 0; i < 64; i++){
+      uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + K256[i] + w[i];
+      uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+    st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+    st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Intel SHA extensions: state is kept as ABEF/CDGH, four rounds per pair
+// of sha256rnds2, message schedule with sha256msg1/msg2.
+__attribute__((target("sha,sse4.1")))
+static void sha_blocks_shani(uint32_t st[8], const uint8_t *p, size_t nblk){
+  const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+  __m128i t   = _mm_loadu_si128((const __m128i*)st);        // DCBA
+  __m128i s1  = _mm_loadu_si128((const __m128i*)(st + 4));  // HGFE
+  t  = _mm_shuffle_epi32(t, 0xB1);                          // CDAB
+  s1 = _mm_shuffle_epi32(s1, 0x1B);                         // EFGH
+  __m128i s0 = _mm_alignr_epi8(t, s1, 8);                   // ABEF
+  s1 = _mm_blend_epi16(s1, t, 0xF0);                        // CDGH
+
+  for(; nblk--; p += 64){
+    __m128i a0 = s0, c0 = s1, m[4], msg;
+    for(int i = 0; i < 4; i++)
+      m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16*i)), bswap);
+    for(int r = 0; r < 16; r++){
+      __m128i w = m[r & 3];
+      msg = _mm_add_epi32(w, _mm_loadu_si128((const __m128i*)(K256 + 4*r)));
+      s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0E);
+      s0 = _mm_sha256rnds2_epu32(s0, s1, msg);
+      if(r < 12){
+        // extend the schedule: W[r+4] from W[r..r+3]
+        __m128i x = _mm_sha256msg1_epu32(m[r & 3], m[(r + 1) & 3]);
+        x = _mm_add_epi32(x, _mm_alignr_epi8(m[(r + 3) & 3], m[(r + 2) & 3], 4));
+        m[r & 3] = _mm_sha256msg2_epu32(x, m[(r + 3) & 3]);
+      }
+    }
+    s0 = _mm_add_epi32(s0, a0);
+    s1 = _mm_add_epi32(s1, c0);
+  }
+
+  t  = _mm_shuffle_epi32(s0, 0x1B);                         // FEBA
+  s1 = _mm_shuffle_epi32(s1, 0xB1);                         // DCHG
+  s0 = _mm_blend_epi16(t, s1, 0xF0);                        // DCBA
+  s1 = _mm_alignr_epi8(s1, t, 8);                           // HGFE
+  _mm_storeu_si128((__m128i*)st, s0);
+  _mm_storeu_si128((__m128i*)(st + 4), s1);
+}
+
+static int has_shani(void){
+  unsigned a, b, c, d;
+  if(!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return 0;
+  if(!(b & (1u << 29))) return 0;                // SHA
+  __get_cpuid(1, &a, &b, &c, &d);
+  return (c & (1u << 19)) && (c & (1u << 9));    // SSE4.1, SSSE3
+}
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+static void sha_blocks_armv8(uint32_t st[8], const uint8_t *p, size_t nblk){
+  uint32x4_t s0 = vld1q_u32(st), s1 = vld1q_u32(st + 4);
+  for(; nblk--; p += 64){
+    uint32x4_t a0 = s0, e0 = s1, m[4];
+    for(int i = 0; i < 4; i++)
+      m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 16*i)));
+    for(int r = 0; r < 16; r++){
+      uint32x4_t w = vaddq_u32(m[r & 3], vld1q_u32(K256 + 4*r));
+      if(r < 12)
+        m[r & 3] = vsha256su1q_u32(vsha256su0q_u32(m[r & 3], m[(r + 1) & 3]),
+                                   m[(r + 2) & 3], m[(r + 3) & 3]);
+      uint32x4_t t = s0;
+      s0 = vsha256hq_u32(s0, s1, w);
+      s1 = vsha256h2q_u32(s1, t, w);
+    }
+    s0 = vaddq_u32(s0, a0);
+    s1 = vaddq_u32(s1, e0);
+  }
+  vst1q_u32(st, s0);
+  vst1q_u32(st + 4, s1);
+}
+#endif
+
+static sha_blocks_fn  sha_fn;
+static pthread_once_t sha_once = PTHREAD_ONCE_INIT;
+
+static void sha_pick(void){
+#if defined(__x86_64__) || defined(__i386__)
+  sha_fn = has_shani() ? sha_blocks_shani : sha_blocks_portable;
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+  sha_fn = sha_blocks_armv8;
+#else
+  sha_fn = sha_blocks_portable;
+#endif
+}
+
+// chunks are hashed from pool threads: pick once, race-free
+static sha_blocks_fn sha_blocks(void){
+  pthread_once(&sha_once, sha_pick);
+  return sha_fn;
+}
+
+void ch_sha256(const void *data, size_t len, uint8_t out[32]){
+  uint32_t st[8] = { 0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,
+                     0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19 };
+  sha_blocks_fn blocks = sha_blocks();
+  const uint8_t *p = data;
+  size_t full = len / 64;
+  blocks(st, p, full);
+
+  // padding: 0x80, zeros, 64-bit big-endian bit length
+  uint8_t tail[128] = {0};
+  size_t r = len - full * 64;
+  memcpy(tail, p + full * 64, r);
+  tail[r] = 0x80;
+  size_t tl = r < 56 ? 64 : 128;
+  uint64_t bits = (uint64_t)len * 8;
+  for(int i = 0; i < 8; i++) tail[tl - 1 - i] = (uint8_t)(bits >> (8 * i));
+  blocks(st, tail, tl / 64);
+
+  for(int i = 0; i < 8; i++){
+    out[4*i]   = (uint8_t)(st[i] >> 24);
+    out[4*i+1] = (uint8_t)(st[i] >> 16);
+    out[4*i+2] = (uint8_t)(st[i] >> 8);
+    out[4*i+3] = (uint8_t)st[i];
+  }
+}
@@ -0,0 +1,18 @@
+// content_hash.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Non-cryptographic 128-bit hash in the XXH3 family: 64-byte stripes are
+// folded into eight 64-bit lanes with 32x32->64 multiplies (AVX2 / NEON
+// when available), short inputs take overlapping-read paths. Used for chunk
+// ids; not stable across library versions that change the secret.
+#define CH_HASH128_LEN 16
+#define CH_SHA256_LEN  32
+
+void ch_hash128(const void *data, size_t len, uint64_t seed, uint8_t out[16]);
+
+// SHA-256, using SHA-NI (detected at run time) or the ARMv8 crypto
+// extensions (at build time) and a portable implementation otherwise.
+void ch_sha256(const void *data, size_t len, uint8_t out[32]);
+
@@ -50,8 +50,8 @@ void norm_simd(float *v, uint32_t d) {
     for (; i < d; i++) sum += v[i] * v[i];
     float32x4_t s4 = vdupq_n_f32(sum);
     float32x4_t y = vrsqrteq_f32(s4);
-    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(s4, vmulq_f32(y, y)), y));
-    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(s4, vmulq_f32(y, y)), y));
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(s4, y), y));   // y * (3 - s*y*y) / 2
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(s4, y), y));
     float inv_norm = vgetq_lane_f32(y, 0);
     float32x4_t scale4 = vdupq_n_f32(inv_norm);
     for (i = 0; i + 4 <= d; i += 4) {
@@ -103,10 +103,10 @@ void norm_simd(float *v, uint32_t d) {
     __m512 y = _mm512_rsqrt14_ps(s);
     const __m512 half = _mm512_set1_ps(0.5f);
     const __m512 three = _mm512_set1_ps(3.0f);
-    __m512 y2 = _mm512_mul_ps(y, y);
-    y = _mm512_mul_ps(y, _mm512_mul_ps(_mm512_sub_ps(three, _mm512_mul_ps(s, _mm512_mul_ps(y2, half))), half));
+    __m512 y2 = _mm512_mul_ps(y, y);   // Newton: y * (3 - s*y*y) / 2
+    y = _mm512_mul_ps(y, _mm512_mul_ps(_mm512_sub_ps(three, _mm512_mul_ps(s, y2)), half));
     y2 = _mm512_mul_ps(y, y);
-    y = _mm512_mul_ps(y, _mm512_mul_ps(_mm512_sub_ps(three, _mm512_mul_ps(s, _mm512_mul_ps(y2, half))), half));
+    y = _mm512_mul_ps(y, _mm512_mul_ps(_mm512_sub_ps(three, _mm512_mul_ps(s, y2)), half));
     float inv_norm = _mm_cvtss_f32(_mm256_castps256_ps128(_mm512_castps512_ps256(y)));
 
     __m512 scale = _mm512_set1_ps(inv_norm);
@@ -158,11 +158,11 @@ void norm_simd(float *v, uint32_t d) {
     __m256 y = _mm256_rsqrt_ps(s);
     const __m256 half = _mm256_set1_ps(0.5f);
     const __m256 three = _mm256_set1_ps(3.0f);
-    __m256 y2 = _mm256_mul_ps(y, y);
-    __m256 t = _mm256_sub_ps(three, _mm256_mul_ps(s, _mm256_mul_ps(y2, half)));
+    __m256 y2 = _mm256_mul_ps(y, y);   // Newton: y * (3 - s*y*y) / 2
+    __m256 t = _mm256_sub_ps(three, _mm256_mul_ps(s, y2));
     y = _mm256_mul_ps(y, _mm256_mul_ps(t, half));
     y2 = _mm256_mul_ps(y, y);
-    t = _mm256_sub_ps(three, _mm256_mul_ps(s, _mm256_mul_ps(y2, half)));
+    t = _mm256_sub_ps(three, _mm256_mul_ps(s, y2));
     y = _mm256_mul_ps(y, _mm256_mul_ps(t, half));
     float inv_norm = _mm_cvtss_f32(_mm256_castps256_ps128(y));
 
@@ -194,6 +194,116 @@ void norm_simd(float *v, uint32_t d) {
 
 #endif
 
+/*  int8 dot product for the coarse codes of the anytime search: a quarter of
+ *  the memory traffic of the float scan. Codes must stay within [-127, 127].
+ *  On x86 the sign of x is moved onto y so maddubs can multiply |x| (as
+ *  unsigned) by y; pairs of products fit int16 without saturating and a
+ *  madd with ones widens them to 32 bits. NEON uses vmull + vpadal.
+ */
+#if defined(__AVX2__)
+
+int32_t i8_dot_product_simd(const int8_t *x, const int8_t *y, uint64_t size) {
+    uint64_t i = 0;
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= size; i += 32) {
+        __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i vy = _mm256_loadu_si256((const __m256i *)(y + i));
+        __m256i p  = _mm256_maddubs_epi16(_mm256_abs_epi8(vx), _mm256_sign_epi8(vy, vx));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(p, ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t sum = _mm_cvtsi128_si32(s);
+    for (; i < size; i++) sum += (int32_t)x[i] * y[i];
+    return sum;
+}
+
+float f32_quantize_i8_simd(const float *x, int8_t *out, uint64_t size) {
+    uint64_t i = 0;
+    const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 mv = _mm256_setzero_ps();
+    for (; i + 8 <= size; i += 8)
+        mv = _mm256_max_ps(mv, _mm256_and_ps(_mm256_loadu_ps(x + i), absmask));
+    __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(mv), _mm256_extractf128_ps(mv, 1));
+    m4 = _mm_max_ps(m4, _mm_movehl_ps(m4, m4));
+    m4 = _mm_max_ss(m4, _mm_shuffle_ps(m4, m4, 1));
+    float m = _mm_cvtss_f32(m4);
+    for (; i < size; i++) m = fabsf(x[i]) > m ? fabsf(x[i]) : m;
+    if (m == 0.0f) { for (i = 0; i < size; i++) out[i] = 0; return 0.0f; }
+
+    const __m256 inv = _mm256_set1_ps(127.0f / m);
+    for (i = 0; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i),      inv));
+        __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 8),  inv));
+        __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 16), inv));
+        __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 24), inv));
+        // packs work per 128-bit lane; the permute restores element order
+        __m256i ab = _mm256_packs_epi32(a, b), cd = _mm256_packs_epi32(c, d);
+        __m256i r  = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(ab, cd),
+                                                 _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)(out + i), r);
+    }
+    for (; i < size; i++) out[i] = (int8_t)lrintf(x[i] * (127.0f / m));
+    return m / 127.0f;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+int32_t i8_dot_product_simd(const int8_t *x, const int8_t *y, uint64_t size) {
+    uint64_t i = 0;
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= size; i += 16) {
+        int8x16_t vx = vld1q_s8(x + i);
+        int8x16_t vy = vld1q_s8(y + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(vx), vget_low_s8(vy)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(vx), vget_high_s8(vy)));
+    }
+    int32_t sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1)
+                + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+    for (; i < size; i++) sum += (int32_t)x[i] * y[i];
+    return sum;
+}
+
+float f32_quantize_i8_simd(const float *x, int8_t *out, uint64_t size) {
+    uint64_t i = 0;
+    float32x4_t mv = vdupq_n_f32(0.0f);
+    for (; i + 4 <= size; i += 4) mv = vmaxq_f32(mv, vabsq_f32(vld1q_f32(x + i)));
+    float m = vmaxvq_f32(mv);
+    for (; i < size; i++) m = fabsf(x[i]) > m ? fabsf(x[i]) : m;
+    if (m == 0.0f) { for (i = 0; i < size; i++) out[i] = 0; return 0.0f; }
+
+    const float inv = 127.0f / m;
+    for (i = 0; i + 8 <= size; i += 8) {
+        int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(x + i),     inv));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(x + i + 4), inv));
+        int16x8_t h = vcombine_s16(vqmovn_s32(a), vqmovn_s32(b));
+        vst1_s8(out + i, vqmovn_s16(h));
+    }
+    for (; i < size; i++) out[i] = (int8_t)lrintf(x[i] * inv);
+    return m / 127.0f;
+}
+
+#else
+
+int32_t i8_dot_product_simd(const int8_t *x, const int8_t *y, uint64_t size) {
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < size; i++) sum += (int32_t)x[i] * y[i];
+    return sum;
+}
+
+float f32_quantize_i8_simd(const float *x, int8_t *out, uint64_t size) {
+    float m = 0.0f;
+    for (uint64_t i = 0; i < size; i++) m = fabsf(x[i]) > m ? fabsf(x[i]) : m;
+    if (m == 0.0f) { for (uint64_t i = 0; i < size; i++) out[i] = 0; return 0.0f; }
+    const float inv = 127.0f / m;
+    for (uint64_t i = 0; i < size; i++) out[i] = (int8_t)lrintf(x[i] * inv);
+    return m / 127.0f;
+}
+
+#endif
+
 /*  Why the above code is faster even though it has ~40 more ASM instructions:
  *      1) In the cosine distance function we have 3 vector accumulations per lane, comparative to the NEON intrinsics 
  *         approx reciprocal-sqrt -> single vmlaq per lane.
@@ -22,3 +22,9 @@ void f32_dot_product_simd(
 );
 
 void norm_simd(float *v, uint32_t d);
+
+int32_t i8_dot_product_simd(const int8_t *x, const int8_t *y, uint64_t size);
+
+// Symmetric int8 quantization: out = round(x * 127 / max|x|). Returns the
+// scale that maps codes back to values (0 for an all-zero vector).
+float f32_quantize_i8_simd(const float *x, int8_t *out, uint64_t size);
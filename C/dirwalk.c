@@ -0,0 +1,379 @@
+// dirwalk.c
+#define _GNU_SOURCE
+#include "dirwalk.h"
+#include "thread_pool.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sys/syscall.h>
+#endif
+
+#define SNIFF_BYTES 1024
+
+// ---------------------------------------------------------------------
+// Ignore rules
+// ---------------------------------------------------------------------
+
+typedef struct {
+  char *pat;
+  int   negate, dir_only, anchored;
+} Rule;
+
+// Rules of one directory, chained to those of its parents. Immutable once
+// built, so sibling tasks share their parent's chain.
+typedef struct IgnoreNode {
+  const struct IgnoreNode *parent;
+  char     *base;        // directory of the ignore file, relative to root
+  size_t    base_len;
+  Rule     *rules;
+  uint32_t  n;
+  struct IgnoreNode *next_alloc;
+} IgnoreNode;
+
+// gitignore glob: '*' and '?' stop at '/', "**" crosses directories,
+// [a-z] / [!a-z] classes and backslash escapes.
+static int glob_match(const char *p, const char *s){
+  for(;;){
+    switch(*p){
+      case 0:
+        return *s == 0;
+      case '*':
+        if(p[1] == '*'){
+          p += 2;
+          if(*p == '/'){                      // "**/": zero or more dirs
+            p++;
+            for(;;){
+              if(glob_match(p, s)) return 1;
+              const char *slash = strchr(s, '/');
+              if(!slash) return 0;
+              s = slash + 1;
+            }
+          }
+          for(;; s++){                        // trailing "**" or "a**b"
+            if(glob_match(p, s)) return 1;
+            if(!*s) return 0;
+          }
+        }
+        p++;
+        for(;; s++){
+          if(glob_match(p, s)) return 1;
+          if(!*s || *s == '/') return 0;
+        }
+      case '?':
+        if(!*s || *s == '/') return 0;
+        p++; s++;
+        break;
+      case '[': {
+        if(!*s || *s == '/') return 0;
+        const char *q = p + 1;
+        int neg = *q == '!' || *q == '^';
+        if(neg) q++;
+        int hit = 0;
+        const char *first = q;
+        while(*q && (*q != ']' || q == first)){
+          char lo = *q, hi = lo;
+          if(q[1] == '-' && q[2] && q[2] != ']'){ hi = q[2]; q += 2; }
+          if(*s >= lo && *s <= hi) hit = 1;
+          q++;
+        }
+        if(*q != ']'){                        // unterminated: literal '['
+          if(*s != '[') return 0;
+          p++; s++;
+          break;
+        }
+        if(hit == neg) return 0;
+        p = q + 1; s++;
+        break;
+      }
+      case '\\':
+        if(p[1]) p++;
+        /* fallthrough */
+      default:
+        if(*p != *s) return 0;
+        p++; s++;
+    }
+  }
+}
+
+static void parse_rules(IgnoreNode *node, char *text){
+  uint32_t cap = 0;
+  for(char *line = text, *next; line && *line; line = next){
+    next = strchr(line, '\n');
+    if(next) *next++ = 0;
+    size_t L = strlen(line);
+    if(L && line[L-1] == '\r') line[--L] = 0;
+    // trailing unescaped spaces are not significant
+    while(L && line[L-1] == ' ' && !(L > 1 && line[L-2] == '\\')) line[--L] = 0;
+    if(!L || line[0] == '#') continue;
+
+    Rule r = {0};
+    if(line[0] == '!'){ r.negate = 1; line++; L--; }
+    else if(line[0] == '\\' && (line[1] == '!' || line[1] == '#')){ line++; L--; }
+    if(L && line[L-1] == '/'){ r.dir_only = 1; line[--L] = 0; }
+    if(!L) continue;
+    r.anchored = strchr(line, '/') != NULL;
+    if(line[0] == '/'){ line++; L--; }
+    if(!L) continue;
+    r.pat = strdup(line);
+
+    if(node->n == cap){
+      cap = cap ? cap * 2 : 16;
+      node->rules = realloc(node->rules, cap * sizeof(Rule));
+    }
+    node->rules[node->n++] = r;
+  }
+}
+
+static void load_rules(IgnoreNode *node, const char *path){
+  FILE *f = fopen(path, "rb");
+  if(!f) return;
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if(sz > 0 && sz < (1 << 20)){
+    char *text = malloc((size_t)sz + 1);
+    size_t n = fread(text, 1, (size_t)sz, f);
+    text[n] = 0;
+    parse_rules(node, text);
+    free(text);
+  }
+  fclose(f);
+}
+
+// Last matching rule wins, deeper ignore files override shallower ones.
+// `rel` is relative to the walk root.
+static int ignored(const IgnoreNode *chain, const char *rel, int is_dir){
+  const char *name = strrchr(rel, '/');
+  name = name ? name + 1 : rel;
+  for(const IgnoreNode *n = chain; n; n = n->parent){
+    const char *sub = rel;
+    if(n->base_len){
+      if(strncmp(rel, n->base, n->base_len) != 0 || rel[n->base_len] != '/') continue;
+      sub = rel + n->base_len + 1;
+    }
+    for(uint32_t i = n->n; i-- > 0; ){
+      const Rule *r = &n->rules[i];
+      if(r->dir_only && !is_dir) continue;
+      if(glob_match(r->pat, r->anchored ? sub : name)) return !r->negate;
+    }
+  }
+  return 0;
+}
+
+// ---------------------------------------------------------------------
+// Walk
+// ---------------------------------------------------------------------
+
+typedef struct { char *path; uint32_t type; } Entry;
+
+struct DirList {
+  Entry   *e;
+  uint32_t n, cap;
+};
+
+typedef struct {
+  const char     *root;
+  size_t          root_len;
+  uint32_t        flags;
+  ThreadPool     *tp;
+  TpGroup         group;
+  pthread_mutex_t mu;        // guards out and ignore allocations
+  DirList        *out;
+  IgnoreNode     *allocs;
+} Walk;
+
+typedef struct {
+  Walk             *w;
+  char             *rel;     // "" for root
+  const IgnoreNode *rules;
+} DirTask;
+
+static void add_entry(Walk *w, char *rel, uint32_t type){
+  pthread_mutex_lock(&w->mu);
+  DirList *dl = w->out;
+  if(dl->n == dl->cap){
+    dl->cap = dl->cap ? dl->cap * 2 : 1024;
+    dl->e = realloc(dl->e, dl->cap * sizeof(Entry));
+  }
+  dl->e[dl->n++] = (Entry){ rel, type };
+  pthread_mutex_unlock(&w->mu);
+}
+
+static int is_binary(int dirfd, const char *name){
+  int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return 0;
+  char buf[SNIFF_BYTES];
+  ssize_t n = read(fd, buf, sizeof buf);
+  close(fd);
+  return n > 0 && memchr(buf, 0, (size_t)n) != NULL;
+}
+
+static char* join(const char *a, const char *b){
+  size_t la = strlen(a), lb = strlen(b);
+  char *s = malloc(la + lb + 2);
+  if(la){ memcpy(s, a, la); s[la] = '/'; la++; }
+  memcpy(s + la, b, lb + 1);
+  return s;
+}
+
+static void walk_dir(void *arg);
+
+// Handle one directory entry; `type` is a DT_* value (may be DT_UNKNOWN).
+static void visit(DirTask *t, int dirfd, const char *name, unsigned type,
+                  const IgnoreNode *rules){
+  Walk *w = t->w;
+  if(name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) return;
+  if(strcmp(name, ".git") == 0) return;
+  if(name[0] == '.' && !(w->flags & DW_HIDDEN)) return;
+
+  struct stat st;
+  if(type == DT_UNKNOWN){
+    if(fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return;
+    type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG :
+           S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+  }
+  if(type == DT_LNK){
+    // follow links to files, never to directories
+    if(fstatat(dirfd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) return;
+    type = DT_REG;
+  }
+  if(type != DT_DIR && type != DT_REG) return;
+
+  char *rel = join(t->rel, name);
+  int dir = type == DT_DIR;
+  if(!(w->flags & DW_NO_IGNORE) && ignored(rules, rel, dir)){ free(rel); return; }
+  if(!dir && !(w->flags & DW_BINARY) && is_binary(dirfd, name)){ free(rel); return; }
+
+  add_entry(w, rel, dir ? DW_DIR : DW_FILE);
+  if(dir){
+    DirTask *c = malloc(sizeof *c);
+    c->w = w; c->rel = rel; c->rules = rules;
+    tp_submit(w->tp, &w->group, walk_dir, c);
+  }
+}
+
+#if defined(__linux__)
+struct linux_dirent64 {
+  uint64_t       d_ino;
+  int64_t        d_off;
+  unsigned short d_reclen;
+  unsigned char  d_type;
+  char           d_name[];
+};
+#endif
+
+static void walk_dir(void *arg){
+  DirTask *t = arg;
+  Walk *w = t->w;
+  char *abs = t->rel[0] ? join(w->root, t->rel) : strdup(w->root);
+  int fd = open(abs, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if(fd < 0){ free(abs); free(t); return; }
+
+  // this directory's own ignore files apply to everything below it
+  const IgnoreNode *rules = t->rules;
+  if(!(w->flags & DW_NO_IGNORE)){
+    IgnoreNode *node = calloc(1, sizeof *node);
+    char *p;
+    if(!t->rel[0]){
+      p = join(abs, ".git/info/exclude"); load_rules(node, p); free(p);
+    }
+    p = join(abs, ".gitignore"); load_rules(node, p); free(p);
+    p = join(abs, ".ignore");    load_rules(node, p); free(p);
+    if(node->n){
+      node->parent   = t->rules;
+      node->base     = strdup(t->rel);
+      node->base_len = strlen(t->rel);
+      pthread_mutex_lock(&w->mu);
+      node->next_alloc = w->allocs;
+      w->allocs = node;
+      pthread_mutex_unlock(&w->mu);
+      rules = node;
+    } else {
+      free(node);
+    }
+  }
+
+#if defined(__linux__)
+  char buf[32768];
+  for(;;){
+    long n = syscall(SYS_getdents64, fd, buf, sizeof buf);
+    if(n <= 0) break;
+    for(long off = 0; off < n; ){
+      struct linux_dirent64 *d = (struct linux_dirent64*)(buf + off);
+      visit(t, fd, d->d_name, d->d_type, rules);
+      off += d->d_reclen;
+    }
+  }
+  close(fd);
+#else
+  DIR *dir = fdopendir(fd);
+  if(dir){
+    struct dirent *d;
+    while((d = readdir(dir))) visit(t, fd, d->d_name, d->d_type, rules);
+    closedir(dir);
+  } else {
+    close(fd);
+  }
+#endif
+  free(abs);
+  if(!t->rel[0]) free(t->rel);   // child paths are owned by their entries
+  free(t);
+}
+
+// Order paths component-wise: '/' sorts before every other byte.
+static int path_cmp(const void *a, const void *b){
+  const unsigned char *x = (const unsigned char*)((const Entry*)a)->path;
+  const unsigned char *y = (const unsigned char*)((const Entry*)b)->path;
+  while(*x && *x == *y){ x++; y++; }
+  unsigned cx = *x == '/' ? 1 : (*x ? *x + 1u : 0);
+  unsigned cy = *y == '/' ? 1 : (*y ? *y + 1u : 0);
+  return (int)cx - (int)cy;
+}
+
+DirList* dw_walk(const char *root, uint32_t flags){
+  struct stat st;
+  if(stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+  Walk w = {0};
+  w.root     = root;
+  w.root_len = strlen(root);
+  w.flags    = flags;
+  w.tp       = tp_global();
+  w.out      = calloc(1, sizeof(DirList));
+  pthread_mutex_init(&w.mu, NULL);
+  atomic_init(&w.group.pending, 0);
+
+  DirTask *t = malloc(sizeof *t);
+  t->w = &w; t->rel = strdup(""); t->rules = NULL;
+  tp_submit(w.tp, &w.group, walk_dir, t);
+  tp_wait(w.tp, &w.group);
+
+  for(IgnoreNode *n = w.allocs, *next; n; n = next){
+    next = n->next_alloc;
+    for(uint32_t i = 0; i < n->n; i++) free(n->rules[i].pat);
+    free(n->rules);
+    free(n->base);
+    free(n);
+  }
+  pthread_mutex_destroy(&w.mu);
+
+  qsort(w.out->e, w.out->n, sizeof(Entry), path_cmp);
+  return w.out;
+}
+
+uint32_t    dw_count(DirList *dl){ return dl->n; }
+const char* dw_path (DirList *dl, uint32_t i){ return dl->e[i].path; }
+uint32_t    dw_type (DirList *dl, uint32_t i){ return dl->e[i].type; }
+
+void dw_free(DirList *dl){
+  if(!dl) return;
+  for(uint32_t i = 0; i < dl->n; i++) free(dl->e[i].path);
+  free(dl->e);
+  free(dl);
+}
@@ -0,0 +1,26 @@
+// dirwalk.h
+#pragma once
+#include <stdint.h>
+
+// Parallel directory walker for the indexer's file picker. Honors
+// .gitignore / .ignore files (nested, with negation, anchoring, dir-only
+// and ** patterns) plus .git/info/exclude, never descends into .git, and
+// drops binary files (NUL byte in the first block) unless asked not to.
+// Symlinks to directories are not followed.
+typedef struct DirList DirList;
+
+#define DW_FILE 0
+#define DW_DIR  1
+
+#define DW_HIDDEN    1u  // include dot-files and dot-directories
+#define DW_NO_IGNORE 2u  // ignore .gitignore / .ignore rules
+#define DW_BINARY    4u  // keep binary files
+
+// Walk `root` on the library thread pool. Entries are '/'-separated paths
+// relative to root, sorted so every directory directly precedes its
+// contents. Returns NULL if root cannot be opened.
+DirList*    dw_walk(const char *root, uint32_t flags);
+uint32_t    dw_count(DirList *dl);
+const char* dw_path (DirList *dl, uint32_t i);
+uint32_t    dw_type (DirList *dl, uint32_t i);
+void        dw_free (DirList *dl);
@@ -0,0 +1,110 @@
+// epoch.c
+#include "epoch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ *  Every thread that reads owns a record holding the epoch it entered in
+ *  (0 while outside). Retiring bumps the global epoch and tags the object
+ *  with the new value E. All accesses are sequentially consistent, so a
+ *  reader that can still hold the old snapshot loaded the epoch before the
+ *  bump and announced a value < E before loading the snapshot; the object
+ *  is freed once every announced value is >= E (or 0).
+ */
+
+typedef struct Rec {
+  _Atomic uint64_t active;   // entered epoch, 0 = quiescent
+  atomic_int       used;     // owned by a live thread
+  struct Rec      *next;
+} Rec;
+
+typedef struct Retired {
+  void            *p;
+  void           (*free_fn)(void *);
+  uint64_t         epoch;
+  struct Retired  *next;
+} Retired;
+
+static _Atomic uint64_t g_epoch = 1;
+static _Atomic(Rec *)   g_recs;
+static pthread_mutex_t  g_limbo_mu = PTHREAD_MUTEX_INITIALIZER;
+static Retired         *g_limbo;
+
+static pthread_key_t  g_key;
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+
+static _Thread_local Rec     *t_rec;
+static _Thread_local unsigned t_depth;
+
+// thread exit: hand the record to the next thread that needs one
+static void release_rec(void *p){
+  Rec *r = p;
+  atomic_store(&r->active, 0);
+  atomic_store(&r->used, 0);
+}
+
+static void make_key(void){ pthread_key_create(&g_key, release_rec); }
+
+static Rec* my_rec(void){
+  if(t_rec) return t_rec;
+  pthread_once(&g_key_once, make_key);
+  Rec *r;
+  for(r = atomic_load(&g_recs); r; r = r->next){
+    int free_slot = 0;
+    if(atomic_compare_exchange_strong(&r->used, &free_slot, 1)) break;
+  }
+  if(!r){
+    r = calloc(1, sizeof *r);
+    atomic_init(&r->used, 1);
+    r->next = atomic_load(&g_recs);
+    while(!atomic_compare_exchange_weak(&g_recs, &r->next, r));
+  }
+  pthread_setspecific(g_key, r);
+  return t_rec = r;
+}
+
+void ebr_enter(void){
+  if(t_depth++) return;
+  Rec *r = my_rec();
+  atomic_store(&r->active, atomic_load(&g_epoch));
+}
+
+void ebr_exit(void){
+  if(--t_depth) return;
+  atomic_store(&t_rec->active, 0);
+}
+
+void ebr_retire(void *p, void (*free_fn)(void *)){
+  Retired *x = malloc(sizeof *x);
+  x->p       = p;
+  x->free_fn = free_fn;
+  x->epoch   = atomic_fetch_add(&g_epoch, 1) + 1;
+  pthread_mutex_lock(&g_limbo_mu);
+  x->next = g_limbo;
+  g_limbo = x;
+  pthread_mutex_unlock(&g_limbo_mu);
+}
+
+void ebr_reclaim(void){
+  uint64_t min = UINT64_MAX;
+  for(Rec *r = atomic_load(&g_recs); r; r = r->next){
+    uint64_t a = atomic_load(&r->active);
+    if(a && a < min) min = a;
+  }
+  Retired *done = NULL;
+  pthread_mutex_lock(&g_limbo_mu);
+  for(Retired **pp = &g_limbo; *pp; ){
+    Retired *x = *pp;
+    if(x->epoch <= min){ *pp = x->next; x->next = done; done = x; }
+    else pp = &x->next;
+  }
+  pthread_mutex_unlock(&g_limbo_mu);
+  while(done){
+    Retired *x = done;
+    done = x->next;
+    x->free_fn(x->p);
+    free(x);
+  }
+}
@@ -0,0 +1,13 @@
+// epoch.h
+#pragma once
+
+// Epoch-based reclamation for the index read path. Readers bracket every
+// access to shared snapshots with ebr_enter/ebr_exit (wait-free: one
+// thread-local store each, nesting allowed). Writers publish a new snapshot
+// first, then ebr_retire the old one; ebr_reclaim frees every retired
+// object that no reader which entered before its retirement can still see.
+void ebr_enter(void);
+void ebr_exit(void);
+
+void ebr_retire(void *p, void (*free_fn)(void *));
+void ebr_reclaim(void);
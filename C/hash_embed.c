@@ -0,0 +1,204 @@
+// hash_embed.c
+#include "hash_embed.h"
+#include "cosine_simd.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#define HX_BITS    18
+#define HX_BUCKETS (1u << HX_BITS)
+
+struct HashEmbedder {
+  uint32_t  dim;
+  uint32_t  ndocs;
+  uint32_t *df;      // document frequency per feature bucket
+  uint32_t *seen;    // doc stamp per bucket, dedups features within a doc
+};
+
+HashEmbedder* hx_new(uint32_t dim){
+  if(dim == 0) return NULL;
+  HashEmbedder *hx = calloc(1, sizeof *hx);
+  hx->dim  = dim;
+  hx->df   = calloc(HX_BUCKETS, sizeof(uint32_t));
+  hx->seen = calloc(HX_BUCKETS, sizeof(uint32_t));
+  return hx;
+}
+
+void hx_free(HashEmbedder *hx){
+  if(!hx) return;
+  free(hx->df);
+  free(hx->seen);
+  free(hx);
+}
+
+// ---------------------------------------------------------------------
+// Tokenizer
+// ---------------------------------------------------------------------
+
+static inline int is_word(unsigned char c){
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+// Length of the run of non-word bytes at p (SIMD skip over punctuation and
+// whitespace, which is most of the non-identifier text in code).
+static size_t skip_nonword(const unsigned char *p, size_t n){
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i lo_a = _mm256_set1_epi8('a' - 1), hi_z = _mm256_set1_epi8('z' + 1);
+  const __m256i lo_0 = _mm256_set1_epi8('0' - 1), hi_9 = _mm256_set1_epi8('9' + 1);
+  const __m256i us   = _mm256_set1_epi8('_'),    m20  = _mm256_set1_epi8(0x20);
+  for(; i + 32 <= n; i += 32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+    __m256i l = _mm256_or_si256(v, m20);  // fold A-Z onto a-z
+    __m256i w = _mm256_or_si256(
+      _mm256_and_si256(_mm256_cmpgt_epi8(l, lo_a), _mm256_cmpgt_epi8(hi_z, l)),
+      _mm256_and_si256(_mm256_cmpgt_epi8(v, lo_0), _mm256_cmpgt_epi8(hi_9, v)));
+    w = _mm256_or_si256(w, _mm256_cmpeq_epi8(v, us));
+    // bytes >= 0x80 are negative as signed: count them as word bytes
+    uint32_t bits = (uint32_t)_mm256_movemask_epi8(w) | (uint32_t)_mm256_movemask_epi8(v);
+    if(bits) return i + (size_t)__builtin_ctz(bits);
+  }
+#endif
+  while(i < n && !is_word(p[i])) i++;
+  return i;
+}
+
+static inline uint64_t mix64(uint64_t h){
+  h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+typedef void (*feature_fn)(void *ctx, uint64_t h);
+
+static inline uint64_t fnv_lower(const unsigned char *s, size_t n, uint64_t h){
+  for(size_t i = 0; i < n; i++){
+    unsigned char c = s[i];
+    if(c >= 'A' && c <= 'Z') c += 32;
+    h = (h ^ c) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// Emit features for one identifier: its sub-tokens and, when it has more
+// than one, the whole identifier.
+static void word_features(const unsigned char *w, size_t n, feature_fn emit, void *ctx){
+  size_t parts = 0, s = 0;
+  for(size_t i = 1; i <= n; i++){
+    int cut = i == n || w[i] == '_';
+    if(!cut){
+      unsigned char a = w[i-1], b = w[i];
+      int al = a >= 'a' && a <= 'z', au = a >= 'A' && a <= 'Z', ad = a >= '0' && a <= '9';
+      int bl = b >= 'a' && b <= 'z', bu = b >= 'A' && b <= 'Z', bd = b >= '0' && b <= '9';
+      cut = (al && bu) || (ad != bd && (al || au || bl || bu)) ||
+            // "HTTPServer" -> "HTTP" | "Server"
+            (au && bu && i + 1 < n && w[i+1] >= 'a' && w[i+1] <= 'z');
+    }
+    if(cut){
+      while(s < i && w[s] == '_') s++;
+      if(i - s >= 2){
+        emit(ctx, mix64(fnv_lower(w + s, i - s, 0xcbf29ce484222325ULL)));
+        parts++;
+      }
+      s = i;
+    }
+  }
+  if(parts > 1) emit(ctx, mix64(fnv_lower(w, n, 0x84222325cbf29ce4ULL)));
+}
+
+static void tokenize(const char *text, size_t len, feature_fn emit, void *ctx){
+  const unsigned char *p = (const unsigned char*)text;
+  size_t i = 0;
+  while(i < len){
+    i += skip_nonword(p + i, len - i);
+    size_t s = i;
+    while(i < len && is_word(p[i])) i++;
+    if(i > s) word_features(p + s, i - s, emit, ctx);
+  }
+}
+
+// ---------------------------------------------------------------------
+// Document frequencies
+// ---------------------------------------------------------------------
+
+static void observe_feature(void *ctx, uint64_t h){
+  HashEmbedder *hx = ctx;
+  uint32_t b = (uint32_t)h & (HX_BUCKETS - 1);
+  if(hx->seen[b] != hx->ndocs){
+    hx->seen[b] = hx->ndocs;
+    hx->df[b]++;
+  }
+}
+
+void hx_observe(HashEmbedder *hx, const char *text, size_t len){
+  hx->ndocs++;
+  tokenize(text, len, observe_feature, hx);
+}
+
+// ---------------------------------------------------------------------
+// Embedding
+// ---------------------------------------------------------------------
+
+// Per-call term counts: open addressing on the 64-bit feature hash.
+typedef struct {
+  uint64_t *keys;
+  uint32_t *counts;
+  uint32_t  mask, used;
+} TermTable;
+
+static void tt_grow(TermTable *t){
+  TermTable n = { calloc((t->mask + 1) * 2, 8), calloc((t->mask + 1) * 2, 4), t->mask * 2 + 1, 0 };
+  for(uint32_t i = 0; i <= t->mask; i++){
+    if(!t->counts[i]) continue;
+    uint32_t j = (uint32_t)t->keys[i] & n.mask;
+    while(n.counts[j]) j = (j + 1) & n.mask;
+    n.keys[j] = t->keys[i]; n.counts[j] = t->counts[i]; n.used++;
+  }
+  free(t->keys); free(t->counts);
+  *t = n;
+}
+
+static void tt_add(TermTable *t, uint64_t h){
+  uint32_t j = (uint32_t)h & t->mask;
+  while(t->counts[j] && t->keys[j] != h) j = (j + 1) & t->mask;
+  if(!t->counts[j]){
+    t->keys[j] = h;
+    if(++t->used * 2 > t->mask){ t->counts[j] = 1; tt_grow(t); return; }
+  }
+  t->counts[j]++;
+}
+
+static void embed_feature(void *ctx, uint64_t h){ tt_add(ctx, h); }
+
+// The projection is scalar on purpose. Each feature adds into a slot picked
+// by its hash, a scatter of a few hundred terms per chunk that vectors do
+// not speed up, and a vector logf would shift the weights away from those
+// of indexes already built. Tokenising dominates the cost: its non-word
+// skip is the SIMD part, and the L2 normalisation runs through norm_simd.
+
+void hx_embed(const HashEmbedder *hx, const char *text, size_t len, float *out){
+  memset(out, 0, sizeof(float) * hx->dim);
+  TermTable t = { calloc(256, 8), calloc(256, 4), 255, 0 };
+  tokenize(text, len, embed_feature, &t);
+
+  const float ndocs = (float)hx->ndocs;
+  for(uint32_t i = 0; i <= t.mask; i++){
+    uint32_t c = t.counts[i];
+    if(!c) continue;
+    uint64_t h = t.keys[i];
+    float w = 1.0f + logf((float)c);
+    if(hx->ndocs) w *= 1.0f + logf((1.0f + ndocs) / (1.0f + (float)hx->df[(uint32_t)h & (HX_BUCKETS - 1)]));
+    // hashing trick: bucket from the high bits, sign from the top bit
+    uint32_t slot = (uint32_t)((h >> HX_BITS) % hx->dim);
+    out[slot] += (h >> 63) ? -w : w;
+  }
+  free(t.keys);
+  free(t.counts);
+  if(t.used) norm_simd(out, hx->dim);
+}
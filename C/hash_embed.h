@@ -0,0 +1,27 @@
+// hash_embed.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Offline lexical embedder: identifiers are split into lower-cased
+// sub-tokens (camelCase, snake_case, digits), each feature is hashed into a
+// signed bucket of the output vector and weighted by log-TF x IDF.
+// Deterministic, needs no server, and embeds at memory speed.
+//
+// Indexing: hx_observe() every chunk first (document frequencies), then
+// hx_embed() them. Queries: hx_embed() on a fresh embedder (IDF = 1) — the
+// document side already carries the IDF weighting.
+typedef struct HashEmbedder HashEmbedder;
+
+// Model name recorded in chunks.bin for indexes built with this embedder.
+#define HX_MODEL "hash"
+
+HashEmbedder* hx_new(uint32_t dim);
+void          hx_free(HashEmbedder *hx);
+
+// Count the features of one document towards document frequencies.
+void hx_observe(HashEmbedder *hx, const char *text, size_t len);
+
+// Embed `text` into out[dim], L2-normalised. Safe to call from several
+// threads once observation is done.
+void hx_embed(const HashEmbedder *hx, const char *text, size_t len, float *out);
@@ -0,0 +1,400 @@
+// http_client.c
+#include "http_client.h"
+#include "base64_simd.h"
+#include "json_floats.h"
+#include "search_async.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct HttpClient {
+  char     host[256];
+  char     port[8];
+  char    *path;
+  int      fd;              // -1 when not connected
+  uint32_t timeout_ms;
+  char    *buf;             // raw response (headers + body)
+  size_t   cap, len;
+  char    *body;            // decoded body, points into buf
+  size_t   body_len;
+  char     err[512];
+};
+
+static void set_err(HttpClient *hc, const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(hc->err, sizeof hc->err, fmt, ap);
+  va_end(ap);
+}
+
+HttpClient* hc_open(const char *url){
+  if(strncmp(url, "http://", 7) != 0) return NULL;
+  const char *h = url + 7;
+  const char *slash = strchr(h, '/');
+  if(!slash) slash = h + strlen(h);
+  const char *colon = memchr(h, ':', (size_t)(slash - h));
+  const char *hend  = colon ? colon : slash;
+  if(hend == h || (size_t)(hend - h) >= sizeof(((HttpClient*)0)->host)) return NULL;
+
+  HttpClient *hc = calloc(1, sizeof *hc);
+  memcpy(hc->host, h, (size_t)(hend - h));
+  if(colon){
+    size_t pl = (size_t)(slash - colon - 1);
+    if(pl == 0 || pl >= sizeof hc->port){ free(hc); return NULL; }
+    memcpy(hc->port, colon + 1, pl);
+  } else {
+    strcpy(hc->port, "80");
+  }
+  hc->path       = strdup(*slash ? slash : "/");
+  hc->fd         = -1;
+  hc->timeout_ms = 60000;
+  return hc;
+}
+
+static void disconnect(HttpClient *hc){
+  if(hc->fd >= 0) close(hc->fd);
+  hc->fd = -1;
+}
+
+void hc_close(HttpClient *hc){
+  if(!hc) return;
+  disconnect(hc);
+  free(hc->path);
+  free(hc->buf);
+  free(hc);
+}
+
+void hc_set_timeout(HttpClient *hc, uint32_t ms){
+  hc->timeout_ms = ms;
+  if(hc->fd >= 0){
+    struct timeval tv = { ms / 1000, (ms % 1000) * 1000 };
+    setsockopt(hc->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(hc->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+  }
+}
+
+const char* hc_error(HttpClient *hc){ return hc->err; }
+
+static int do_connect(HttpClient *hc){
+  struct addrinfo hints = {0}, *res, *ai;
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  int rc = getaddrinfo(hc->host, hc->port, &hints, &res);
+  if(rc != 0){
+    set_err(hc, "resolve %s: %s", hc->host, gai_strerror(rc));
+    return -1;
+  }
+  for(ai = res; ai; ai = ai->ai_next){
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if(fd < 0) continue;
+    if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0){
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+#ifdef SO_NOSIGPIPE
+      setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+      hc->fd = fd;
+      break;
+    }
+    close(fd);
+  }
+  freeaddrinfo(res);
+  if(hc->fd < 0){
+    set_err(hc, "connect %s:%s: %s", hc->host, hc->port, strerror(errno));
+    return -1;
+  }
+  hc_set_timeout(hc, hc->timeout_ms);
+  return 0;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Send headers and body in one gather write so they leave as one segment.
+static int send_request(int fd, const char *hdr, size_t hn, const char *body, size_t bn){
+  struct iovec iov[2] = { { (void*)hdr, hn }, { (void*)body, bn } };
+  struct msghdr msg = {0};
+  msg.msg_iov    = iov;
+  msg.msg_iovlen = 2;
+  while(iov[0].iov_len + iov[1].iov_len){
+    ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if(w < 0){ if(errno == EINTR) continue; return -1; }
+    for(int i = 0; i < 2; i++){
+      size_t k = (size_t)w < iov[i].iov_len ? (size_t)w : iov[i].iov_len;
+      iov[i].iov_base = (char*)iov[i].iov_base + k;
+      iov[i].iov_len -= k;
+      w -= (ssize_t)k;
+    }
+  }
+  return 0;
+}
+
+// Read more bytes into hc->buf. Returns bytes read, 0 on EOF, -1 on error.
+static ssize_t fill(HttpClient *hc){
+  if(hc->cap - hc->len < 4096){
+    hc->cap = hc->cap ? hc->cap * 2 : 65536;
+    hc->buf = realloc(hc->buf, hc->cap + 1);
+  }
+  for(;;){
+    ssize_t r = recv(hc->fd, hc->buf + hc->len, hc->cap - hc->len, 0);
+    if(r < 0 && errno == EINTR) continue;
+    if(r > 0) hc->len += (size_t)r;
+    return r;
+  }
+}
+
+// Find a header value (case-insensitive name) inside the header block.
+static const char* header(const char *hdr, const char *hend, const char *name){
+  size_t nl = strlen(name);
+  for(const char *p = hdr; p && p < hend; ){
+    const char *eol = strstr(p, "\r\n");
+    if(!eol || eol > hend) break;
+    if((size_t)(eol - p) > nl && p[nl] == ':' && strncasecmp(p, name, nl) == 0){
+      p += nl + 1;
+      while(*p == ' ' || *p == '\t') p++;
+      return p;
+    }
+    p = eol + 2;
+  }
+  return NULL;
+}
+
+// Receive one response. Returns HTTP status, 0 if the connection was closed
+// before any byte arrived (stale keep-alive), or -1 on error.
+static int recv_response(HttpClient *hc, int *keep_alive){
+  hc->len = 0;
+  char *hend = NULL;
+  while(!hend){
+    ssize_t r = fill(hc);
+    if(r == 0 && hc->len == 0) return 0;
+    if(r <= 0){ set_err(hc, "recv: %s", r ? strerror(errno) : "connection closed"); return -1; }
+    hc->buf[hc->len] = 0;
+    hend = strstr(hc->buf, "\r\n\r\n");
+  }
+  size_t hlen = (size_t)(hend - hc->buf) + 4;
+
+  int status = 0;
+  if(sscanf(hc->buf, "HTTP/1.%*d %d", &status) != 1){
+    set_err(hc, "malformed status line");
+    return -1;
+  }
+  const char *conn = header(hc->buf, hend, "Connection");
+  *keep_alive = !(conn && strncasecmp(conn, "close", 5) == 0);
+  const char *te = header(hc->buf, hend, "Transfer-Encoding");
+  const char *cl = header(hc->buf, hend, "Content-Length");
+
+  if(te && strncasecmp(te, "chunked", 7) == 0){
+    // decode chunks in place: body grows at `w`, raw data is read at `rd`
+    size_t w = hlen, rd = hlen;
+    for(;;){
+      char *eol;
+      while(hc->buf[hc->len] = 0, !(eol = strstr(hc->buf + rd, "\r\n")))
+        if(fill(hc) <= 0){ set_err(hc, "truncated chunked body"); return -1; }
+      size_t n = strtoul(hc->buf + rd, NULL, 16);
+      rd = (size_t)(eol - hc->buf) + 2;
+      while(hc->len < rd + n + 2)
+        if(fill(hc) <= 0){ set_err(hc, "truncated chunked body"); return -1; }
+      if(n == 0) break;  // trailers are not used by the servers we talk to
+      memmove(hc->buf + w, hc->buf + rd, n);
+      w += n; rd += n + 2;
+    }
+    hc->body     = hc->buf + hlen;
+    hc->body_len = w - hlen;
+  } else if(cl){
+    size_t n = strtoul(cl, NULL, 10);
+    while(hc->len < hlen + n)
+      if(fill(hc) <= 0){ set_err(hc, "truncated body"); return -1; }
+    hc->body     = hc->buf + hlen;
+    hc->body_len = n;
+  } else {
+    // no framing: body runs until the server closes the connection
+    ssize_t r;
+    while((r = fill(hc)) > 0);
+    if(r < 0){ set_err(hc, "recv: %s", strerror(errno)); return -1; }
+    hc->body     = hc->buf + hlen;
+    hc->body_len = hc->len - hlen;
+    *keep_alive  = 0;
+  }
+  hc->body[hc->body_len] = 0;
+  return status;
+}
+
+const char* hc_post(HttpClient *hc, const char *body, size_t len, size_t *out_len){
+  char req[1024];
+  int rl = snprintf(req, sizeof req,
+    "POST %s HTTP/1.1\r\n"
+    "Host: %s:%s\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: %zu\r\n"
+    "Connection: keep-alive\r\n\r\n",
+    hc->path, hc->host, hc->port, len);
+  if(rl < 0 || (size_t)rl >= sizeof req){ set_err(hc, "request line too long"); return NULL; }
+
+  // A reused connection may have been dropped by the server in the
+  // meantime; retry exactly once on a fresh connection in that case.
+  for(int attempt = 0; attempt < 2; attempt++){
+    int reused = hc->fd >= 0;
+    if(!reused && do_connect(hc) != 0) return NULL;
+
+    if(send_request(hc->fd, req, (size_t)rl, body, len) != 0){
+      set_err(hc, "send: %s", strerror(errno));
+      disconnect(hc);
+      if(reused) continue;
+      return NULL;
+    }
+    int keep = 0;
+    int status = recv_response(hc, &keep);
+    if(status <= 0){
+      disconnect(hc);
+      if(status == 0 && reused) continue;
+      if(status == 0) set_err(hc, "connection closed");
+      return NULL;
+    }
+    if(!keep) disconnect(hc);
+    if(status != 200){
+      set_err(hc, "HTTP %d: %.400s", status, hc->body);
+      return NULL;
+    }
+    if(out_len) *out_len = hc->body_len;
+    return hc->body;
+  }
+  return NULL;
+}
+
+int hc_embed(HttpClient *hc, const char *body, size_t len, float *out, uint32_t cap){
+  size_t rlen;
+  const char *res = hc_post(hc, body, len, &rlen);
+  if(!res) return -1;
+  const char *p = res;
+  while(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t' || *p == '{') p++;
+  if(strncmp(p, "\"error\"", 7) == 0){
+    set_err(hc, "%.500s", res);
+    return -1;
+  }
+  // base64 when the server honoured encoding_format, else a number array
+  const char *v = jf_find_embedding(res, rlen, 0);
+  int dim = -1;
+  if(v && *v == '"'){
+    const char *q = memchr(v + 1, '"', (size_t)(res + rlen - v - 1));
+    if(q) dim = b64_decode_floats(v + 1, (size_t)(q - v - 1), out, cap);
+  } else if(v){
+    dim = jf_parse_floats(v, res + rlen, out, cap, NULL);
+  }
+  if(dim < 0){ set_err(hc, "no embedding in response: %.400s", res); return -1; }
+  if((uint32_t)dim > cap){ set_err(hc, "embedding dim %d exceeds buffer %u", dim, cap); return -1; }
+  return dim;
+}
+
+struct HcJob {
+  HttpClient *hc;
+  char       *body;
+  size_t      len;
+  float      *out;
+  uint32_t    cap;
+  int         dim;          // HC_JOB_RUNNING until finished
+  char        err[512];
+  atomic_int  refs;         // caller + I/O thread
+  HcJob      *next;
+};
+
+static void job_unref(HcJob *j){
+  if(atomic_fetch_sub(&j->refs, 1) != 1) return;
+  free(j->body);
+  free(j->out);
+  free(j);
+}
+
+static void run_embed(HcJob *j){
+  int dim = -1;
+  // released while queued: nobody wants the answer, skip the round trip
+  if(atomic_load(&j->refs) == 1) snprintf(j->err, sizeof j->err, "cancelled");
+  else if((dim = hc_embed(j->hc, j->body, j->len, j->out, j->cap)) < 0)
+    snprintf(j->err, sizeof j->err, "%s", j->hc->err);
+  __atomic_store_n(&j->dim, dim, __ATOMIC_RELEASE);
+  ci_async_signal();
+  job_unref(j);
+}
+
+// Embeds run on one I/O thread of their own, in submission order: a slow or
+// hung server (hc_set_timeout, 60 s by default) must not pin the pool
+// workers that searches run on.
+static pthread_mutex_t io_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  io_cv = PTHREAD_COND_INITIALIZER;
+static HcJob          *io_head, *io_tail;
+static int             io_running;
+
+static void* io_worker(void *arg){
+  (void)arg;
+  pthread_mutex_lock(&io_mu);
+  for(;;){
+    while(!io_head) pthread_cond_wait(&io_cv, &io_mu);
+    HcJob *j = io_head;
+    io_head = j->next;
+    if(!io_head) io_tail = NULL;
+    pthread_mutex_unlock(&io_mu);
+    run_embed(j);
+    pthread_mutex_lock(&io_mu);
+  }
+  return NULL;
+}
+
+// Queue `j` for the I/O thread, starting it on first use.
+static int io_submit(HcJob *j){
+  pthread_mutex_lock(&io_mu);
+  if(!io_running){
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    io_running = pthread_create(&t, &attr, io_worker, NULL) == 0;
+    pthread_attr_destroy(&attr);
+    if(!io_running){ pthread_mutex_unlock(&io_mu); return -1; }
+  }
+  if(io_tail) io_tail->next = j; else io_head = j;
+  io_tail = j;
+  pthread_cond_signal(&io_cv);
+  pthread_mutex_unlock(&io_mu);
+  return 0;
+}
+
+HcJob* hc_embed_async(HttpClient *hc, const char *body, size_t len, uint32_t cap){
+  HcJob *j = calloc(1, sizeof *j);
+  if(!j) return NULL;
+  j->hc   = hc;
+  j->len  = len;
+  j->cap  = cap;
+  j->dim  = HC_JOB_RUNNING;
+  j->body = malloc(len ? len : 1);
+  j->out  = malloc((size_t)cap * sizeof(float));
+  if(!j->body || !j->out){ free(j->body); free(j->out); free(j); return NULL; }
+  memcpy(j->body, body, len);
+  atomic_init(&j->refs, 2);
+  ci_async_fd();
+  if(io_submit(j) != 0){ free(j->body); free(j->out); free(j); return NULL; }
+  return j;
+}
+
+int hc_job_result(HcJob *j, float *out){
+  int dim = __atomic_load_n(&j->dim, __ATOMIC_ACQUIRE);
+  if(dim > 0) memcpy(out, j->out, (size_t)dim * sizeof(float));
+  return dim;
+}
+
+const char* hc_job_error(HcJob *j){ return j->err; }
+
+void hc_job_release(HcJob *j){
+  if(j) job_unref(j);
+}
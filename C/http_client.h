@@ -0,0 +1,49 @@
+// http_client.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Minimal HTTP/1.1 client holding one persistent keep-alive connection to a
+// single endpoint (e.g. http://127.0.0.1:8080/v1/embeddings).
+// A client is not thread-safe: use one per thread.
+typedef struct HttpClient HttpClient;
+
+// Parse an http:// URL. Connects lazily on the first request.
+// Returns NULL on a malformed URL.
+HttpClient* hc_open(const char *url);
+
+// Close the connection and free the client.
+void hc_close(HttpClient *hc);
+
+// Per-request socket timeout in milliseconds (default 60000).
+void hc_set_timeout(HttpClient *hc, uint32_t ms);
+
+// POST `body` as application/json and return the raw response body, valid
+// until the next call on this client. Returns NULL on error (see hc_error).
+const char* hc_post(HttpClient *hc, const char *body, size_t len, size_t *out_len);
+
+// POST an embeddings request and decode data[0].embedding into out[cap].
+// Returns the vector dimension (at most cap), or -1 on error.
+int hc_embed(HttpClient *hc, const char *body, size_t len, float *out, uint32_t cap);
+
+// Run hc_embed on the library's I/O thread, never on the search pool; jobs
+// run one at a time in submission order and completion wakes ci_async_fd.
+// The client must not be used for anything else until the job finished.
+typedef struct HcJob HcJob;
+
+#define HC_JOB_RUNNING (-2)
+
+HcJob* hc_embed_async(HttpClient *hc, const char *body, size_t len, uint32_t cap);
+
+// Non-blocking: HC_JOB_RUNNING, -1 on error (see hc_job_error), else the
+// dimension of the vector copied to out[cap].
+int hc_job_result(HcJob *job, float *out);
+const char* hc_job_error(HcJob *job);
+
+// Drop the caller's reference; a running job is freed when it finishes, a
+// job still queued is dropped without sending the request.
+void hc_job_release(HcJob *job);
+
+// Description of the last error, including the server's message when the
+// request was rejected (e.g. "input is too large").
+const char* hc_error(HttpClient *hc);
@@ -0,0 +1,340 @@
+// indexd.c — apollo-indexd: serves chunk indexes over a Unix socket
+#include "chunks.h"
+#include "indexd_client.h"
+#include "indexd_proto.h"
+#include "thread_pool.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ *  One thread per connection reads framed requests and answers them in
+ *  order; batched queries fan out on the library thread pool. Indexes come
+ *  from the ci_open registry, are shared by every client and kept loaded
+ *  for the life of the daemon, so editors that restart find them warm. A
+ *  watcher thread reloads an index when its chunks.bin is replaced.
+ */
+
+#define WATCH_INTERVAL_S 1
+
+typedef struct {
+  char       *path;
+  ChunkIndex *ci;
+  struct stat st;           // of path when last (re)loaded
+} Entry;
+
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;
+static Entry         **g_idx;
+static uint32_t        g_nidx, g_capidx;
+static const char     *g_sock;
+
+static int same_file(const struct stat *a, const struct stat *b){
+  return a->st_ino == b->st_ino && a->st_dev == b->st_dev &&
+         a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+// handle (1-based) of the index at `path`, loading it on first use
+static int32_t open_index(const char *path){
+  char real[PATH_MAX];
+  ChunkIndex *ci;
+  if(!realpath(path, real) || !(ci = ci_open(real, 1))) return -1;
+
+  pthread_mutex_lock(&g_mu);
+  int32_t h = -1;
+  for(uint32_t i = 0; i < g_nidx; i++)
+    if(g_idx[i]->ci == ci) h = (int32_t)i + 1;
+  if(h > 0){
+    pthread_mutex_unlock(&g_mu);
+    ci_close(ci);             // the entry already holds a reference
+    return h;
+  }
+  Entry *e = calloc(1, sizeof *e);
+  if(e && g_nidx == g_capidx){
+    uint32_t cap = g_capidx ? g_capidx * 2 : 8;
+    Entry **p = realloc(g_idx, cap * sizeof *p);
+    if(p){ g_idx = p; g_capidx = cap; }
+  }
+  if(e && g_nidx < g_capidx && stat(real, &e->st) == 0 && (e->path = strdup(real))){
+    e->ci = ci;
+    g_idx[g_nidx++] = e;
+    h = (int32_t)g_nidx;
+  }
+  pthread_mutex_unlock(&g_mu);
+  if(h < 0){ free(e); ci_close(ci); }
+  return h;
+}
+
+// Entries are never removed, so the pointer stays valid after unlocking.
+static Entry* get_index(uint32_t h){
+  pthread_mutex_lock(&g_mu);
+  Entry *e = h >= 1 && h <= g_nidx ? g_idx[h - 1] : NULL;
+  pthread_mutex_unlock(&g_mu);
+  return e;
+}
+
+static void* watcher(void *arg){
+  (void)arg;
+  for(;;){
+    sleep(WATCH_INTERVAL_S);
+    pthread_mutex_lock(&g_mu);
+    uint32_t n = g_nidx;
+    pthread_mutex_unlock(&g_mu);
+    for(uint32_t i = 0; i < n; i++){
+      Entry *e = get_index(i + 1);
+      struct stat st;
+      if(stat(e->path, &st) != 0 || same_file(&st, &e->st)) continue;
+      // e->st is only touched by this thread
+      if(ci_reload(e->ci, e->path) == 0) e->st = st;
+    }
+  }
+  return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+  ChunkIndex  *ci;
+  const float *q;
+  uint32_t     dim, K, budget_us;
+  uint32_t    *idx;
+  double      *score;
+  uint32_t     n;
+} Query;
+
+static void run_query(void *arg){
+  Query *j = arg;
+  j->n = ci_search_deadline(j->ci, j->q, j->dim, j->K, j->budget_us,
+                            j->idx, j->score, NULL, NULL, NULL);
+}
+
+static void put_meta(IxBuf *b, ChunkIndex *ci, uint32_t i){
+  const char *s;
+  ix_put_str(b, ci_get_id(ci, i), ci_get_id_len(ci, i));
+  s = ci_get_parent(ci, i); ix_put_str(b, s, (uint32_t)strlen(s));
+  s = ci_get_file(ci, i);   ix_put_str(b, s, (uint32_t)strlen(s));
+  s = ci_get_ext(ci, i);    ix_put_str(b, s, (uint32_t)strlen(s));
+  ix_put_u32(b, ci_get_start(ci, i));
+  ix_put_u32(b, ci_get_end(ci, i));
+  s = ci_get_text(ci, i);   ix_put_str(b, s, (uint32_t)strlen(s));
+}
+
+static void put_info(IxBuf *b, ChunkIndex *ci){
+  const char *m = ci_get_model(ci);
+  ix_put_u32(b, ci_get_dim(ci));
+  ix_put_u32(b, ci_count(ci));
+  ix_put_str(b, m, (uint32_t)strlen(m));
+}
+
+static const char* do_search(IxRd *r, IxBuf *out){
+  uint32_t h, K, budget, flags, dim, nq;
+  if(!ix_get_u32(r, &h) || !ix_get_u32(r, &K) || !ix_get_u32(r, &budget) ||
+     !ix_get_u32(r, &flags) || !ix_get_u32(r, &dim) || !ix_get_u32(r, &nq))
+    return "malformed search";
+  Entry *e = get_index(h);
+  if(!e) return "bad index handle";
+  if(K == 0 || K > 4096 || nq == 0 || dim == 0 ||
+     (size_t)(r->end - r->p) / sizeof(float) / dim < nq)
+    return "malformed search";
+
+  Query    *qs    = calloc(nq, sizeof *qs);
+  uint32_t *idx   = malloc((size_t)nq * K * sizeof *idx);
+  double   *score = malloc((size_t)nq * K * sizeof *score);
+  float    *qv    = malloc((size_t)nq * dim * sizeof *qv);
+  if(!qs || !idx || !score || !qv){ free(qs); free(idx); free(score); free(qv); return "out of memory"; }
+  memcpy(qv, r->p, (size_t)nq * dim * sizeof *qv);
+
+  // pinned so the strings put_meta copies cannot be reclaimed under it
+  ci_pin();
+  ThreadPool *tp = tp_global();
+  TpGroup g = TP_GROUP_INIT;
+  for(uint32_t k = 0; k < nq; k++){
+    qs[k] = (Query){ e->ci, qv + (size_t)k * dim, dim, K, budget,
+                     idx + (size_t)k * K, score + (size_t)k * K, 0 };
+    if(nq == 1) run_query(&qs[k]);
+    else        tp_submit(tp, &g, run_query, &qs[k]);
+  }
+  if(nq > 1) tp_wait(tp, &g);
+
+  for(uint32_t k = 0; k < nq; k++){
+    ix_put_u32(out, qs[k].n);
+    for(uint32_t j = 0; j < qs[k].n; j++){
+      ix_put_u32(out, qs[k].idx[j]);
+      ix_put_f64(out, qs[k].score[j]);
+    }
+  }
+  if(flags & IX_WITH_META)
+    for(uint32_t k = 0; k < nq; k++)
+      for(uint32_t j = 0; j < qs[k].n; j++) put_meta(out, e->ci, qs[k].idx[j]);
+  ci_unpin();
+
+  free(qs); free(idx); free(score); free(qv);
+  return NULL;
+}
+
+// Run one request, leaving the response body in `out`; returns an error
+// message or NULL.
+static const char* handle(uint32_t op, IxRd *r, IxBuf *out){
+  uint32_t h, n;
+  Entry *e;
+  switch(op){
+  case IX_OPEN: {
+    const char *path = ix_get_str(r, NULL);
+    if(!path) return "malformed open";
+    int32_t hd = open_index(path);
+    if(hd < 0) return "cannot load index";
+    ix_put_u32(out, (uint32_t)hd);
+    put_info(out, get_index((uint32_t)hd)->ci);
+    return NULL;
+  }
+  case IX_INFO:
+    if(!ix_get_u32(r, &h)) return "malformed info";
+    if(!(e = get_index(h))) return "bad index handle";
+    put_info(out, e->ci);
+    return NULL;
+  case IX_SEARCH:
+    return do_search(r, out);
+  case IX_META:
+    if(!ix_get_u32(r, &h) || !ix_get_u32(r, &n) || (size_t)(r->end - r->p) / 4 < n)
+      return "malformed meta";
+    if(!(e = get_index(h))) return "bad index handle";
+    ci_pin();
+    for(uint32_t i = 0; i < n; i++){
+      uint32_t k = 0;
+      ix_get_u32(r, &k);
+      put_meta(out, e->ci, k);
+    }
+    ci_unpin();
+    return NULL;
+  default:
+    return "unknown request";
+  }
+}
+
+static int read_full(int fd, void *p, size_t n){
+  uint8_t *b = p;
+  while(n){
+    ssize_t k = read(fd, b, n);
+    if(k < 0 && errno == EINTR) continue;
+    if(k <= 0) return -1;
+    b += k; n -= (size_t)k;
+  }
+  return 0;
+}
+
+static int write_full(int fd, const void *p, size_t n){
+  const uint8_t *b = p;
+  while(n){
+    ssize_t k = send(fd, b, n, MSG_NOSIGNAL);
+    if(k < 0 && errno == EINTR) continue;
+    if(k <= 0) return -1;
+    b += k; n -= (size_t)k;
+  }
+  return 0;
+}
+
+static void* serve(void *arg){
+  int fd = (int)(intptr_t)arg;
+  uint8_t *req = NULL;
+  size_t   cap = 0;
+  IxBuf    out = {0};
+  for(;;){
+    uint32_t hdr[3];
+    if(read_full(fd, hdr, sizeof hdr) != 0) break;
+    if(hdr[0] < 8 || hdr[0] > IX_MAX_FRAME) break;
+    size_t n = hdr[0] - 8;
+    if(n > cap){
+      uint8_t *p = realloc(req, n);
+      if(!p) break;
+      req = p; cap = n;
+    }
+    if(read_full(fd, req, n) != 0) break;
+
+    out.len = 0;
+    out.oom = 0;
+    ix_grow(&out, 12);               // header, filled in below
+    IxRd r = { req, req + n };
+    const char *err = handle(hdr[2], &r, &out);
+    if(!err && out.oom) err = "out of memory";
+    if(err){
+      out.len = 0;
+      out.oom = 0;
+      ix_grow(&out, 12);
+      ix_put(&out, err, strlen(err));
+    }
+    if(out.oom) break;
+    uint32_t rh[3] = { (uint32_t)out.len - 4, hdr[1], err ? (uint32_t)-1 : 0 };
+    memcpy(out.p, rh, sizeof rh);
+    if(write_full(fd, out.p, out.len) != 0) break;
+  }
+  free(req);
+  free(out.p);
+  close(fd);
+  return NULL;
+}
+
+static void on_signal(int sig){
+  unlink(g_sock);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+int main(int argc, char **argv){
+  char def[sizeof(((struct sockaddr_un*)0)->sun_path)];
+  if(argc > 2 || (argc == 2 && argv[1][0] == '-')){
+    fprintf(stderr, "usage: %s [socket-path]\n", argv[0]);
+    return 2;
+  }
+  g_sock = argc == 2 ? argv[1] : ic_default_socket(def, sizeof def);
+
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if(strlen(g_sock) >= sizeof addr.sun_path){
+    fprintf(stderr, "apollo-indexd: socket path too long\n");
+    return 1;
+  }
+  strcpy(addr.sun_path, g_sock);
+
+  // a socket file nobody answers on is left over from a dead daemon
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(connect(probe, (struct sockaddr*)&addr, sizeof addr) == 0){
+    fprintf(stderr, "apollo-indexd: already running on %s\n", g_sock);
+    return 0;
+  }
+  close(probe);
+  unlink(g_sock);
+
+  int ls = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t old = umask(077);
+  if(ls < 0 || bind(ls, (struct sockaddr*)&addr, sizeof addr) != 0 || listen(ls, 64) != 0){
+    fprintf(stderr, "apollo-indexd: %s: %s\n", g_sock, strerror(errno));
+    return 1;
+  }
+  umask(old);
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  pthread_t t;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  pthread_create(&t, &attr, watcher, NULL);
+
+  for(;;){
+    int fd = accept(ls, NULL, NULL);
+    if(fd < 0){
+      if(errno == EINTR || errno == ECONNABORTED) continue;
+      perror("apollo-indexd: accept");
+      return 1;
+    }
+    if(pthread_create(&t, &attr, serve, (void*)(intptr_t)fd) != 0) close(fd);
+  }
+}
@@ -0,0 +1,280 @@
+// indexd_client.c
+#include "indexd_client.h"
+#include "indexd_proto.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define IC_TIMEOUT_MS 30000
+
+typedef struct {
+  const char *id, *parent, *file, *ext, *text;
+  uint32_t    id_len, start_ln, end_ln;
+} IcHit;
+
+struct IcConn {
+  int      fd;
+  uint32_t next_id;
+  IxBuf    out;             // request being built
+  uint8_t *resp;            // last response body; hits point into it
+  size_t   resp_cap;
+  IxRd     rd;
+  IcHit   *hits;
+  uint32_t nhits, hits_cap;
+  char     err[256];
+};
+
+static void set_err(IcConn *c, const char *fmt, ...){
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(c->err, sizeof c->err, fmt, ap);
+  va_end(ap);
+}
+
+const char* ic_default_socket(char *buf, size_t cap){
+  const char *rt = getenv("XDG_RUNTIME_DIR");
+  if(rt && *rt) snprintf(buf, cap, "%s/apollo-indexd.sock", rt);
+  else          snprintf(buf, cap, "/tmp/apollo-indexd-%u.sock", (unsigned)getuid());
+  return buf;
+}
+
+IcConn* ic_connect(const char *sock_path){
+  char def[sizeof(((struct sockaddr_un*)0)->sun_path)];
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if(!sock_path) sock_path = ic_default_socket(def, sizeof def);
+  if(strlen(sock_path) >= sizeof addr.sun_path) return NULL;
+  strcpy(addr.sun_path, sock_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0) return NULL;
+  if(connect(fd, (struct sockaddr*)&addr, sizeof addr) != 0){ close(fd); return NULL; }
+  struct timeval tv = { IC_TIMEOUT_MS / 1000, (IC_TIMEOUT_MS % 1000) * 1000 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+#ifdef SO_NOSIGPIPE
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof one);
+#endif
+
+  IcConn *c = calloc(1, sizeof *c);
+  if(!c){ close(fd); return NULL; }
+  c->fd = fd;
+  return c;
+}
+
+void ic_close(IcConn *c){
+  if(!c) return;
+  close(c->fd);
+  free(c->out.p);
+  free(c->resp);
+  free(c->hits);
+  free(c);
+}
+
+const char* ic_error(IcConn *c){ return c->err; }
+
+static void begin(IcConn *c, uint32_t op){
+  c->out.len = 0;
+  c->out.oom = 0;
+  ix_put_u32(&c->out, 0);           // length, patched by send_req
+  ix_put_u32(&c->out, ++c->next_id);
+  ix_put_u32(&c->out, op);
+}
+
+static int send_req(IcConn *c){
+  if(c->out.oom){ set_err(c, "out of memory"); return -1; }
+  uint32_t len = (uint32_t)c->out.len - 4;
+  memcpy(c->out.p, &len, 4);
+  const uint8_t *b = c->out.p;
+  size_t n = c->out.len;
+  while(n){
+    ssize_t k = send(c->fd, b, n, MSG_NOSIGNAL);
+    if(k < 0 && errno == EINTR) continue;
+    if(k <= 0){ set_err(c, "send: %s", strerror(errno)); return -1; }
+    b += k; n -= (size_t)k;
+  }
+  return 0;
+}
+
+static int read_full(IcConn *c, void *p, size_t n){
+  uint8_t *b = p;
+  while(n){
+    ssize_t k = read(c->fd, b, n);
+    if(k < 0 && errno == EINTR) continue;
+    if(k <= 0){
+      set_err(c, k == 0 ? "daemon closed the connection" : "recv: %s", strerror(errno));
+      return -1;
+    }
+    b += k; n -= (size_t)k;
+  }
+  return 0;
+}
+
+// Read the next response into c->rd. Returns 0, or -1 on a transport
+// error or a failed request (the daemon's message goes to ic_error).
+static int recv_resp(IcConn *c){
+  uint32_t hdr[3];
+  if(read_full(c, hdr, sizeof hdr) != 0) return -1;
+  if(hdr[0] < 8 || hdr[0] > IX_MAX_FRAME){ set_err(c, "bad response frame"); return -1; }
+  size_t n = hdr[0] - 8;
+  if(n + 1 > c->resp_cap){
+    uint8_t *p = realloc(c->resp, n + 1);
+    if(!p){ set_err(c, "out of memory"); return -1; }
+    c->resp = p;
+    c->resp_cap = n + 1;
+  }
+  if(read_full(c, c->resp, n) != 0) return -1;
+  c->rd = (IxRd){ c->resp, c->resp + n };
+  if((int32_t)hdr[2] < 0){
+    c->resp[n] = 0;
+    set_err(c, "indexd: %s", (const char*)c->resp);
+    return -1;
+  }
+  return 0;
+}
+
+static int get_info(IcConn *c, uint32_t *dim, uint32_t *count, const char **model){
+  uint32_t d, n;
+  const char *m;
+  if(!ix_get_u32(&c->rd, &d) || !ix_get_u32(&c->rd, &n) || !(m = ix_get_str(&c->rd, NULL))){
+    set_err(c, "malformed response");
+    return -1;
+  }
+  if(dim)   *dim = d;
+  if(count) *count = n;
+  if(model) *model = m;
+  return 0;
+}
+
+int ic_fd(IcConn *c){ return c->fd; }
+
+int ic_open_send(IcConn *c, const char *path){
+  begin(c, IX_OPEN);
+  ix_put_str(&c->out, path, (uint32_t)strlen(path));
+  return send_req(c);
+}
+
+int32_t ic_open_recv(IcConn *c, uint32_t *dim, uint32_t *count, const char **model){
+  uint32_t h;
+  if(recv_resp(c) != 0) return -1;
+  if(!ix_get_u32(&c->rd, &h)){ set_err(c, "malformed response"); return -1; }
+  if(get_info(c, dim, count, model) != 0) return -1;
+  return (int32_t)h;
+}
+
+int32_t ic_open(IcConn *c, const char *path, uint32_t *dim, uint32_t *count){
+  if(ic_open_send(c, path) != 0) return -1;
+  return ic_open_recv(c, dim, count, NULL);
+}
+
+const char* ic_info(IcConn *c, uint32_t handle, uint32_t *dim, uint32_t *count){
+  begin(c, IX_INFO);
+  ix_put_u32(&c->out, handle);
+  const char *model;
+  if(send_req(c) != 0 || recv_resp(c) != 0) return NULL;
+  if(get_info(c, dim, count, &model) != 0) return NULL;
+  return model;
+}
+
+// Parse n meta records from the current response into c->hits.
+static int get_hits(IcConn *c, uint32_t n){
+  if(n > c->hits_cap){
+    IcHit *p = realloc(c->hits, n * sizeof *p);
+    if(!p){ set_err(c, "out of memory"); return -1; }
+    c->hits = p;
+    c->hits_cap = n;
+  }
+  c->nhits = 0;
+  for(uint32_t i = 0; i < n; i++){
+    IcHit *h = &c->hits[i];
+    if(!(h->id     = ix_get_str(&c->rd, &h->id_len)) ||
+       !(h->parent = ix_get_str(&c->rd, NULL)) ||
+       !(h->file   = ix_get_str(&c->rd, NULL)) ||
+       !(h->ext    = ix_get_str(&c->rd, NULL)) ||
+       !ix_get_u32(&c->rd, &h->start_ln) || !ix_get_u32(&c->rd, &h->end_ln) ||
+       !(h->text   = ix_get_str(&c->rd, NULL))){
+      set_err(c, "malformed response");
+      return -1;
+    }
+  }
+  c->nhits = n;
+  return 0;
+}
+
+int ic_search_send(IcConn *c, uint32_t handle, const float *q, uint32_t dim, uint32_t nq,
+                   uint32_t K, uint32_t budget_us, int with_meta)
+{
+  begin(c, IX_SEARCH);
+  ix_put_u32(&c->out, handle);
+  ix_put_u32(&c->out, K);
+  ix_put_u32(&c->out, budget_us);
+  ix_put_u32(&c->out, with_meta ? IX_WITH_META : 0);
+  ix_put_u32(&c->out, dim);
+  ix_put_u32(&c->out, nq);
+  ix_put(&c->out, q, (size_t)nq * dim * sizeof(float));
+  return send_req(c);
+}
+
+int ic_search_recv(IcConn *c, uint32_t nq, uint32_t K,
+                   uint32_t *out_n, uint32_t *out_i, double *out_s)
+{
+  c->nhits = 0;
+  if(recv_resp(c) != 0) return -1;
+  uint32_t total = 0;
+  for(uint32_t k = 0; k < nq; k++){
+    uint32_t n;
+    if(!ix_get_u32(&c->rd, &n) || n > K){ set_err(c, "malformed response"); return -1; }
+    for(uint32_t j = 0; j < n; j++)
+      if(!ix_get_u32(&c->rd, &out_i[(size_t)k * K + j]) ||
+         !ix_get_f64(&c->rd, &out_s[(size_t)k * K + j])){
+        set_err(c, "malformed response");
+        return -1;
+      }
+    out_n[k] = n;
+    total += n;
+  }
+  // the meta records follow when they were asked for
+  return c->rd.p < c->rd.end ? get_hits(c, total) : 0;
+}
+
+int ic_search(IcConn *c, uint32_t handle, const float *q, uint32_t dim, uint32_t nq,
+              uint32_t K, uint32_t budget_us, int with_meta,
+              uint32_t *out_n, uint32_t *out_i, double *out_s)
+{
+  if(ic_search_send(c, handle, q, dim, nq, K, budget_us, with_meta) != 0) return -1;
+  return ic_search_recv(c, nq, K, out_n, out_i, out_s);
+}
+
+int ic_meta(IcConn *c, uint32_t handle, const uint32_t *idxs, uint32_t n){
+  begin(c, IX_META);
+  ix_put_u32(&c->out, handle);
+  ix_put_u32(&c->out, n);
+  ix_put(&c->out, idxs, (size_t)n * 4);
+  c->nhits = 0;
+  if(send_req(c) != 0 || recv_resp(c) != 0) return -1;
+  return get_hits(c, n);
+}
+
+// out-of-range hits read as empty, like deleted chunks
+#define IC_HIT(T, name, field, none)                          \
+  T name(IcConn *c, uint32_t i){ return i < c->nhits ? c->hits[i].field : (none); }
+
+uint32_t ic_hit_count(IcConn *c){ return c->nhits; }
+IC_HIT(const char*, ic_hit_id,     id,       "")
+IC_HIT(uint32_t,    ic_hit_id_len, id_len,   0)
+IC_HIT(const char*, ic_hit_parent, parent,   "")
+IC_HIT(const char*, ic_hit_file,   file,     "")
+IC_HIT(const char*, ic_hit_ext,    ext,      "")
+IC_HIT(uint32_t,    ic_hit_start,  start_ln, 0)
+IC_HIT(uint32_t,    ic_hit_end,    end_ln,   0)
+IC_HIT(const char*, ic_hit_text,   text,     "")
@@ -0,0 +1,67 @@
+// indexd_client.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Client for apollo-indexd (see indexd_proto.h). One connection serves any
+// number of indexes; it is not thread-safe: use one per thread.
+typedef struct IcConn IcConn;
+
+// Default socket: $XDG_RUNTIME_DIR/apollo-indexd.sock, else
+// /tmp/apollo-indexd-<uid>.sock. Returns buf.
+const char* ic_default_socket(char *buf, size_t cap);
+
+// Connect to the daemon (sock_path NULL = default). NULL when nobody is
+// listening.
+IcConn* ic_connect(const char *sock_path);
+void    ic_close(IcConn *c);
+
+// Open (or share) the index at `path` inside the daemon. Returns a handle,
+// or -1; *dim and *count describe the index.
+int32_t ic_open(IcConn *c, const char *path, uint32_t *dim, uint32_t *count);
+
+// Socket of the connection, for an event loop to wait on before a *_recv.
+int ic_fd(IcConn *c);
+
+// Split form of ic_open: the daemon reads the whole index before it
+// replies, so a UI sends, waits for ic_fd to turn readable, then receives.
+// *model is valid until the next call.
+int     ic_open_send(IcConn *c, const char *path);
+int32_t ic_open_recv(IcConn *c, uint32_t *dim, uint32_t *count, const char **model);
+
+// Current dimension, slot count and model (valid until the next call).
+const char* ic_info(IcConn *c, uint32_t handle, uint32_t *dim, uint32_t *count);
+
+// Search nq queries (q is nq x dim, each normalized) with the semantics of
+// ci_search_deadline. Query k's hits land in out_idxs/out_scores[k*K ..],
+// best first, and their number in out_n[k]. With `with_meta` the hits'
+// metadata comes back in the same round trip (see ic_hit_*).
+// Returns 0, or -1 (see ic_error).
+int ic_search(IcConn *c, uint32_t handle, const float *q, uint32_t dim, uint32_t nq,
+              uint32_t K, uint32_t budget_us, int with_meta,
+              uint32_t *out_n, uint32_t *out_idxs, double *out_scores);
+
+// Pipelined form: queue any number of searches, then collect the answers
+// in the same order (a UI can wait for ic_fd to turn readable before each
+// ic_search_recv). Each ic_search_recv replaces the hit metadata.
+int ic_search_send(IcConn *c, uint32_t handle, const float *q, uint32_t dim, uint32_t nq,
+                   uint32_t K, uint32_t budget_us, int with_meta);
+int ic_search_recv(IcConn *c, uint32_t nq, uint32_t K,
+                   uint32_t *out_n, uint32_t *out_idxs, double *out_scores);
+
+// Fetch metadata for n slots; hit i then describes idxs[i].
+int ic_meta(IcConn *c, uint32_t handle, const uint32_t *idxs, uint32_t n);
+
+// Metadata of the hits of the last ic_search (flattened in query order:
+// query 0's hits first) or ic_meta, valid until the next call.
+uint32_t    ic_hit_count (IcConn *c);
+const char* ic_hit_id    (IcConn *c, uint32_t i);
+uint32_t    ic_hit_id_len(IcConn *c, uint32_t i);
+const char* ic_hit_parent(IcConn *c, uint32_t i);
+const char* ic_hit_file  (IcConn *c, uint32_t i);
+const char* ic_hit_ext   (IcConn *c, uint32_t i);
+uint32_t    ic_hit_start (IcConn *c, uint32_t i);
+uint32_t    ic_hit_end   (IcConn *c, uint32_t i);
+const char* ic_hit_text  (IcConn *c, uint32_t i);
+
+const char* ic_error(IcConn *c);
@@ -0,0 +1,102 @@
+// indexd_proto.h
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Wire protocol between apollo-indexd and indexd_client (little-endian).
+//
+//   request:  u32 len, u32 id, u32 op,     body[len - 8]
+//   response: u32 len, u32 id, i32 status, body[len - 8]
+//
+// Requests on one connection are answered in order, so a client may
+// pipeline any number of them. A failed request (status < 0) carries an
+// error message as its body. str is u32 length + bytes.
+//
+//   IX_OPEN    str path                        -> u32 handle, u32 dim, u32 count, str model
+//   IX_INFO    u32 handle                      -> u32 dim, u32 count, str model
+//   IX_SEARCH  u32 handle, u32 K, u32 budget_us, u32 flags, u32 dim, u32 nq,
+//              f32 q[nq][dim]                  -> nq x { u32 n, n x { u32 idx, f64 score } }
+//                                                 then, with IX_WITH_META, a meta
+//                                                 record per hit in the same order
+//   IX_META    u32 handle, u32 n, u32 idx[n]   -> n meta records
+//
+// meta record: str id, str parent, str file, str ext, u32 start, u32 end, str text
+//
+// A batch (nq > 1) is scanned in parallel on the daemon's thread pool.
+#define IX_OPEN   1u
+#define IX_INFO   2u
+#define IX_SEARCH 3u
+#define IX_META   4u
+
+#define IX_WITH_META 1u
+
+#define IX_MAX_FRAME (64u << 20)
+
+// Growable output buffer.
+typedef struct {
+  uint8_t *p;
+  size_t   len, cap;
+  int      oom;
+} IxBuf;
+
+static inline void* ix_grow(IxBuf *b, size_t n){
+  if(b->oom) return NULL;
+  if(b->cap - b->len < n){
+    size_t cap = b->cap ? b->cap : 256;
+    while(cap - b->len < n) cap *= 2;
+    uint8_t *p = realloc(b->p, cap);
+    if(!p){ b->oom = 1; return NULL; }
+    b->p = p; b->cap = cap;
+  }
+  void *at = b->p + b->len;
+  b->len += n;
+  return at;
+}
+
+static inline void ix_put(IxBuf *b, const void *src, size_t n){
+  void *at = ix_grow(b, n);
+  if(at && n) memcpy(at, src, n);
+}
+
+static inline void ix_put_u32(IxBuf *b, uint32_t v){ ix_put(b, &v, 4); }
+static inline void ix_put_f64(IxBuf *b, double v){ ix_put(b, &v, 8); }
+
+static inline void ix_put_str(IxBuf *b, const char *s, uint32_t n){
+  ix_put_u32(b, n);
+  ix_put(b, s, n);
+}
+
+// Bounds-checked reader over a received body.
+typedef struct {
+  uint8_t *p, *end;
+} IxRd;
+
+static inline int ix_get_u32(IxRd *r, uint32_t *v){
+  if(r->end - r->p < 4) return 0;
+  memcpy(v, r->p, 4);
+  r->p += 4;
+  return 1;
+}
+
+static inline int ix_get_f64(IxRd *r, double *v){
+  if(r->end - r->p < 8) return 0;
+  memcpy(v, r->p, 8);
+  r->p += 8;
+  return 1;
+}
+
+// Same in-place trick as chunks.c: the bytes move back over their length
+// prefix and get a NUL, so the string can be used where it lies.
+static inline const char* ix_get_str(IxRd *r, uint32_t *len){
+  uint32_t L;
+  if(r->end - r->p < 4) return NULL;
+  memcpy(&L, r->p, 4);
+  if((size_t)(r->end - r->p - 4) < L) return NULL;
+  char *s = (char*)r->p;
+  memmove(s, s + 4, L);
+  s[L] = 0;
+  r->p += 4 + L;
+  if(len) *len = L;
+  return s;
+}
@@ -0,0 +1,493 @@
+// json_floats.c
+#include "json_floats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+#endif
+
+/*
+ *  Float parsing follows Eisel & Lemire ("Number Parsing at a Gigabyte per Second"):
+ *  digits are consumed eight at a time with SWAR arithmetic into a 64-bit decimal
+ *  mantissa w, then w * 10^q is computed as one 64x128-bit multiply against a
+ *  truncated power of five, which is enough to round correctly to binary32.
+ *  Only inputs with more than 19 significant digits fall back to strtof.
+ *
+ *  Skipping over JSON we don't care about (other data[] entries in a batch)
+ *  uses a SIMD scan for structural characters.
+ */
+
+// 128-bit truncated powers of five, 5^-64 .. 5^38, MSB normalised
+// (the binary32 slice of the fast_float table).
+#define JF_MIN_POW10 (-64)
+#define JF_MAX_POW10 38
+static const uint64_t pow5_128[][2] = {
+  {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL}, // 5^-64
+  {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL}, // 5^-63
+  {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL}, // 5^-62
+  {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL}, // 5^-61
+  {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL}, // 5^-60
+  {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL}, // 5^-59
+  {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL}, // 5^-58
+  {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL}, // 5^-57
+  {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL}, // 5^-56
+  {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL}, // 5^-55
+  {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL}, // 5^-54
+  {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL}, // 5^-53
+  {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL}, // 5^-52
+  {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL}, // 5^-51
+  {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL}, // 5^-50
+  {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL}, // 5^-49
+  {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL}, // 5^-48
+  {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL}, // 5^-47
+  {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL}, // 5^-46
+  {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL}, // 5^-45
+  {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL}, // 5^-44
+  {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL}, // 5^-43
+  {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL}, // 5^-42
+  {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL}, // 5^-41
+  {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL}, // 5^-40
+  {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL}, // 5^-39
+  {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL}, // 5^-38
+  {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL}, // 5^-37
+  {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL}, // 5^-36
+  {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL}, // 5^-35
+  {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL}, // 5^-34
+  {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL}, // 5^-33
+  {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL}, // 5^-32
+  {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL}, // 5^-31
+  {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL}, // 5^-30
+  {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL}, // 5^-29
+  {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL}, // 5^-28
+  {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL}, // 5^-27
+  {0xc612062576589ddaULL, 0x95364afe032a819eULL}, // 5^-26
+  {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL}, // 5^-25
+  {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL}, // 5^-24
+  {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL}, // 5^-23
+  {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL}, // 5^-22
+  {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL}, // 5^-21
+  {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL}, // 5^-20
+  {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL}, // 5^-19
+  {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL}, // 5^-18
+  {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL}, // 5^-17
+  {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL}, // 5^-16
+  {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL}, // 5^-15
+  {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL}, // 5^-14
+  {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL}, // 5^-13
+  {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL}, // 5^-12
+  {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL}, // 5^-11
+  {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL}, // 5^-10
+  {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL}, // 5^-9
+  {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL}, // 5^-8
+  {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL}, // 5^-7
+  {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL}, // 5^-6
+  {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL}, // 5^-5
+  {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL}, // 5^-4
+  {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL}, // 5^-3
+  {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL}, // 5^-2
+  {0xccccccccccccccccULL, 0xcccccccccccccccdULL}, // 5^-1
+  {0x8000000000000000ULL, 0x0000000000000000ULL}, // 5^0
+  {0xa000000000000000ULL, 0x0000000000000000ULL}, // 5^1
+  {0xc800000000000000ULL, 0x0000000000000000ULL}, // 5^2
+  {0xfa00000000000000ULL, 0x0000000000000000ULL}, // 5^3
+  {0x9c40000000000000ULL, 0x0000000000000000ULL}, // 5^4
+  {0xc350000000000000ULL, 0x0000000000000000ULL}, // 5^5
+  {0xf424000000000000ULL, 0x0000000000000000ULL}, // 5^6
+  {0x9896800000000000ULL, 0x0000000000000000ULL}, // 5^7
+  {0xbebc200000000000ULL, 0x0000000000000000ULL}, // 5^8
+  {0xee6b280000000000ULL, 0x0000000000000000ULL}, // 5^9
+  {0x9502f90000000000ULL, 0x0000000000000000ULL}, // 5^10
+  {0xba43b74000000000ULL, 0x0000000000000000ULL}, // 5^11
+  {0xe8d4a51000000000ULL, 0x0000000000000000ULL}, // 5^12
+  {0x9184e72a00000000ULL, 0x0000000000000000ULL}, // 5^13
+  {0xb5e620f480000000ULL, 0x0000000000000000ULL}, // 5^14
+  {0xe35fa931a0000000ULL, 0x0000000000000000ULL}, // 5^15
+  {0x8e1bc9bf04000000ULL, 0x0000000000000000ULL}, // 5^16
+  {0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL}, // 5^17
+  {0xde0b6b3a76400000ULL, 0x0000000000000000ULL}, // 5^18
+  {0x8ac7230489e80000ULL, 0x0000000000000000ULL}, // 5^19
+  {0xad78ebc5ac620000ULL, 0x0000000000000000ULL}, // 5^20
+  {0xd8d726b7177a8000ULL, 0x0000000000000000ULL}, // 5^21
+  {0x878678326eac9000ULL, 0x0000000000000000ULL}, // 5^22
+  {0xa968163f0a57b400ULL, 0x0000000000000000ULL}, // 5^23
+  {0xd3c21bcecceda100ULL, 0x0000000000000000ULL}, // 5^24
+  {0x84595161401484a0ULL, 0x0000000000000000ULL}, // 5^25
+  {0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL}, // 5^26
+  {0xcecb8f27f4200f3aULL, 0x0000000000000000ULL}, // 5^27
+  {0x813f3978f8940984ULL, 0x4000000000000000ULL}, // 5^28
+  {0xa18f07d736b90be5ULL, 0x5000000000000000ULL}, // 5^29
+  {0xc9f2c9cd04674edeULL, 0xa400000000000000ULL}, // 5^30
+  {0xfc6f7c4045812296ULL, 0x4d00000000000000ULL}, // 5^31
+  {0x9dc5ada82b70b59dULL, 0xf020000000000000ULL}, // 5^32
+  {0xc5371912364ce305ULL, 0x6c28000000000000ULL}, // 5^33
+  {0xf684df56c3e01bc6ULL, 0xc732000000000000ULL}, // 5^34
+  {0x9a130b963a6c115cULL, 0x3c7f400000000000ULL}, // 5^35
+  {0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL}, // 5^36
+  {0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL}, // 5^37
+  {0x96769950b50d88f4ULL, 0x1314448000000000ULL}, // 5^38
+};
+
+// ---------------------------------------------------------------------
+// 64x64 -> 128 multiply and leading zeros
+// ---------------------------------------------------------------------
+#if defined(__SIZEOF_INT128__)
+static inline uint64_t mul128(uint64_t a, uint64_t b, uint64_t *hi){
+  unsigned __int128 r = (unsigned __int128)a * b;
+  *hi = (uint64_t)(r >> 64);
+  return (uint64_t)r;
+}
+#else
+static inline uint64_t mul128(uint64_t a, uint64_t b, uint64_t *hi){
+  uint64_t al = (uint32_t)a, ah = a >> 32, bl = (uint32_t)b, bh = b >> 32;
+  uint64_t ll = al*bl, lh = al*bh, hl = ah*bl, hh = ah*bh;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return (mid << 32) | (uint32_t)ll;
+}
+#endif
+
+static inline int clz64(uint64_t x){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(x);
+#else
+  int n = 0;
+  while(!(x & 0x8000000000000000ULL)){ x <<= 1; n++; }
+  return n;
+#endif
+}
+
+// ---------------------------------------------------------------------
+// SWAR digit parsing (little-endian)
+// ---------------------------------------------------------------------
+static inline uint64_t load8(const char *p){
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline int is_eight_digits(uint64_t v){
+  return (((v & 0xF0F0F0F0F0F0F0F0ULL) |
+           (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))
+          == 0x3333333333333333ULL);
+}
+
+static inline uint32_t parse_eight_digits(uint64_t v){
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL;  // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ULL;  // 1 + (10000 << 32)
+  v -= 0x3030303030303030ULL;
+  v  = (v * 10) + (v >> 8);
+  v  = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+  return (uint32_t)v;
+}
+
+static inline int is_digit(char c){ return (unsigned)(c - '0') < 10; }
+
+static inline const char* parse_digits(const char *p, const char *end, uint64_t *w){
+  while(end - p >= 8 && is_eight_digits(load8(p))){
+    *w = *w * 100000000 + parse_eight_digits(load8(p));
+    p += 8;
+  }
+  while(p < end && is_digit(*p)){
+    *w = *w * 10 + (uint64_t)(*p - '0');
+    p++;
+  }
+  return p;
+}
+
+// ---------------------------------------------------------------------
+// w * 10^q -> binary32 bits (Eisel-Lemire). w != 0, at most 19 digits.
+// ---------------------------------------------------------------------
+static uint32_t eisel_lemire_f32(int64_t q, uint64_t w){
+  const int mbits = 23, min_exp = -127, inf_pow = 0xFF;
+  if(q < JF_MIN_POW10) return 0;
+  if(q > JF_MAX_POW10) return (uint32_t)inf_pow << mbits;
+
+  int lz = clz64(w);
+  w <<= lz;
+
+  // product of w and 5^q with enough precision for mbits+3 bits
+  const uint64_t *p5 = pow5_128[q - JF_MIN_POW10];
+  const uint64_t precision_mask = 0xFFFFFFFFFFFFFFFFULL >> (mbits + 3);
+  uint64_t hi, lo = mul128(w, p5[0], &hi);
+  if((hi & precision_mask) == precision_mask){
+    uint64_t hi2;
+    mul128(w, p5[1], &hi2);
+    lo += hi2;
+    if(hi2 > lo) hi++;
+  }
+
+  int upperbit = (int)(hi >> 63);
+  int shift    = upperbit + 64 - mbits - 3;
+  uint64_t mantissa = hi >> shift;
+  int32_t power2 = (int32_t)(((152170 + 65536) * q) >> 16) + 63 + upperbit - lz - min_exp;
+
+  if(power2 <= 0){  // subnormal
+    if(-power2 + 1 >= 64) return 0;
+    mantissa >>= -power2 + 1;
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    power2 = (mantissa < (1ULL << mbits)) ? 0 : 1;
+    return (uint32_t)(power2 << mbits) | (uint32_t)(mantissa & ((1ULL << mbits) - 1));
+  }
+
+  // exactly halfway: round to even
+  if(lo <= 1 && q >= -17 && q <= 10 && (mantissa & 3) == 1){
+    if((mantissa << shift) == hi) mantissa &= ~1ULL;
+  }
+  mantissa += (mantissa & 1);
+  mantissa >>= 1;
+  if(mantissa >= (2ULL << mbits)){
+    mantissa = 1ULL << mbits;
+    power2++;
+  }
+  mantissa &= ~(1ULL << mbits);
+  if(power2 >= inf_pow) return (uint32_t)inf_pow << mbits;
+  return ((uint32_t)power2 << mbits) | (uint32_t)mantissa;
+}
+
+static const float pow10_f32[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// Parse one JSON number at p. Returns the position after it, or NULL.
+static const char* parse_number(const char *p, const char *end, float *out){
+  const char *start = p;
+  int neg = p < end && *p == '-';
+  if(neg) p++;
+
+  uint64_t w = 0;
+  const char *ip = p;
+  p = parse_digits(p, end, &w);
+  if(p == ip) return NULL;
+  int64_t ndigits = p - ip;
+  int64_t exp = 0;
+
+  if(p < end && *p == '.'){
+    const char *fp = ++p;
+    p = parse_digits(p, end, &w);
+    if(p == fp) return NULL;
+    exp      = -(int64_t)(p - fp);
+    ndigits += p - fp;
+  }
+  const char *mend = p;
+
+  if(p < end && (*p == 'e' || *p == 'E')){
+    p++;
+    int eneg = 0;
+    if(p < end && (*p == '-' || *p == '+')){ eneg = *p == '-'; p++; }
+    if(p >= end || !is_digit(*p)) return NULL;
+    int64_t e = 0;
+    while(p < end && is_digit(*p)){
+      if(e < 0x10000) e = e * 10 + (*p - '0');
+      p++;
+    }
+    exp += eneg ? -e : e;
+  }
+
+  if(ndigits > 19){
+    // leading zeros (0.000123...) don't count towards the 19-digit limit
+    const char *s = ip;
+    while(s < mend && (*s == '0' || *s == '.')) s++;
+    int64_t sig = 0;
+    for(; s < mend; s++) sig += (*s != '.');
+    if(sig > 19){
+      char tmp[128];
+      size_t n = (size_t)(p - start);
+      if(n >= sizeof tmp) return NULL;
+      memcpy(tmp, start, n);
+      tmp[n] = 0;
+      *out = strtof(tmp, NULL);
+      return p;
+    }
+  }
+
+  float f;
+  if(w == 0){
+    f = 0.0f;
+  } else if(w <= (1ULL << 24) && exp >= -10 && exp <= 10){
+    // both operands exact in binary32: one IEEE op rounds correctly
+    f = (float)w;
+    f = exp < 0 ? f / pow10_f32[-exp] : f * pow10_f32[exp];
+  } else {
+    uint32_t bits = eisel_lemire_f32(exp, w);
+    memcpy(&f, &bits, 4);
+  }
+  *out = neg ? -f : f;
+  return p;
+}
+
+static inline const char* skip_ws(const char *p, const char *end){
+  while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+  return p;
+}
+
+int jf_parse_floats(const char *p, const char *end, float *out, uint32_t cap,
+                    const char **stop){
+  p = skip_ws(p, end);
+  if(p >= end || *p != '[') return -1;
+  p = skip_ws(p + 1, end);
+  uint32_t n = 0;
+  if(p < end && *p == ']'){
+    if(stop) *stop = p + 1;
+    return 0;
+  }
+  for(;;){
+    float v;
+    p = parse_number(p, end, &v);
+    if(!p) return -1;
+    if(n < cap) out[n] = v;
+    n++;
+    p = skip_ws(p, end);
+    if(p >= end) return -1;
+    if(*p == ']') break;
+    if(*p != ',') return -1;
+    p = skip_ws(p + 1, end);
+  }
+  if(stop) *stop = p + 1;
+  return (int)n;
+}
+
+// ---------------------------------------------------------------------
+// Structural skipping
+// ---------------------------------------------------------------------
+
+// First occurrence of '"', '\\', '[', ']', '{' or '}' at or after p.
+static const char* next_structural(const char *p, const char *end){
+#if defined(__AVX2__)
+  const __m256i q = _mm256_set1_epi8('"'), bs = _mm256_set1_epi8('\\');
+  const __m256i lc = _mm256_set1_epi8('{'), rc = _mm256_set1_epi8('}');
+  const __m256i m20 = _mm256_set1_epi8(0x20);
+  for(; end - p >= 32; p += 32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    // '[' | 0x20 == '{' and ']' | 0x20 == '}': fold brackets into braces
+    __m256i f = _mm256_or_si256(v, m20);
+    __m256i m = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(f, lc), _mm256_cmpeq_epi8(f, rc)));
+    uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+    if(bits) return p + __builtin_ctz(bits);
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i q = _mm_set1_epi8('"'), bs = _mm_set1_epi8('\\');
+  const __m128i lc = _mm_set1_epi8('{'), rc = _mm_set1_epi8('}');
+  const __m128i m20 = _mm_set1_epi8(0x20);
+  for(; end - p >= 16; p += 16){
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i f = _mm_or_si128(v, m20);
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)),
+      _mm_or_si128(_mm_cmpeq_epi8(f, lc), _mm_cmpeq_epi8(f, rc)));
+    unsigned bits = (unsigned)_mm_movemask_epi8(m);
+    if(bits) return p + __builtin_ctz(bits);
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const uint8x16_t q = vdupq_n_u8('"'), bs = vdupq_n_u8('\\');
+  const uint8x16_t lc = vdupq_n_u8('{'), rc = vdupq_n_u8('}');
+  for(; end - p >= 16; p += 16){
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t f = vorrq_u8(v, vdupq_n_u8(0x20));
+    uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, q), vceqq_u8(v, bs)),
+                            vorrq_u8(vceqq_u8(f, lc), vceqq_u8(f, rc)));
+    // narrow 16x8 -> 16x4 bit mask
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(
+      vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    if(bits) return p + (__builtin_ctzll(bits) >> 2);
+  }
+#endif
+  for(; p < end; p++){
+    char c = *p;
+    if(c == '"' || c == '\\' || c == '[' || c == ']' || c == '{' || c == '}') return p;
+  }
+  return end;
+}
+
+// Skip a string starting at '"'. Returns the position after the closing quote.
+static const char* skip_string(const char *p, const char *end){
+  p++;
+  for(;;){
+    p = next_structural(p, end);
+    if(p >= end) return NULL;
+    if(*p == '\\'){ p += 2; continue; }
+    if(*p == '"') return p + 1;
+    p++;
+  }
+}
+
+// Skip any JSON value. Returns the position after it, or NULL.
+static const char* skip_value(const char *p, const char *end){
+  p = skip_ws(p, end);
+  if(p >= end) return NULL;
+  if(*p == '"') return skip_string(p, end);
+  if(*p == '[' || *p == '{'){
+    int depth = 0;
+    for(;;){
+      p = next_structural(p, end);
+      if(p >= end) return NULL;
+      switch(*p){
+        case '"':  p = skip_string(p, end); if(!p) return NULL; continue;
+        case '\\': return NULL;
+        case '[': case '{': depth++; break;
+        default:   if(--depth == 0) return p + 1;
+      }
+      p++;
+    }
+  }
+  // number / true / false / null
+  while(p < end && *p != ',' && *p != '}' && *p != ']' &&
+        *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') p++;
+  return p;
+}
+
+// Within the object starting at '{', return the value of `key` or NULL.
+static const char* object_get(const char *p, const char *end, const char *key){
+  size_t kl = strlen(key);
+  p = skip_ws(p, end);
+  if(p >= end || *p != '{') return NULL;
+  p++;
+  for(;;){
+    p = skip_ws(p, end);
+    if(p >= end || *p != '"') return NULL;
+    const char *k = p + 1;
+    p = skip_string(p, end);
+    if(!p) return NULL;
+    int match = (size_t)(p - 1 - k) == kl && memcmp(k, key, kl) == 0;
+    p = skip_ws(p, end);
+    if(p >= end || *p != ':') return NULL;
+    p = skip_ws(p + 1, end);
+    if(match) return p;
+    p = skip_value(p, end);
+    if(!p) return NULL;
+    p = skip_ws(p, end);
+    if(p >= end || *p != ',') return NULL;
+    p++;
+  }
+}
+
+const char* jf_find_embedding(const char *js, size_t len, uint32_t index){
+  const char *end = js + len;
+  const char *data = object_get(js, end, "data");
+  if(!data || *data != '[') return NULL;
+  const char *p = data + 1;
+  for(uint32_t i = 0; ; i++){
+    p = skip_ws(p, end);
+    if(p >= end || *p != '{') return NULL;
+    if(i == index) return object_get(p, end, "embedding");
+    p = skip_value(p, end);
+    if(!p) return NULL;
+    p = skip_ws(p, end);
+    if(p >= end || *p != ',') return NULL;
+    p++;
+  }
+}
+
+int jf_embedding(const char *js, size_t len, uint32_t index, float *out, uint32_t cap){
+  const char *v = jf_find_embedding(js, len, index);
+  if(!v || *v != '[') return -1;
+  return jf_parse_floats(v, js + len, out, cap, NULL);
+}
@@ -0,0 +1,22 @@
+// json_floats.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Fast path for OpenAI-style embedding responses:
+//   { ..., "data": [ { "embedding": [f, f, ...], "index": 0 }, ... ] }
+// Numbers are parsed straight into float32 (correctly rounded) without
+// going through doubles or an intermediate DOM.
+
+// Locate the value of data[index].embedding in `js`. Returns a pointer to
+// its first character ('[' for a number array, '"' for base64) or NULL.
+const char* jf_find_embedding(const char *js, size_t len, uint32_t index);
+
+// Parse a JSON number array starting at '['. Writes at most `cap` values to
+// `out` and returns the array length (which may exceed cap), or -1 when the
+// array is malformed. `stop` (optional) receives the position after ']'.
+int jf_parse_floats(const char *p, const char *end, float *out, uint32_t cap,
+                    const char **stop);
+
+// jf_find_embedding + jf_parse_floats. Returns the dimension or -1.
+int jf_embedding(const char *js, size_t len, uint32_t index, float *out, uint32_t cap);
@@ -0,0 +1,281 @@
+// search_async.c
+#include "search_async.h"
+#include "thread_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+struct CiSearch {
+  ChunkIndex     *ci;
+  float          *q;
+  uint32_t        dim, K, n, budget_us, channel;
+  uint32_t       *idx;
+  double         *score;
+  uint32_t       *pidx;     // provisional hits of a deadline search
+  double         *pscore;
+  int             pn;       // -1 until published; guarded by mu
+  atomic_int      refs;     // caller + pending task + channel slot
+  int             cancel;   // read by the scan with __atomic_load_n
+  int             done;     // guarded by mu
+  int             cancelled;// cancelled before it finished; guarded by mu
+  pthread_mutex_t mu;
+  pthread_cond_t  cv;
+};
+
+static int            g_fd[2] = { -1, -1 };   // read end, write end
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+// newest running search per channel, each holding a reference that is
+// dropped by whoever takes it out of the slot: a newer search on the
+// channel, the search finishing, or the caller releasing it
+static CiSearch       *g_chan[CI_CHANNELS];
+static pthread_mutex_t g_chan_mu = PTHREAD_MUTEX_INITIALIZER;
+
+static void notify_init(void){
+#ifdef __linux__
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(fd >= 0){ g_fd[0] = g_fd[1] = fd; return; }
+#endif
+  int p[2];
+  if(pipe(p) != 0) return;
+  for(int i = 0; i < 2; i++){
+    fcntl(p[i], F_SETFL, fcntl(p[i], F_GETFL) | O_NONBLOCK);
+    fcntl(p[i], F_SETFD, FD_CLOEXEC);
+  }
+  g_fd[0] = p[0];
+  g_fd[1] = p[1];
+}
+
+int ci_async_fd(void){
+  pthread_once(&g_once, notify_init);
+  return g_fd[0];
+}
+
+void ci_async_drain(void){
+  if(ci_async_fd() < 0) return;
+  uint64_t buf[64];
+  while(read(g_fd[0], buf, sizeof buf) > 0 && g_fd[0] != g_fd[1]);
+}
+
+void ci_async_signal(void){
+  if(ci_async_fd() < 0) return;
+  uint64_t one = 1;
+  // a full pipe already signals readiness; nothing is lost by dropping
+  while(write(g_fd[1], &one, g_fd[0] == g_fd[1] ? 8 : 1) < 0 && errno == EINTR);
+}
+
+static void unref(CiSearch *s){
+  if(atomic_fetch_sub(&s->refs, 1) != 1) return;
+  pthread_mutex_destroy(&s->mu);
+  pthread_cond_destroy(&s->cv);
+  free(s->q);
+  free(s->idx);
+  free(s->score);
+  free(s->pidx);
+  free(s->pscore);
+  free(s);
+}
+
+// Take s out of its channel slot if it is still there.
+static void unchain(CiSearch *s){
+  if(!s->channel) return;
+  pthread_mutex_lock(&g_chan_mu);
+  int held = g_chan[s->channel] == s;
+  if(held) g_chan[s->channel] = NULL;
+  pthread_mutex_unlock(&g_chan_mu);
+  if(held) unref(s);
+}
+
+void ci_search_cancel(CiSearch *s){
+  __atomic_store_n(&s->cancel, 1, __ATOMIC_RELAXED);
+}
+
+static void publish_partial(void *ud, const uint32_t *idx, const double *score, uint32_t n){
+  CiSearch *s = ud;
+  pthread_mutex_lock(&s->mu);
+  memcpy(s->pidx,   idx,   n * sizeof(uint32_t));
+  memcpy(s->pscore, score, n * sizeof(double));
+  s->pn = (int)n;
+  pthread_mutex_unlock(&s->mu);
+  ci_async_signal();
+}
+
+static void run_search(void *arg){
+  CiSearch *s = arg;
+  // a search superseded while still queued never starts scanning
+  uint32_t n = 0;
+  if(!__atomic_load_n(&s->cancel, __ATOMIC_RELAXED))
+    n = ci_search_deadline(s->ci, s->q, s->dim, s->K, s->budget_us, s->idx, s->score,
+                           publish_partial, s, &s->cancel);
+  pthread_mutex_lock(&s->mu);
+  s->n    = n;
+  s->done = 1;
+  s->cancelled = __atomic_load_n(&s->cancel, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&s->cv);
+  pthread_mutex_unlock(&s->mu);
+  ci_async_signal();
+  unchain(s);
+  unref(s);
+}
+
+CiSearch* ci_search_async(ChunkIndex *ci, const float *qemb, uint32_t dim, uint32_t K,
+                          uint32_t channel, uint32_t budget_us){
+  CiSearch *s = calloc(1, sizeof *s);
+  if(!s) return NULL;
+  s->ci    = ci;
+  s->dim   = dim;
+  s->K     = K;
+  s->pn    = -1;
+  s->budget_us = budget_us;
+  s->q      = malloc((size_t)dim * sizeof(float));
+  s->idx    = malloc((K ? K : 1) * sizeof(uint32_t));
+  s->score  = malloc((K ? K : 1) * sizeof(double));
+  s->pidx   = malloc((K ? K : 1) * sizeof(uint32_t));
+  s->pscore = malloc((K ? K : 1) * sizeof(double));
+  if(!s->q || !s->idx || !s->score || !s->pidx || !s->pscore){
+    free(s->q); free(s->idx); free(s->score); free(s->pidx); free(s->pscore); free(s);
+    return NULL;
+  }
+  memcpy(s->q, qemb, (size_t)dim * sizeof(float));
+  atomic_init(&s->refs, 2);
+  pthread_mutex_init(&s->mu, NULL);
+  pthread_cond_init(&s->cv, NULL);
+  ci_async_fd();
+
+  if(channel && channel < CI_CHANNELS){
+    s->channel = channel;
+    atomic_fetch_add(&s->refs, 1);
+    pthread_mutex_lock(&g_chan_mu);
+    CiSearch *prev = g_chan[channel];
+    g_chan[channel] = s;
+    pthread_mutex_unlock(&g_chan_mu);
+    if(prev){
+      ci_search_cancel(prev);
+      unref(prev);
+    }
+  }
+  tp_submit(tp_global(), NULL, run_search, s);
+  return s;
+}
+
+int ci_search_result(CiSearch *s, uint32_t *out_idxs, double *out_scores){
+  pthread_mutex_lock(&s->mu);
+  int done = s->done, cancelled = s->cancelled;
+  pthread_mutex_unlock(&s->mu);
+  if(!done) return CI_SEARCH_RUNNING;
+  if(cancelled) return CI_SEARCH_CANCELLED;
+  memcpy(out_idxs,   s->idx,   s->n * sizeof(uint32_t));
+  memcpy(out_scores, s->score, s->n * sizeof(double));
+  return (int)s->n;
+}
+
+int ci_search_partial(CiSearch *s, uint32_t *out_idxs, double *out_scores){
+  pthread_mutex_lock(&s->mu);
+  int n = s->pn;
+  if(n > 0){
+    memcpy(out_idxs,   s->pidx,   (size_t)n * sizeof(uint32_t));
+    memcpy(out_scores, s->pscore, (size_t)n * sizeof(double));
+  }
+  pthread_mutex_unlock(&s->mu);
+  return n;
+}
+
+void ci_search_wait(CiSearch *s){
+  pthread_mutex_lock(&s->mu);
+  while(!s->done) pthread_cond_wait(&s->cv, &s->mu);
+  pthread_mutex_unlock(&s->mu);
+}
+
+void ci_search_release(CiSearch *s){
+  if(!s) return;
+  unchain(s);
+  unref(s);
+}
+
+/* ------------------------------------------------------------------ */
+
+struct CiLoad {
+  char           *path;
+  int             shared;
+  ChunkIndex     *ci;       // until taken by ci_load_result
+  int             state;    // CI_LOAD_RUNNING, 0 or -1; guarded by mu
+  atomic_int      refs;     // caller + loader thread
+  pthread_mutex_t mu;
+  pthread_cond_t  cv;
+};
+
+static void load_unref(CiLoad *l){
+  if(atomic_fetch_sub(&l->refs, 1) != 1) return;
+  ci_close(l->ci);          // finished but never taken
+  pthread_mutex_destroy(&l->mu);
+  pthread_cond_destroy(&l->cv);
+  free(l->path);
+  free(l);
+}
+
+static void* run_load(void *arg){
+  CiLoad *l = arg;
+  ChunkIndex *ci = ci_open(l->path, l->shared);
+  pthread_mutex_lock(&l->mu);
+  l->ci    = ci;
+  l->state = ci ? 0 : -1;
+  pthread_cond_broadcast(&l->cv);
+  pthread_mutex_unlock(&l->mu);
+  ci_async_signal();
+  load_unref(l);
+  return NULL;
+}
+
+CiLoad* ci_load_async(const char *filename, int shared){
+  CiLoad *l = calloc(1, sizeof *l);
+  if(!l || !(l->path = strdup(filename))){ free(l); return NULL; }
+  l->shared = shared;
+  l->state  = CI_LOAD_RUNNING;
+  atomic_init(&l->refs, 2);
+  pthread_mutex_init(&l->mu, NULL);
+  pthread_cond_init(&l->cv, NULL);
+  ci_async_fd();
+
+  // its own thread: a long read must not hold up searches and embeds on
+  // the pool
+  pthread_t t;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int rc = pthread_create(&t, &attr, run_load, l);
+  pthread_attr_destroy(&attr);
+  if(rc != 0){
+    atomic_store(&l->refs, 1);
+    load_unref(l);
+    return NULL;
+  }
+  return l;
+}
+
+int ci_load_result(CiLoad *l, ChunkIndex **out){
+  pthread_mutex_lock(&l->mu);
+  int state = l->state;
+  if(state == 0){
+    *out  = l->ci;
+    l->ci = NULL;
+  }
+  pthread_mutex_unlock(&l->mu);
+  return state;
+}
+
+void ci_load_wait(CiLoad *l){
+  pthread_mutex_lock(&l->mu);
+  while(l->state == CI_LOAD_RUNNING) pthread_cond_wait(&l->cv, &l->mu);
+  pthread_mutex_unlock(&l->mu);
+}
+
+void ci_load_release(CiLoad *l){
+  if(l) load_unref(l);
+}
@@ -0,0 +1,73 @@
+// search_async.h
+#pragma once
+#include <stdint.h>
+#include "chunks.h"
+
+// Background top-K searches on the library thread pool. Every finished
+// search bumps one process-wide notification fd (an eventfd on Linux, a
+// pipe elsewhere) that an event loop can poll for readability, e.g.
+// vim.loop.new_poll(ci_async_fd()). The index must stay alive until every
+// search started on it has finished.
+typedef struct CiSearch CiSearch;
+
+// Readable while finished searches have not been acknowledged with
+// ci_async_drain. Returns -1 if it could not be created.
+int  ci_async_fd(void);
+void ci_async_drain(void);
+
+// Wake the notification fd; for other background jobs (hc_embed_async).
+void ci_async_signal(void);
+
+// Number of search channels; channel 0 means "none".
+#define CI_CHANNELS 64
+
+// Copy the query and queue the search. A search started on a non-zero
+// `channel` cancels the previous search on that channel (e.g. one channel
+// per live-search prompt, so only the newest keystroke's scan keeps the
+// CPU). A non-zero `budget_us` runs ci_search_deadline, which also
+// publishes provisional hits (see ci_search_partial) and signals the fd
+// for them. Returns NULL if out of memory.
+CiSearch* ci_search_async(ChunkIndex *ci, const float *qemb, uint32_t dim, uint32_t K,
+                          uint32_t channel, uint32_t budget_us);
+
+// Stop the scan at its next block boundary. Cancelled searches still
+// complete (and signal the fd), with no results; cancelling a search that
+// has already finished changes nothing.
+void ci_search_cancel(CiSearch *s);
+
+#define CI_SEARCH_RUNNING   (-1)
+#define CI_SEARCH_CANCELLED (-2)
+
+// Non-blocking: CI_SEARCH_RUNNING, CI_SEARCH_CANCELLED, or the number of
+// hits (≤ K) copied to out_idxs / out_scores, best first.
+int ci_search_result(CiSearch *s, uint32_t *out_idxs, double *out_scores);
+
+// Provisional hits of a deadline search, best first: -1 until published,
+// else their number. Final results still come from ci_search_result.
+int ci_search_partial(CiSearch *s, uint32_t *out_idxs, double *out_scores);
+
+// Block until the search has finished.
+void ci_search_wait(CiSearch *s);
+
+// Drop the caller's reference; a running search is freed when it finishes.
+void ci_search_release(CiSearch *s);
+
+// ci_open an index on a background thread; completion signals
+// ci_async_fd. An index already in the registry is simply shared. Returns
+// NULL if the thread could not be started.
+typedef struct CiLoad CiLoad;
+
+CiLoad* ci_load_async(const char *filename, int shared);
+
+#define CI_LOAD_RUNNING (-2)
+
+// Non-blocking: CI_LOAD_RUNNING, -1 if the file could not be loaded, or 0
+// with the index handed to the caller in *out (NULL on later calls), who
+// releases it with ci_close.
+int  ci_load_result(CiLoad *l, ChunkIndex **out);
+
+// Block until the load has finished.
+void ci_load_wait(CiLoad *l);
+
+// Drop the caller's reference; an index nobody took is freed.
+void ci_load_release(CiLoad *l);
@@ -0,0 +1,220 @@
+// text_chunker.c
+#include "text_chunker.h"
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct { uint32_t file, start, end; } Range;
+
+struct ChunkPlan {
+  Range   *r;
+  uint32_t n;
+};
+
+typedef struct {
+  uint32_t tokens;
+  uint32_t indent;      // columns, tab = 4
+  uint8_t  blank;
+  uint8_t  closer;      // starts with '}' / ')' / ']' / "end"
+  uint8_t  comment;     // starts with a line-comment marker
+} LineInfo;
+
+typedef struct {
+  const char *path;     // read from disk, unless
+  const char *text;     // the text is given (len bytes)
+  size_t      len;
+  uint32_t    max_tokens, overlap;
+  Range      *r;        // per-file output
+  uint32_t    n, cap;
+  int         oom;      // an allocation failed; the plan is dropped
+} FileJob;
+
+static inline int is_alnum(unsigned char c){
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+}
+
+// Rough BPE estimate for code: identifiers cost one token per 4 bytes,
+// punctuation one token per character, whitespace nothing.
+static void scan_line(const char *s, size_t len, LineInfo *li){
+  size_t i = 0;
+  uint32_t col = 0;
+  for(; i < len && (s[i] == ' ' || s[i] == '\t'); i++) col += s[i] == '\t' ? 4 : 1;
+  li->indent = col;
+  li->blank  = i == len;
+  li->closer = i < len && (s[i] == '}' || s[i] == ')' || s[i] == ']' ||
+               (len - i >= 3 && memcmp(s + i, "end", 3) == 0 &&
+                (len - i == 3 || !is_alnum((unsigned char)s[i+3]))));
+  li->comment = i < len && (s[i] == '#' || (len - i >= 2 &&
+                ((s[i] == '/' && (s[i+1] == '/' || s[i+1] == '*')) ||
+                 (s[i] == '-' && s[i+1] == '-') || (s[i] == '*' && s[i+1] == ' '))));
+  uint32_t t = 0;
+  while(i < len){
+    unsigned char c = (unsigned char)s[i];
+    if(is_alnum(c)){
+      size_t j = i;
+      while(j < len && is_alnum((unsigned char)s[j])) j++;
+      t += (uint32_t)((j - i + 3) / 4);
+      i = j;
+    } else {
+      t += !(c == ' ' || c == '\t' || c == '\r');
+      i++;
+    }
+  }
+  li->tokens = t + 1;  // newline
+}
+
+// How good it is to end a window after line i (0-based).
+static int break_score(const LineInfo *L, uint32_t n, uint32_t i){
+  if(i + 1 >= n) return 100;
+  const LineInfo *a = &L[i], *b = &L[i+1];
+  if(a->comment && !a->blank) return 0;        // keep comments with what follows
+  if(a->closer && a->indent == 0) return 100;  // end of a top-level block
+  if(a->blank && !b->blank && b->indent == 0) return 90;
+  if(!b->blank && b->indent == 0 && !b->closer) return 70;
+  if(a->blank) return 50;
+  if(!b->blank && b->indent < a->indent) return 20;
+  return 0;
+}
+
+static void emit(FileJob *j, uint32_t start, uint32_t end){
+  if(j->n == j->cap){
+    uint32_t cap = j->cap ? j->cap * 2 : 16;
+    Range *r = realloc(j->r, cap * sizeof(Range));
+    if(!r){ j->oom = 1; return; }
+    j->r = r;
+    j->cap = cap;
+  }
+  j->r[j->n++] = (Range){ 0, start + 1, end + 1 };
+}
+
+// The file's bytes (malloc'd) in *buf, or NULL when it cannot be read.
+static size_t read_file(FileJob *j, char **buf){
+  *buf = NULL;
+  FILE *f = fopen(j->path, "rb");
+  if(!f) return 0;
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  size_t len = 0;
+  if(sz > 0 && (*buf = malloc((size_t)sz))) len = fread(*buf, 1, (size_t)sz, f);
+  else if(sz > 0) j->oom = 1;
+  fclose(f);
+  return len;
+}
+
+static void chunk_file(void *arg){
+  FileJob *j = arg;
+  char *own = NULL;
+  const char *buf = j->text;
+  size_t len = buf ? j->len : read_file(j, &own);
+  if(!buf) buf = own;
+  if(!buf || !len){ free(own); return; }
+
+  uint32_t n = 0, cap = 256;
+  LineInfo *L = malloc(cap * sizeof *L);
+  if(!L){ free(own); j->oom = 1; return; }
+  for(size_t s = 0; s < len; ){
+    const char *nl = memchr(buf + s, '\n', len - s);
+    size_t e = nl ? (size_t)(nl - buf) : len;
+    if(n == cap){
+      LineInfo *grown = realloc(L, cap * 2 * sizeof *L);
+      if(!grown){ free(own); free(L); j->oom = 1; return; }
+      L = grown;
+      cap *= 2;
+    }
+    scan_line(buf + s, e - s, &L[n++]);
+    s = e + 1;
+  }
+  free(own);
+
+  const uint32_t budget = j->max_tokens ? j->max_tokens : 512;
+  uint32_t s = 0;
+  while(s < n){
+    // grow the window to the budget
+    uint32_t e = s, tok = L[s].tokens, half = s;
+    while(e + 1 < n && tok + L[e+1].tokens <= budget){
+      e++;
+      tok += L[e].tokens;
+      if(tok <= budget / 2) half = e;
+    }
+    // best break point in the second half, later wins ties
+    uint32_t best = e;
+    if(e + 1 < n){
+      int best_score = -1;
+      for(uint32_t i = e + 1; i-- > half; ){
+        int sc = break_score(L, n, i);
+        if(sc > best_score){ best_score = sc; best = i; }
+        if(sc == 100) break;
+      }
+    }
+    emit(j, s, best);
+    if(j->oom || best + 1 >= n) break;
+    uint32_t next = best + 1;
+    next = next > s + j->overlap ? next - j->overlap : next;
+    // overlap must never stall progress
+    s = next > s ? next : best + 1;
+  }
+  free(L);
+}
+
+static ChunkPlan* chunk_all(const char **paths, const char **texts, const size_t *lens,
+                            uint32_t n, uint32_t max_tokens, uint32_t overlap){
+  FileJob *jobs = calloc(n ? n : 1, sizeof *jobs);
+  if(!jobs) return NULL;
+  ThreadPool *tp = tp_global();
+  TpGroup g = TP_GROUP_INIT;
+  for(uint32_t i = 0; i < n; i++){
+    jobs[i].path       = paths ? paths[i] : NULL;
+    jobs[i].text       = texts ? texts[i] : NULL;
+    jobs[i].len        = texts ? lens[i]  : 0;
+    jobs[i].max_tokens = max_tokens;
+    jobs[i].overlap    = overlap;
+    tp_submit(tp, &g, chunk_file, &jobs[i]);
+  }
+  tp_wait(tp, &g);
+
+  ChunkPlan *cp = calloc(1, sizeof *cp);
+  uint32_t total = 0;
+  int oom = !cp;
+  for(uint32_t i = 0; i < n; i++){ total += jobs[i].n; oom |= jobs[i].oom; }
+  if(!oom && !(cp->r = malloc((total ? total : 1) * sizeof(Range)))) oom = 1;
+  if(oom){
+    for(uint32_t i = 0; i < n; i++) free(jobs[i].r);
+    free(jobs);
+    tc_free(cp);
+    return NULL;
+  }
+  for(uint32_t i = 0; i < n; i++){
+    for(uint32_t k = 0; k < jobs[i].n; k++){
+      Range r = jobs[i].r[k];
+      r.file = i;
+      cp->r[cp->n++] = r;
+    }
+    free(jobs[i].r);
+  }
+  free(jobs);
+  return cp;
+}
+
+ChunkPlan* tc_chunk_files(const char **paths, uint32_t n,
+                          uint32_t max_tokens, uint32_t overlap){
+  return chunk_all(paths, NULL, NULL, n, max_tokens, overlap);
+}
+
+ChunkPlan* tc_chunk_texts(const char **texts, const size_t *lens, uint32_t n,
+                          uint32_t max_tokens, uint32_t overlap){
+  return chunk_all(NULL, texts, lens, n, max_tokens, overlap);
+}
+
+uint32_t tc_count(ChunkPlan *cp){ return cp->n; }
+uint32_t tc_file (ChunkPlan *cp, uint32_t i){ return cp->r[i].file; }
+uint32_t tc_start(ChunkPlan *cp, uint32_t i){ return cp->r[i].start; }
+uint32_t tc_end  (ChunkPlan *cp, uint32_t i){ return cp->r[i].end; }
+
+void tc_free(ChunkPlan *cp){
+  if(!cp) return;
+  free(cp->r);
+  free(cp);
+}
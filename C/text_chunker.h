@@ -0,0 +1,27 @@
+// text_chunker.h
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Structure-aware line chunker for files without a tree-sitter parser.
+// Each file is cut into windows of at most `max_tokens` (estimated BPE
+// tokens), ending preferably after a top-level block (closing brace or
+// `end` at indent 0), at blank lines or before dedents. Consecutive windows
+// share `overlap` lines. A single line longer than the budget becomes its
+// own window. Files are chunked in parallel on the library thread pool.
+// A file that cannot be read gets no windows; NULL is returned only when
+// memory runs out.
+typedef struct ChunkPlan ChunkPlan;
+
+ChunkPlan* tc_chunk_files(const char **paths, uint32_t n,
+                          uint32_t max_tokens, uint32_t overlap);
+
+// The same over texts already in memory (texts[i] is lens[i] bytes), so
+// the windows match exactly the lines the caller holds.
+ChunkPlan* tc_chunk_texts(const char **texts, const size_t *lens, uint32_t n,
+                          uint32_t max_tokens, uint32_t overlap);
+uint32_t   tc_count(ChunkPlan *cp);
+uint32_t   tc_file (ChunkPlan *cp, uint32_t i);   // index into paths / texts
+uint32_t   tc_start(ChunkPlan *cp, uint32_t i);   // 1-based, inclusive
+uint32_t   tc_end  (ChunkPlan *cp, uint32_t i);   // 1-based, inclusive
+void       tc_free (ChunkPlan *cp);
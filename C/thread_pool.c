@@ -0,0 +1,144 @@
+// thread_pool.c
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct Task {
+  tp_fn        fn;
+  void        *arg;
+  TpGroup     *group;
+  struct Task *next;
+} Task;
+
+struct ThreadPool {
+  pthread_mutex_t mu;
+  pthread_cond_t  work;     // a task was queued or the pool is stopping
+  pthread_cond_t  done;     // some group reached zero
+  Task           *head, *tail;
+  int             stop;
+  uint32_t        nthreads;
+  pthread_t      *threads;
+};
+
+// Pop one task; caller holds tp->mu.
+static Task* pop(ThreadPool *tp){
+  Task *t = tp->head;
+  if(t){
+    tp->head = t->next;
+    if(!tp->head) tp->tail = NULL;
+  }
+  return t;
+}
+
+// Pop the oldest task of group `g`, leaving other groups' tasks queued;
+// caller holds tp->mu.
+static Task* pop_group(ThreadPool *tp, TpGroup *g){
+  Task *prev = NULL, *t = tp->head;
+  while(t && t->group != g){ prev = t; t = t->next; }
+  if(t){
+    if(prev) prev->next = t->next; else tp->head = t->next;
+    if(tp->tail == t) tp->tail = prev;
+  }
+  return t;
+}
+
+static void run(ThreadPool *tp, Task *t){
+  t->fn(t->arg);
+  if(t->group && atomic_fetch_sub(&t->group->pending, 1) == 1){
+    pthread_mutex_lock(&tp->mu);
+    pthread_cond_broadcast(&tp->done);
+    pthread_mutex_unlock(&tp->mu);
+  }
+  free(t);
+}
+
+static void* worker(void *arg){
+  ThreadPool *tp = arg;
+  pthread_mutex_lock(&tp->mu);
+  for(;;){
+    Task *t;
+    while(!(t = pop(tp)) && !tp->stop) pthread_cond_wait(&tp->work, &tp->mu);
+    if(!t) break;
+    pthread_mutex_unlock(&tp->mu);
+    run(tp, t);
+    pthread_mutex_lock(&tp->mu);
+  }
+  pthread_mutex_unlock(&tp->mu);
+  return NULL;
+}
+
+ThreadPool* tp_create(uint32_t nthreads){
+  if(nthreads == 0) nthreads = 1;
+  ThreadPool *tp = calloc(1, sizeof *tp);
+  pthread_mutex_init(&tp->mu, NULL);
+  pthread_cond_init(&tp->work, NULL);
+  pthread_cond_init(&tp->done, NULL);
+  tp->threads = calloc(nthreads, sizeof(pthread_t));
+  for(uint32_t i = 0; i < nthreads; i++){
+    if(pthread_create(&tp->threads[i], NULL, worker, tp) != 0) break;
+    tp->nthreads++;
+  }
+  return tp;
+}
+
+void tp_destroy(ThreadPool *tp){
+  if(!tp) return;
+  pthread_mutex_lock(&tp->mu);
+  tp->stop = 1;
+  pthread_cond_broadcast(&tp->work);
+  pthread_mutex_unlock(&tp->mu);
+  for(uint32_t i = 0; i < tp->nthreads; i++) pthread_join(tp->threads[i], NULL);
+  // tasks still queued when the pool stops are dropped
+  for(Task *t = tp->head, *n; t; t = n){ n = t->next; free(t); }
+  pthread_cond_destroy(&tp->work);
+  pthread_cond_destroy(&tp->done);
+  pthread_mutex_destroy(&tp->mu);
+  free(tp->threads);
+  free(tp);
+}
+
+uint32_t tp_size(ThreadPool *tp){ return tp->nthreads; }
+
+static ThreadPool     *g_pool;
+static pthread_once_t  g_once = PTHREAD_ONCE_INIT;
+
+static void global_init(void){
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if(n < 1) n = 1;
+  if(n > 8) n = 8;
+  g_pool = tp_create((uint32_t)n);
+}
+
+ThreadPool* tp_global(void){
+  pthread_once(&g_once, global_init);
+  return g_pool;
+}
+
+void tp_submit(ThreadPool *tp, TpGroup *g, tp_fn fn, void *arg){
+  Task *t = malloc(sizeof *t);
+  t->fn = fn; t->arg = arg; t->group = g; t->next = NULL;
+  if(g) atomic_fetch_add(&g->pending, 1);
+  pthread_mutex_lock(&tp->mu);
+  if(tp->tail) tp->tail->next = t; else tp->head = t;
+  tp->tail = t;
+  pthread_cond_signal(&tp->work);
+  pthread_mutex_unlock(&tp->mu);
+}
+
+void tp_wait(ThreadPool *tp, TpGroup *g){
+  pthread_mutex_lock(&tp->mu);
+  while(atomic_load(&g->pending)){
+    // help with our own queued tasks instead of sleeping; other groups'
+    // tasks may block (network embeds) or re-enter the caller's locks
+    Task *t = pop_group(tp, g);
+    if(t){
+      pthread_mutex_unlock(&tp->mu);
+      run(tp, t);
+      pthread_mutex_lock(&tp->mu);
+    } else {
+      pthread_cond_wait(&tp->done, &tp->mu);
+    }
+  }
+  pthread_mutex_unlock(&tp->mu);
+}
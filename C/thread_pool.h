@@ -0,0 +1,33 @@
+// thread_pool.h
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Small FIFO thread pool shared by the library (directory walks, chunking,
+// background searches). Tasks are grouped so a caller can wait for just the
+// work it submitted; waiting threads run that group's queued tasks
+// themselves, so tasks may submit and wait on sub-tasks without deadlocking
+// the pool, and a waiter never picks up unrelated work.
+typedef struct ThreadPool ThreadPool;
+typedef void (*tp_fn)(void *arg);
+
+typedef struct {
+  atomic_uint pending;
+} TpGroup;
+
+#define TP_GROUP_INIT { 0 }
+
+// Process-wide pool, created on first use with one thread per core
+// (at most 8).
+ThreadPool* tp_global(void);
+
+ThreadPool* tp_create(uint32_t nthreads);
+void        tp_destroy(ThreadPool *tp);
+uint32_t    tp_size(ThreadPool *tp);
+
+// Queue fn(arg). `g` (optional) counts the task until it has finished.
+void tp_submit(ThreadPool *tp, TpGroup *g, tp_fn fn, void *arg);
+
+// Block until every task submitted under `g` has finished, running queued
+// tasks of `g` (and only those) on the calling thread meanwhile.
+void tp_wait(ThreadPool *tp, TpGroup *g);
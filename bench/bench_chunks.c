@@ -0,0 +1,320 @@
+// bench_chunks.c — libchunks benchmark: load time, query latency, batch QPS
+#include "chunk_writer.h"
+#include "chunks.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ *  Writes a synthetic chunks.bin (uniform or clustered unit vectors), then
+ *  measures ci_load / ci_load_shared, single-query latency percentiles on
+ *  one thread and batch throughput across thread counts, and prints one
+ *  JSON object so runs can be diffed and tracked over time.
+ *
+ *    bench_chunks [--n N] [--dim D] [--dist uniform|clustered] [--dtype f32|i8]
+ *                 [--clusters C] [--queries Q] [--k K] [--budget-us B]
+ *                 [--threads 1,2,4,8] [--text-bytes T] [--reps R] [--seed S]
+ *                 [--index FILE] [--dir DIR] [--keep] [--out FILE]
+ *
+ *  The index stores f32 embeddings; --dtype i8 benchmarks the int8 code
+ *  path instead (ci_search_deadline: approximate ranking by codes, then
+ *  exact rescoring within --budget-us).
+ */
+
+typedef struct {
+  uint32_t    n, dim, clusters, queries, K, budget_us, text_bytes, reps;
+  uint64_t    seed;
+  const char *dist, *dtype, *index, *dir, *out;
+  int         keep;
+  uint32_t    threads[16], nthreads;
+} Opts;
+
+static double now_ms(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// xorshift64* and Box-Muller: reproducible across platforms for a seed
+static uint64_t rng_next(uint64_t *s){
+  *s ^= *s >> 12; *s ^= *s << 25; *s ^= *s >> 27;
+  return *s * 2685821657736338717ull;
+}
+
+static double rng_unit(uint64_t *s){ return (rng_next(s) >> 11) * (1.0 / 9007199254740992.0); }
+
+static float rng_gauss(uint64_t *s){
+  double u = rng_unit(s) + 1e-12, v = rng_unit(s);
+  return (float)(sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v));
+}
+
+static void normalize(float *v, uint32_t dim){
+  double s = 0;
+  for(uint32_t i = 0; i < dim; i++) s += (double)v[i] * v[i];
+  float inv = s > 0 ? (float)(1.0 / sqrt(s)) : 0;
+  for(uint32_t i = 0; i < dim; i++) v[i] *= inv;
+}
+
+// Uniform on the sphere, or a centroid plus noise for clustered data.
+static void gen_vec(const Opts *o, const float *cent, uint64_t *rng, float *v){
+  if(cent){
+    const float *c = cent + (size_t)(rng_next(rng) % o->clusters) * o->dim;
+    for(uint32_t i = 0; i < o->dim; i++) v[i] = c[i] + 0.35f * rng_gauss(rng) / sqrtf((float)o->dim);
+  } else {
+    for(uint32_t i = 0; i < o->dim; i++) v[i] = rng_gauss(rng);
+  }
+  normalize(v, o->dim);
+}
+
+static float* gen_centroids(const Opts *o, uint64_t *rng){
+  if(strcmp(o->dist, "clustered") != 0) return NULL;
+  float *cent = malloc((size_t)o->clusters * o->dim * sizeof *cent);
+  if(!cent) return NULL;
+  for(uint32_t c = 0; c < o->clusters; c++){
+    for(uint32_t i = 0; i < o->dim; i++) cent[(size_t)c * o->dim + i] = rng_gauss(rng);
+    normalize(cent + (size_t)c * o->dim, o->dim);
+  }
+  return cent;
+}
+
+static int write_index(const Opts *o, const char *path, const float *cent, uint64_t *rng){
+  ChunkWriter *cw = cw_open(path, "bench", 0, 0, 0);
+  if(!cw) return -1;
+  float *v = malloc(o->dim * sizeof *v);
+  char *text = malloc(o->text_bytes + 1), file[32];
+  if(!v || !text){ free(v); free(text); cw_close(cw); return -1; }
+  for(uint32_t i = 0; i < o->text_bytes; i++) text[i] = "abcdefgh ijklmnop\n"[i % 18];
+  for(uint32_t i = 0; i < o->n; i++){
+    gen_vec(o, cent, rng, v);
+    snprintf(file, sizeof file, "src/f%u.c", i / 64);
+    if(cw_add(cw, NULL, "", file, "c", i % 64 * 20, i % 64 * 20 + 19,
+              text, o->text_bytes, v, o->dim) != 0){
+      free(v); free(text); cw_close(cw);
+      return -1;
+    }
+  }
+  free(v); free(text);
+  return cw_finish(cw, NULL);
+}
+
+static int cmp_double(const void *a, const void *b){
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double median(double *v, uint32_t n){
+  qsort(v, n, sizeof *v, cmp_double);
+  return v[n / 2];
+}
+
+static double pct(const double *sorted, uint32_t n, double p){
+  uint32_t i = (uint32_t)(p * (n - 1) + 0.5);
+  return sorted[i < n ? i : n - 1];
+}
+
+typedef struct {
+  const Opts  *o;
+  ChunkIndex  *ci;
+  const float *qs;
+  uint32_t     lo, hi;
+  pthread_barrier_t *start;
+} Worker;
+
+static void search_one(const Opts *o, ChunkIndex *ci, const float *q, uint32_t *idx, double *sc){
+  if(strcmp(o->dtype, "i8") == 0)
+    ci_search_deadline(ci, q, o->dim, o->K, o->budget_us, idx, sc, NULL, NULL, NULL);
+  else
+    ci_search(ci, q, o->dim, o->K, idx, sc);
+}
+
+static void* worker(void *arg){
+  Worker *w = arg;
+  uint32_t *idx = malloc(w->o->K * sizeof *idx);
+  double   *sc  = malloc(w->o->K * sizeof *sc);
+  pthread_barrier_wait(w->start);
+  for(uint32_t i = w->lo; idx && sc && i < w->hi; i++)
+    search_one(w->o, w->ci, w->qs + (size_t)i * w->o->dim, idx, sc);
+  free(idx); free(sc);
+  return NULL;
+}
+
+// Queries per second with the batch split evenly over `nt` threads.
+static double batch_qps(const Opts *o, ChunkIndex *ci, const float *qs, uint32_t nt){
+  pthread_t th[64];
+  Worker w[64];
+  pthread_barrier_t start;
+  if(nt > 64) nt = 64;
+  pthread_barrier_init(&start, NULL, nt + 1);
+  for(uint32_t t = 0; t < nt; t++){
+    w[t] = (Worker){ o, ci, qs, (uint32_t)((uint64_t)o->queries * t / nt),
+                     (uint32_t)((uint64_t)o->queries * (t + 1) / nt), &start };
+    pthread_create(&th[t], NULL, worker, &w[t]);
+  }
+  pthread_barrier_wait(&start);
+  double t0 = now_ms();
+  for(uint32_t t = 0; t < nt; t++) pthread_join(th[t], NULL);
+  double ms = now_ms() - t0;
+  pthread_barrier_destroy(&start);
+  return ms > 0 ? o->queries / (ms / 1e3) : 0;
+}
+
+static void usage(void){
+  fprintf(stderr,
+    "usage: bench_chunks [--n N] [--dim D] [--dist uniform|clustered] [--dtype f32|i8]\n"
+    "                    [--clusters C] [--queries Q] [--k K] [--budget-us B]\n"
+    "                    [--threads 1,2,4,8] [--text-bytes T] [--reps R] [--seed S]\n"
+    "                    [--index FILE] [--dir DIR] [--keep] [--out FILE]\n");
+  exit(2);
+}
+
+static void parse_threads(Opts *o, const char *s){
+  o->nthreads = 0;
+  while(*s && o->nthreads < 16){
+    char *end;
+    long t = strtol(s, &end, 10);
+    if(end == s) usage();
+    s = end;
+    if(t > 0) o->threads[o->nthreads++] = (uint32_t)(t > 64 ? 64 : t);
+    if(*s == ',') s++;
+    else if(*s) usage();
+  }
+}
+
+int main(int argc, char **argv){
+  Opts o = { .n = 100000, .dim = 768, .clusters = 64, .queries = 1000, .K = 12,
+             .budget_us = 2000, .text_bytes = 256, .reps = 5, .seed = 42,
+             .dist = "uniform", .dtype = "f32", .dir = "/tmp" };
+  parse_threads(&o, "1,2,4,8");
+  for(int i = 1; i < argc; i++){
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if(strcmp(a, "--keep") == 0){ o.keep = 1; continue; }
+    if(!v) usage();
+    i++;
+    if     (strcmp(a, "--n") == 0)          o.n = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--dim") == 0)        o.dim = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--clusters") == 0)   o.clusters = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--queries") == 0)    o.queries = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--k") == 0)          o.K = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--budget-us") == 0)  o.budget_us = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--text-bytes") == 0) o.text_bytes = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--reps") == 0)       o.reps = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--seed") == 0)       o.seed = strtoull(v, NULL, 10);
+    else if(strcmp(a, "--dist") == 0)       o.dist = v;
+    else if(strcmp(a, "--dtype") == 0)      o.dtype = v;
+    else if(strcmp(a, "--threads") == 0)    parse_threads(&o, v);
+    else if(strcmp(a, "--index") == 0)      o.index = v;
+    else if(strcmp(a, "--dir") == 0)        o.dir = v;
+    else if(strcmp(a, "--out") == 0)        o.out = v;
+    else usage();
+  }
+  if((strcmp(o.dist, "uniform") && strcmp(o.dist, "clustered")) ||
+     (strcmp(o.dtype, "f32") && strcmp(o.dtype, "i8")) ||
+     !o.dim || !o.clusters || !o.queries || !o.K || !o.reps || !o.nthreads)
+    usage();
+
+  uint64_t rng = o.seed ? o.seed : 1;
+  float *cent = gen_centroids(&o, &rng);
+  char path[4096], prep[4112];
+  double gen_ms = 0;
+  if(o.index){
+    snprintf(path, sizeof path, "%s", o.index);
+  } else {
+    snprintf(path, sizeof path, "%s/bench_chunks_%d.bin", o.dir, (int)getpid());
+    double t0 = now_ms();
+    if(write_index(&o, path, cent, &rng) != 0){
+      fprintf(stderr, "bench_chunks: cannot write %s: %s\n", path, cw_error());
+      return 1;
+    }
+    gen_ms = now_ms() - t0;
+  }
+  snprintf(prep, sizeof prep, "%s.bench.prep", path);
+
+  // load: private copy, then the prepared cache cold (built) and warm
+  double *lt = malloc(o.reps * sizeof *lt), load_ms, prep_cold_ms, prep_warm_ms;
+  for(uint32_t r = 0; r < o.reps; r++){
+    double t0 = now_ms();
+    ChunkIndex *ci = ci_load(path);
+    lt[r] = now_ms() - t0;
+    if(!ci){ fprintf(stderr, "bench_chunks: cannot load %s\n", path); return 1; }
+    if(r + 1 == o.reps) o.dim = ci_get_dim(ci), o.n = ci_count(ci);
+    ci_free(ci);
+  }
+  load_ms = median(lt, o.reps);
+  unlink(prep);
+  double t0 = now_ms();
+  ci_free(ci_load_shared(path, prep));
+  prep_cold_ms = now_ms() - t0;
+  for(uint32_t r = 0; r < o.reps; r++){
+    t0 = now_ms();
+    ci_free(ci_load_shared(path, prep));
+    lt[r] = now_ms() - t0;
+  }
+  prep_warm_ms = median(lt, o.reps);
+  free(lt);
+
+  ChunkIndex *ci = ci_load(path);
+  float *qs = malloc((size_t)o.queries * o.dim * sizeof *qs);
+  uint32_t *idx = malloc(o.K * sizeof *idx);
+  double *sc = malloc(o.K * sizeof *sc), *lat = malloc(o.queries * sizeof *lat);
+  if(!ci || !qs || !idx || !sc || !lat){ fprintf(stderr, "bench_chunks: out of memory\n"); return 1; }
+  // the dimension of an existing index is only known now
+  if(o.index){ free(cent); cent = NULL; }
+  for(uint32_t i = 0; i < o.queries; i++) gen_vec(&o, cent, &rng, qs + (size_t)i * o.dim);
+
+  // warm up (page faults, int8 codes), then time each query on this thread
+  for(uint32_t i = 0; i < o.queries && i < 16; i++) search_one(&o, ci, qs + (size_t)i * o.dim, idx, sc);
+  for(uint32_t i = 0; i < o.queries; i++){
+    t0 = now_ms();
+    search_one(&o, ci, qs + (size_t)i * o.dim, idx, sc);
+    lat[i] = (now_ms() - t0) * 1e3;
+  }
+  double sum = 0;
+  for(uint32_t i = 0; i < o.queries; i++) sum += lat[i];
+  qsort(lat, o.queries, sizeof *lat, cmp_double);
+
+  FILE *f = o.out ? fopen(o.out, "w") : stdout;
+  if(!f){ fprintf(stderr, "bench_chunks: cannot write %s\n", o.out); return 1; }
+  fprintf(f, "{\n");
+  fprintf(f, "  \"timestamp\": %lld,\n", (long long)time(NULL));
+  fprintf(f, "  \"compiler\": \"%s\",\n",
+#if defined(__clang__)
+          "clang " __clang_version__
+#elif defined(__GNUC__)
+          "gcc " __VERSION__
+#else
+          "unknown"
+#endif
+  );
+  fprintf(f, "  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+  fprintf(f, "  \"config\": { \"n\": %u, \"dim\": %u, \"dist\": \"%s\", \"dtype\": \"%s\", "
+             "\"clusters\": %u, \"queries\": %u, \"k\": %u, \"budget_us\": %u, "
+             "\"text_bytes\": %u, \"seed\": %llu, \"index\": \"%s\" },\n",
+          o.n, o.dim, o.index ? "file" : o.dist, o.dtype, o.clusters, o.queries, o.K,
+          o.budget_us, o.text_bytes, (unsigned long long)o.seed, o.index ? o.index : "");
+  fprintf(f, "  \"generate_ms\": %.3f,\n", gen_ms);
+  fprintf(f, "  \"load_ms\": { \"private\": %.3f, \"prepared_cold\": %.3f, \"prepared_warm\": %.3f },\n",
+          load_ms, prep_cold_ms, prep_warm_ms);
+  fprintf(f, "  \"latency_us\": { \"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f },\n",
+          sum / o.queries, pct(lat, o.queries, .50), pct(lat, o.queries, .90),
+          pct(lat, o.queries, .99), lat[o.queries - 1]);
+  fprintf(f, "  \"batch\": [");
+  double base = 0;
+  for(uint32_t t = 0; t < o.nthreads; t++){
+    double qps = batch_qps(&o, ci, qs, o.threads[t]);
+    if(t == 0) base = qps / o.threads[0];
+    fprintf(f, "%s\n    { \"threads\": %u, \"qps\": %.1f, \"speedup\": %.2f }",
+            t ? "," : "", o.threads[t], qps, base > 0 ? qps / base : 0);
+  }
+  fprintf(f, "\n  ]\n}\n");
+  if(f != stdout) fclose(f);
+
+  ci_free(ci);
+  free(qs); free(idx); free(sc); free(lat); free(cent);
+  unlink(prep);
+  if(!o.index && !o.keep) unlink(path);
+  return 0;
+}
@@ -0,0 +1,291 @@
+// bench_kernels.c — per-ISA microbenchmarks of the SIMD kernels, with a roofline
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ *  cosine_simd.c is compiled once per ISA the compiler can target (see
+ *  CMakeLists.txt); every copy the host can run is timed on each kernel at
+ *  a few working-set sizes. Each row reports GB/s and GFLOP/s next to two
+ *  measured ceilings: the single-core vector FMA peak of that ISA and the
+ *  read bandwidth at the row's working set. attainable = min(peak, AI x
+ *  bandwidth) with AI = flops / byte, and `bound` says which one caps it.
+ *  Output is one JSON object, like bench_chunks.
+ *
+ *    bench_kernels [--sizes 768,65536,8388608] [--min-ms M] [--out FILE]
+ *
+ *  int8 kernels count integer ops against the f32 FMA peak, which
+ *  understates their compute ceiling. Rows above 100% of their roof get
+ *  "over_roof" and a note on stderr. A new kernel needs its symbol in
+ *  kernel_names.h, KB_DECLARE, Isa and KB_ISA_ROW, and one KERNELS row.
+ */
+
+#define KB_DECLARE(isa)                                                              \
+  void     isa##_f32_dot_product_simd(const float*, const float*, double*, uint64_t); \
+  void     isa##_norm_simd(float*, uint32_t);                                        \
+  int32_t  isa##_i8_dot_product_simd(const int8_t*, const int8_t*, uint64_t);        \
+  float    isa##_f32_quantize_i8_simd(const float*, int8_t*, uint64_t);              \
+  uint32_t isa##_kb_lanes(void);                                                     \
+  float    isa##_kb_fma_loop(uint64_t);                                              \
+  float    isa##_kb_read_loop(const float*, size_t, uint32_t);
+
+typedef struct {
+  const char *name;
+  int       (*supported)(void);
+  void      (*dot)(const float*, const float*, double*, uint64_t);
+  void      (*norm)(float*, uint32_t);
+  int32_t   (*i8_dot)(const int8_t*, const int8_t*, uint64_t);
+  float     (*quant)(const float*, int8_t*, uint64_t);
+  uint32_t  (*lanes)(void);
+  float     (*fma_loop)(uint64_t);
+  float     (*read_loop)(const float*, size_t, uint32_t);
+} Isa;
+
+#define KB_ISA_ROW(isa, check)                                                        \
+  { #isa, check, isa##_f32_dot_product_simd, isa##_norm_simd,                         \
+    isa##_i8_dot_product_simd, isa##_f32_quantize_i8_simd,                            \
+    isa##_kb_lanes, isa##_kb_fma_loop, isa##_kb_read_loop },
+
+static int always(void){ return 1; }
+
+#if defined(__x86_64__) || defined(__i386__)
+static int has_avx2(void){ return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"); }
+static int has_avx512(void){ return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+                                __builtin_cpu_supports("avx512dq"); }
+#endif
+
+#ifdef KB_HAVE_SCALAR
+KB_DECLARE(scalar)
+#endif
+#ifdef KB_HAVE_NEON
+KB_DECLARE(neon)
+#endif
+#ifdef KB_HAVE_AVX2
+KB_DECLARE(avx2)
+#endif
+#ifdef KB_HAVE_AVX512
+KB_DECLARE(avx512)
+#endif
+
+// narrowest first; the last supported one also measures bandwidth
+static const Isa ISAS[] = {
+#ifdef KB_HAVE_SCALAR
+  KB_ISA_ROW(scalar, always)
+#endif
+#ifdef KB_HAVE_NEON
+  KB_ISA_ROW(neon, always)
+#endif
+#ifdef KB_HAVE_AVX2
+  KB_ISA_ROW(avx2, has_avx2)
+#endif
+#ifdef KB_HAVE_AVX512
+  KB_ISA_ROW(avx512, has_avx512)
+#endif
+};
+#define NISA (sizeof ISAS / sizeof ISAS[0])
+
+typedef struct {
+  float  *x, *y;   // contiguous: y = x + n
+  int8_t *a, *b;
+} Bufs;
+
+static volatile double g_sink;
+
+static void run_dot(const Isa *isa, Bufs *m, size_t n){
+  double r;
+  isa->dot(m->x, m->y, &r, n);
+  g_sink += r;
+}
+static void run_norm(const Isa *isa, Bufs *m, size_t n){ isa->norm(m->x, (uint32_t)n); }
+static void run_i8_dot(const Isa *isa, Bufs *m, size_t n){ g_sink += isa->i8_dot(m->a, m->b, n); }
+static void run_quant(const Isa *isa, Bufs *m, size_t n){ g_sink += isa->quant(m->x, m->a, n); }
+
+typedef struct {
+  const char *name;
+  double      bytes, flops;  // per element, as the kernel touches memory
+  size_t      footprint;     // distinct bytes per element (working set)
+  int         int_ops;
+  void      (*run)(const Isa*, Bufs*, size_t n);
+} Kernel;
+
+static const Kernel KERNELS[] = {
+  { "f32_dot_product", 8,  2, 8, 0, run_dot    },  // x[i]*y[i] + acc
+  { "norm",            12, 3, 4, 0, run_norm   },  // sum of squares, then scale in place
+  { "i8_dot_product",  2,  2, 2, 1, run_i8_dot },
+  { "f32_quantize_i8", 5,  3, 5, 0, run_quant  },  // max |x|, scale, round
+};
+#define NKERNEL (sizeof KERNELS / sizeof KERNELS[0])
+
+static double now_s(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Seconds per call of `fn`: reps are doubled until a trial lasts min_s, and
+// the best of three trials is kept.
+#define TIME_CALLS(out, min_s, call) do {                          \
+    uint64_t reps_ = 1;                                            \
+    double t_;                                                     \
+    for(;;){                                                       \
+      double t0_ = now_s();                                        \
+      for(uint64_t r_ = 0; r_ < reps_; r_++){ call; }              \
+      t_ = now_s() - t0_;                                          \
+      if(t_ >= (min_s)) break;                                     \
+      reps_ *= 2;                                                  \
+    }                                                              \
+    double best_ = t_ / reps_;                                     \
+    for(int k_ = 0; k_ < 2; k_++){                                 \
+      double t0_ = now_s();                                        \
+      for(uint64_t r_ = 0; r_ < reps_; r_++){ call; }              \
+      t_ = (now_s() - t0_) / reps_;                                \
+      if(t_ < best_) best_ = t_;                                   \
+    }                                                              \
+    (out) = best_;                                                 \
+  } while(0)
+
+static double peak_gflops(const Isa *isa, double min_s){
+  const uint64_t iters = 1u << 16;
+  double s;
+  TIME_CALLS(s, min_s, g_sink += isa->fma_loop(iters));
+  return (double)iters * 12 * 2 * isa->lanes() / s / 1e9;  // KB_CHAINS FMAs
+}
+
+static double read_gbps(const Isa *isa, const float *p, size_t n, double min_s){
+  size_t step = (size_t)isa->lanes() * 16;  // 4 streams x KB_READ_ACC vectors
+  n -= n % step;
+  if(!n) return 0;
+  // small working sets are read several times per call, so the call and
+  // the final reduction do not count against the bandwidth
+  uint32_t passes = n < 16384 ? (uint32_t)(16384 / n) : 1;
+  double s;
+  TIME_CALLS(s, min_s, g_sink += isa->read_loop(p, n, passes));
+  return (double)n * passes * sizeof(float) / s / 1e9;
+}
+
+static void usage(void){
+  fprintf(stderr, "usage: bench_kernels [--sizes 768,65536,8388608] [--min-ms M] [--out FILE]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv){
+  size_t sizes[16] = { 768, 65536, 8388608 }, nsize = 3, maxn = 0;
+  double min_s = 0.02;
+  const char *out = NULL;
+  for(int i = 1; i < argc; i++){
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if(!v) usage();
+    i++;
+    if(strcmp(a, "--sizes") == 0){
+      nsize = 0;
+      for(const char *s = v; *s && nsize < 16; ){
+        char *end;
+        unsigned long long n = strtoull(s, &end, 10);
+        if(end == s || n == 0 || n > UINT32_MAX) usage();
+        sizes[nsize++] = (size_t)n;
+        s = *end == ',' ? end + 1 : end;
+      }
+    }
+    else if(strcmp(a, "--min-ms") == 0) min_s = atof(v) / 1e3;
+    else if(strcmp(a, "--out") == 0)    out = v;
+    else usage();
+  }
+  if(!nsize || min_s <= 0) usage();
+  for(size_t k = 0; k < nsize; k++) if(sizes[k] > maxn) maxn = sizes[k];
+
+  Bufs m;
+  m.x = malloc(2 * maxn * sizeof(float));
+  m.a = malloc(2 * maxn);
+  if(!m.x || !m.a){ fprintf(stderr, "bench_kernels: out of memory\n"); return 1; }
+  uint32_t seed = 1;
+  for(size_t i = 0; i < 2 * maxn; i++){
+    seed = seed * 1664525u + 1013904223u;
+    m.x[i] = (float)(seed >> 8) / (1u << 24) - 0.5f;
+    m.a[i] = (int8_t)(seed >> 24);
+  }
+
+  const Isa *widest = NULL;
+  for(size_t k = 0; k < NISA; k++) if(ISAS[k].supported()) widest = &ISAS[k];
+  if(!widest){ fprintf(stderr, "bench_kernels: no runnable ISA\n"); return 1; }
+
+  FILE *f = out ? fopen(out, "w") : stdout;
+  if(!f){ fprintf(stderr, "bench_kernels: cannot write %s\n", out); return 1; }
+  fprintf(f, "{\n  \"timestamp\": %lld,\n", (long long)time(NULL));
+  fprintf(f, "  \"compiler\": \"%s\",\n",
+#if defined(__clang__)
+          "clang " __clang_version__
+#elif defined(__GNUC__)
+          "gcc " __VERSION__
+#else
+          "unknown"
+#endif
+  );
+
+  // read bandwidth over each row's footprint, which decides the cache
+  // level; `done` is indexed like bw and holds 0 for repeated sizes
+  double bw[NKERNEL][16];
+  size_t done[NKERNEL * 16], ndone = 0;
+  fprintf(f, "  \"bandwidth\": { \"isa\": \"%s\", \"read_gbps\": [", widest->name);
+  for(size_t j = 0; j < NKERNEL; j++)
+    for(size_t k = 0; k < nsize; k++){
+      size_t bytes = KERNELS[j].footprint * sizes[k], seen = 0;
+      for(size_t d = 0; d < ndone; d++) if(done[d] == bytes) seen = d + 1;
+      if(seen){
+        bw[j][k] = bw[(seen - 1) / nsize][(seen - 1) % nsize];
+        done[ndone++] = 0;
+        continue;
+      }
+      bw[j][k] = read_gbps(widest, m.x, bytes / sizeof(float), min_s);
+      fprintf(f, "%s\n    { \"bytes\": %zu, \"gbps\": %.2f }", ndone ? "," : "", bytes, bw[j][k]);
+      done[ndone++] = bytes;
+    }
+  fprintf(f, "\n  ] },\n  \"isas\": [");
+
+  int first_isa = 1;
+  for(size_t k = 0; k < NISA; k++){
+    const Isa *isa = &ISAS[k];
+    if(!isa->supported()) continue;
+    double peak = peak_gflops(isa, min_s);
+    fprintf(f, "%s\n    { \"isa\": \"%s\", \"lanes\": %u, \"peak_gflops\": %.2f, \"kernels\": [",
+            first_isa ? "" : ",", isa->name, isa->lanes(), peak);
+    first_isa = 0;
+    int first_row = 1;
+    for(size_t j = 0; j < NKERNEL; j++){
+      const Kernel *kr = &KERNELS[j];
+      for(size_t s = 0; s < nsize; s++){
+        size_t n = sizes[s];
+        m.y = m.x + n;
+        m.b = m.a + n;
+        double sec;
+        TIME_CALLS(sec, min_s, kr->run(isa, &m, n));
+        double gbps   = kr->bytes * n / sec / 1e9;
+        double gflops = kr->flops * n / sec / 1e9;
+        double ai     = kr->flops / kr->bytes;
+        double mem    = ai * bw[j][s];
+        double roof   = mem < peak ? mem : peak;
+        double pct    = roof > 0 ? 100 * gflops / roof : 0;
+        // above the roof means a probe underestimated a ceiling; int8 rows
+        // can get there against the f32 peak (see above)
+        int over = pct > 100;
+        if(over)
+          fprintf(stderr, "bench_kernels: %s %s n=%zu at %.0f%% of its %s roof%s\n",
+                  isa->name, kr->name, n, pct, mem < peak ? "memory" : "compute",
+                  kr->int_ops && mem >= peak ? " (integer ops vs the f32 peak)" : "");
+        fprintf(f, "%s\n      { \"kernel\": \"%s\", \"n\": %zu, \"ns\": %.1f, \"gbps\": %.2f, "
+                   "\"gflops\": %.2f, \"ai\": %.3f, \"bw_gbps\": %.2f, \"roof_gflops\": %.2f, \"pct_of_roof\": %.1f, "
+                   "\"bound\": \"%s\"%s%s }",
+                first_row ? "" : ",", kr->name, n, sec * 1e9, gbps, gflops, ai, bw[j][s], roof,
+                pct, mem < peak ? "memory" : "compute",
+                kr->int_ops ? ", \"int_ops\": true" : "", over ? ", \"over_roof\": true" : "");
+        first_row = 0;
+      }
+    }
+    fprintf(f, "\n    ] }");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  if(f != stdout) fclose(f);
+  free(m.x); free(m.a);
+  return 0;
+}
@@ -0,0 +1,480 @@
+// eval_search.c — recall / MRR / latency of the search modes against exact ground truth
+#include "chunks.h"
+#include "hash_embed.h"
+#include "http_client.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ *  Ground truth is a brute-force scan of the embeddings read straight from
+ *  the file, scored in double precision and fully sorted, so it shares no
+ *  code with the searches it grades. Every mode is run over the same
+ *  queries for each value of its parameter sweep and scored against it:
+ *
+ *    recall@K  |approx top-K ∩ exact top-K| / |exact top-K|, averaged
+ *    MRR       1 / rank of the exact best hit in the approximate list
+ *              (0 when it is missing), averaged
+ *    latency   per-query wall time, single thread, after a warm-up
+ *
+ *  The "exact" row (ci_search) is a sanity check: it must score 1.0, and
+ *  anything less is a bug in the library's exact path.
+ *
+ *    eval_search --index FILE [--vectors FILE | --texts FILE | --sample N]
+ *                [--endpoint URL] [--model NAME]
+ *                [--k K] [--sweep 1,50,100,...] [--seed S] [--out FILE]
+ *
+ *  --vectors  raw little-endian f32 queries, dim floats each
+ *  --texts    one query per line, embedded as below
+ *  --sample   N chunk texts of the index itself as queries, embedded as below
+ *  --endpoint OpenAI-style embeddings endpoint (default the plugin's,
+ *             http://127.0.0.1:8080/v1/embeddings; a local stub works)
+ *  --model    model name sent to the endpoint (default the one recorded in
+ *             the index); "hash" embeds with the built-in hash embedder
+ *             instead, which only matches indexes built with it
+ *
+ *  --sweep    parameter values each mode is run with (deadline_i8: the
+ *             rescoring budget in µs; 1 is close to ranking by codes alone)
+ *
+ *  Output is one JSON object, like bench_chunks. A new approximate mode is
+ *  one MODES row: a search function and the name of its swept parameter.
+ */
+
+typedef uint32_t (*mode_fn)(ChunkIndex *ci, const float *q, uint32_t dim, uint32_t K,
+                            uint32_t param, uint32_t *idxs, double *scores);
+
+// ci_search leaves its top K in heap order; ranks need them best first
+static uint32_t run_exact(ChunkIndex *ci, const float *q, uint32_t dim, uint32_t K,
+                          uint32_t param, uint32_t *idxs, double *scores){
+  (void)param;
+  uint32_t n = ci_search(ci, q, dim, K, idxs, scores);
+  for(uint32_t i = 1; i < n; i++)
+    for(uint32_t j = i; j > 0 && scores[j-1] < scores[j]; j--){
+      double s = scores[j]; scores[j] = scores[j-1]; scores[j-1] = s;
+      uint32_t x = idxs[j]; idxs[j] = idxs[j-1]; idxs[j-1] = x;
+    }
+  return n;
+}
+
+// int8 code ranking, then exact rescoring for `param` µs
+static uint32_t run_deadline(ChunkIndex *ci, const float *q, uint32_t dim, uint32_t K,
+                             uint32_t param, uint32_t *idxs, double *scores){
+  return ci_search_deadline(ci, q, dim, K, param, idxs, scores, NULL, NULL, NULL);
+}
+
+static const struct {
+  const char *name, *param;  // param: what the --sweep values mean
+  mode_fn     run;
+} MODES[] = {
+  { "deadline_i8", "budget_us", run_deadline },
+};
+#define NMODE (sizeof MODES / sizeof MODES[0])
+
+static double now_us(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b){
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double pct(const double *sorted, uint32_t n, double p){
+  uint32_t i = (uint32_t)(p * (n - 1) + 0.5);
+  return sorted[i < n ? i : n - 1];
+}
+
+static void normalize(float *v, uint32_t dim){
+  double s = 0;
+  for(uint32_t i = 0; i < dim; i++) s += (double)v[i] * v[i];
+  float inv = s > 0 ? (float)(1.0 / sqrt(s)) : 0;
+  for(uint32_t i = 0; i < dim; i++) v[i] *= inv;
+}
+
+/* ---------------------------------------------------------------------
+ * Ground truth
+ * ------------------------------------------------------------------- */
+
+static int get_u32(const uint8_t **p, const uint8_t *end, uint32_t *v){
+  if(end - *p < 4) return 0;
+  *v = (uint32_t)(*p)[0] | (uint32_t)(*p)[1] << 8 | (uint32_t)(*p)[2] << 16 | (uint32_t)(*p)[3] << 24;
+  *p += 4;
+  return 1;
+}
+
+static int skip_str(const uint8_t **p, const uint8_t *end){
+  uint32_t n;
+  if(!get_u32(p, end, &n) || (size_t)(end - *p) < n) return 0;
+  *p += n;
+  return 1;
+}
+
+// Every embedding of chunks.bin (layout in chunks.h), in slot order and
+// normalised; a record of another dimension (which searches skip) is
+// flagged in *skip. Returns NULL on a malformed file.
+static float* read_index_vectors(const char *path, uint32_t dim, uint32_t *n, uint8_t **skip){
+  FILE *f = fopen(path, "rb");
+  if(!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *buf = sz > 0 ? malloc((size_t)sz) : NULL;
+  int ok = buf && fread(buf, 1, (size_t)sz, f) == (size_t)sz;
+  fclose(f);
+  if(!ok){ free(buf); return NULL; }
+
+  const uint8_t *p = buf, *end = buf + sz;
+  uint32_t N, magic, version, hdim;
+  float *emb = NULL;
+  *skip = NULL;
+  if(!get_u32(&p, end, &magic)) goto fail;
+  if(magic == CI_MAGIC){
+    if(!get_u32(&p, end, &version) || !skip_str(&p, end) ||
+       !get_u32(&p, end, &hdim) || !get_u32(&p, end, &N)) goto fail;
+  } else {
+    N = magic;  // legacy files start with the chunk count
+  }
+  if(N > (size_t)(end - p) / 32) goto fail;
+  emb   = calloc((size_t)(N ? N : 1) * dim, sizeof *emb);
+  *skip = calloc(N ? N : 1, 1);
+  if(!emb || !*skip) goto fail;
+  for(uint32_t i = 0; i < N; i++){
+    uint32_t d;
+    for(int k = 0; k < 4; k++) if(!skip_str(&p, end)) goto fail;  // id parent file ext
+    if(end - p < 8) goto fail;
+    p += 8;                                                        // start end
+    if(!skip_str(&p, end) || !get_u32(&p, end, &d)) goto fail;     // text, dim
+    if((size_t)(end - p) / sizeof(float) < d) goto fail;
+    if(d == dim){
+      memcpy(emb + (size_t)i * dim, p, (size_t)dim * sizeof(float));
+      normalize(emb + (size_t)i * dim, dim);
+    } else {
+      (*skip)[i] = 1;
+    }
+    p += (size_t)d * sizeof(float);
+  }
+  free(buf);
+  *n = N;
+  return emb;
+
+fail:
+  free(buf); free(emb); free(*skip);
+  *skip = NULL;
+  return NULL;
+}
+
+typedef struct { double score; uint32_t idx; } Ranked;
+
+static int by_score_desc(const void *a, const void *b){
+  const Ranked *x = a, *y = b;
+  if(x->score != y->score) return (x->score < y->score) - (x->score > y->score);
+  return (x->idx > y->idx) - (x->idx < y->idx);
+}
+
+// Top K of one query: every row scored in double precision, then sorted.
+static uint32_t brute_top(const float *emb, const uint8_t *skip, uint32_t N, uint32_t dim,
+                          const float *q, uint32_t K, Ranked *all, uint32_t *out){
+  uint32_t m = 0;
+  for(uint32_t i = 0; i < N; i++){
+    if(skip[i]) continue;
+    const float *e = emb + (size_t)i * dim;
+    double s = 0;
+    for(uint32_t d = 0; d < dim; d++) s += (double)q[d] * e[d];
+    all[m++] = (Ranked){ s, i };
+  }
+  qsort(all, m, sizeof *all, by_score_desc);
+  uint32_t n = m < K ? m : K;
+  for(uint32_t j = 0; j < n; j++) out[j] = all[j].idx;
+  return n;
+}
+
+static void usage(void){
+  fprintf(stderr,
+    "usage: eval_search --index FILE [--vectors FILE | --texts FILE | --sample N]\n"
+    "                   [--endpoint URL] [--model NAME]\n"
+    "                   [--k K] [--sweep 1,50,100,...] [--seed S] [--out FILE]\n");
+  exit(2);
+}
+
+static float* read_vectors(const char *path, uint32_t dim, uint32_t *nq){
+  FILE *f = fopen(path, "rb");
+  if(!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long sz = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  size_t row = (size_t)dim * sizeof(float);
+  float *qs = NULL;
+  if(sz > 0 && (size_t)sz % row == 0 && (qs = malloc((size_t)sz))){
+    *nq = (uint32_t)((size_t)sz / row);
+    if(fread(qs, row, *nq, f) != *nq){ free(qs); qs = NULL; }
+  } else {
+    fprintf(stderr, "eval_search: %s is not a whole number of %u-float vectors\n", path, dim);
+  }
+  fclose(f);
+  if(qs) for(uint32_t i = 0; i < *nq; i++) normalize(qs + (size_t)i * dim, dim);
+  return qs;
+}
+
+/* ---------------------------------------------------------------------
+ * Query embedding: the endpoint (as the plugin does) or the hash embedder
+ * ------------------------------------------------------------------- */
+
+// Writes s[0..n) as a quoted JSON string; out needs room for 6n + 3 bytes.
+static size_t json_quote(char *out, const char *s, size_t n){
+  static const char hex[] = "0123456789abcdef";
+  size_t o = 0;
+  out[o++] = '"';
+  for(size_t i = 0; i < n; i++){
+    unsigned char c = (unsigned char)s[i];
+    if(c == '"' || c == '\\'){ out[o++] = '\\'; out[o++] = (char)c; }
+    else if(c == '\n'){ out[o++] = '\\'; out[o++] = 'n'; }
+    else if(c == '\t'){ out[o++] = '\\'; out[o++] = 't'; }
+    else if(c < 0x20){
+      memcpy(out + o, "\\u00", 4);
+      out[o + 4] = hex[c >> 4];
+      out[o + 5] = hex[c & 15];
+      o += 6;
+    }
+    else out[o++] = (char)c;
+  }
+  out[o++] = '"';
+  out[o] = 0;
+  return o;
+}
+
+static void print_json_str(FILE *f, const char *s){
+  size_t n = strlen(s);
+  char *q = malloc(6 * n + 3);
+  if(!q) return;
+  json_quote(q, s, n);
+  fputs(q, f);
+  free(q);
+}
+
+typedef struct {
+  HttpClient   *http;   // NULL with the hash embedder
+  HashEmbedder *hx;
+  const char   *model;
+  uint32_t      dim;
+  char         *body;
+  size_t        cap;
+} Embedder;
+
+static int embedder_open(Embedder *e, const char *endpoint, const char *model, uint32_t dim){
+  memset(e, 0, sizeof *e);
+  e->model = model;
+  e->dim   = dim;
+  if(strcmp(model, HX_MODEL) == 0) e->hx = hx_new(dim);
+  else if(!(e->http = hc_open(endpoint))) fprintf(stderr, "eval_search: invalid endpoint %s\n", endpoint);
+  return e->hx || e->http ? 0 : -1;
+}
+
+static void embedder_close(Embedder *e){
+  hx_free(e->hx);
+  hc_close(e->http);
+  free(e->body);
+}
+
+// Embed one text into out[dim], normalised. Returns 0, or -1 with a message.
+static int embed(Embedder *e, const char *text, size_t len, float *out){
+  if(e->hx){ hx_embed(e->hx, text, len, out); return 0; }
+  size_t need = 6 * (len + strlen(e->model)) + 128;
+  if(need > e->cap){
+    char *b = realloc(e->body, need);
+    if(!b){ fprintf(stderr, "eval_search: out of memory\n"); return -1; }
+    e->body = b;
+    e->cap  = need;
+  }
+  size_t n = (size_t)sprintf(e->body, "{\"model\":");
+  n += json_quote(e->body + n, e->model, strlen(e->model));
+  n += (size_t)sprintf(e->body + n, ",\"input\":[");
+  n += json_quote(e->body + n, text, len);
+  n += (size_t)sprintf(e->body + n, "],\"encoding_format\":\"base64\"}");
+  int d = hc_embed(e->http, e->body, n, out, e->dim);
+  if(d < 0){ fprintf(stderr, "eval_search: embed: %s\n", hc_error(e->http)); return -1; }
+  if((uint32_t)d != e->dim){
+    fprintf(stderr, "eval_search: the endpoint returned %d dims, the index has %u\n", d, e->dim);
+    return -1;
+  }
+  normalize(out, e->dim);
+  return 0;
+}
+
+static float* embed_texts(Embedder *e, const char *path, uint32_t *nq){
+  FILE *f = fopen(path, "r");
+  if(!f) return NULL;
+  uint32_t dim = e->dim, n = 0, cap = 0;
+  float *qs = NULL;
+  char line[8192];
+  while(fgets(line, sizeof line, f)){
+    size_t len = strcspn(line, "\r\n");
+    if(!len) continue;
+    if(n == cap){
+      cap = cap ? cap * 2 : 64;
+      float *p = realloc(qs, (size_t)cap * dim * sizeof *p);
+      if(!p){ n = 0; break; }
+      qs = p;
+    }
+    if(embed(e, line, len, qs + (size_t)n * dim) != 0){ n = 0; break; }
+    n++;
+  }
+  fclose(f);
+  *nq = n;
+  return n ? qs : (free(qs), NULL);
+}
+
+static float* sample_chunks(Embedder *e, ChunkIndex *ci, uint32_t want, uint64_t seed, uint32_t *nq){
+  uint32_t N = ci_count(ci), dim = e->dim, n = 0;
+  float *qs = N ? malloc((size_t)want * dim * sizeof *qs) : NULL;
+  for(uint32_t tries = 0; qs && n < want && tries < want * 4u; tries++){
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    const char *t = ci_get_text(ci, (uint32_t)((seed >> 33) % N));
+    if(!*t) continue;
+    if(embed(e, t, strlen(t), qs + (size_t)n * dim) != 0){ n = 0; break; }
+    n++;
+  }
+  *nq = n;
+  return n ? qs : (free(qs), NULL);
+}
+
+typedef struct {
+  double recall, mrr, lat[4];  // lat: mean, p50, p95, p99
+} Score;
+
+// Run `run` over every query, scoring against `gt` (nq x K, with gt_n hits).
+static Score evaluate(ChunkIndex *ci, const float *qs, uint32_t nq, uint32_t dim, uint32_t K,
+                      mode_fn run, uint32_t param, const uint32_t *gt, const uint32_t *gt_n){
+  uint32_t *idx = malloc(K * sizeof *idx);
+  double   *sc  = malloc(K * sizeof *sc), *lat = malloc(nq * sizeof *lat);
+  Score s = {0};
+  for(uint32_t i = 0; i < nq && i < 8; i++) run(ci, qs + (size_t)i * dim, dim, K, param, idx, sc);
+  double sum = 0;
+  for(uint32_t i = 0; i < nq; i++){
+    double t0 = now_us();
+    uint32_t n = run(ci, qs + (size_t)i * dim, dim, K, param, idx, sc);
+    lat[i] = now_us() - t0;
+    sum += lat[i];
+
+    const uint32_t *g = gt + (size_t)i * K;
+    uint32_t hit = 0;
+    for(uint32_t a = 0; a < n; a++)
+      for(uint32_t b = 0; b < gt_n[i]; b++)
+        if(idx[a] == g[b]){ hit++; break; }
+    if(gt_n[i]) s.recall += (double)hit / gt_n[i];
+    for(uint32_t a = 0; gt_n[i] && a < n; a++)
+      if(idx[a] == g[0]){ s.mrr += 1.0 / (a + 1); break; }
+  }
+  qsort(lat, nq, sizeof *lat, cmp_double);
+  s.recall /= nq;
+  s.mrr    /= nq;
+  s.lat[0] = sum / nq;
+  s.lat[1] = pct(lat, nq, .50);
+  s.lat[2] = pct(lat, nq, .95);
+  s.lat[3] = pct(lat, nq, .99);
+  free(idx); free(sc); free(lat);
+  return s;
+}
+
+
+static void print_row(FILE *f, int first, const char *mode, const char *param, uint32_t value, Score s){
+  fprintf(f, "%s\n    { \"mode\": \"%s\", ", first ? "" : ",", mode);
+  if(param) fprintf(f, "\"%s\": %u, ", param, value);
+  else      fprintf(f, "\"sanity_check\": true, ");
+  fprintf(f, "\"recall_at_k\": %.4f, \"mrr\": %.4f, "
+             "\"latency_us\": { \"mean\": %.1f, \"p50\": %.1f, \"p95\": %.1f, \"p99\": %.1f } }",
+          s.recall, s.mrr, s.lat[0], s.lat[1], s.lat[2], s.lat[3]);
+}
+
+int main(int argc, char **argv){
+  const char *index = NULL, *vectors = NULL, *texts = NULL, *out = NULL, *model_arg = NULL;
+  const char *endpoint = "http://127.0.0.1:8080/v1/embeddings";
+  uint32_t K = 10, sample = 0, sweep[32] = { 1, 50, 100, 200, 500, 1000, 2000, 5000 }, nsweep = 8;
+  uint64_t seed = 42;
+  for(int i = 1; i < argc; i++){
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+    if(!v) usage();
+    i++;
+    if     (strcmp(a, "--index") == 0)   index = v;
+    else if(strcmp(a, "--vectors") == 0) vectors = v;
+    else if(strcmp(a, "--texts") == 0)   texts = v;
+    else if(strcmp(a, "--sample") == 0)  sample = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--k") == 0)       K = (uint32_t)strtoul(v, NULL, 10);
+    else if(strcmp(a, "--seed") == 0)    seed = strtoull(v, NULL, 10);
+    else if(strcmp(a, "--out") == 0)     out = v;
+    else if(strcmp(a, "--endpoint") == 0) endpoint = v;
+    else if(strcmp(a, "--model") == 0)   model_arg = v;
+    else if(strcmp(a, "--sweep") == 0){
+      nsweep = 0;
+      for(const char *s = v; *s && nsweep < 32; ){
+        char *end;
+        unsigned long b = strtoul(s, &end, 10);
+        if(end == s) usage();
+        sweep[nsweep++] = (uint32_t)b;
+        s = *end == ',' ? end + 1 : end;
+      }
+    }
+    else usage();
+  }
+  if(!index || !K || (!!vectors + !!texts + !!sample) > 1) usage();
+  if(!vectors && !texts && !sample) sample = 200;
+
+  ChunkIndex *ci = ci_load(index);
+  if(!ci){ fprintf(stderr, "eval_search: cannot load %s\n", index); return 1; }
+  uint32_t dim = ci_get_dim(ci), nq = 0;
+  const char *model = ci_get_model(ci);
+  if(!ci_count(ci)){ fprintf(stderr, "eval_search: %s is empty\n", index); return 1; }
+
+  float *qs = NULL;
+  if(vectors){
+    qs = read_vectors(vectors, dim, &nq);
+  } else {
+    const char *qmodel = model_arg ? model_arg : model;
+    if(strcmp(qmodel, HX_MODEL) == 0 && strcmp(model, HX_MODEL) != 0)
+      fprintf(stderr, "eval_search: warning: %s was built with model \"%s\"; hash-embedded "
+                      "queries do not match it\n", index, model);
+    Embedder e;
+    if(embedder_open(&e, endpoint, qmodel, dim) == 0)
+      qs = texts ? embed_texts(&e, texts, &nq) : sample_chunks(&e, ci, sample, seed, &nq);
+    embedder_close(&e);
+  }
+  if(!qs){ fprintf(stderr, "eval_search: no queries\n"); return 1; }
+
+  // brute-force ground truth
+  uint32_t N = 0;
+  uint8_t *skip;
+  float *emb = read_index_vectors(index, dim, &N, &skip);
+  if(!emb || N != ci_count(ci)){ fprintf(stderr, "eval_search: cannot read the vectors of %s\n", index); return 1; }
+  uint32_t *gt = malloc((size_t)nq * K * sizeof *gt), *gt_n = malloc(nq * sizeof *gt_n);
+  Ranked *all = malloc((size_t)(N ? N : 1) * sizeof *all);
+  if(!gt || !gt_n || !all){ fprintf(stderr, "eval_search: out of memory\n"); return 1; }
+  for(uint32_t i = 0; i < nq; i++)
+    gt_n[i] = brute_top(emb, skip, N, dim, qs + (size_t)i * dim, K, all, gt + (size_t)i * K);
+  free(all); free(emb); free(skip);
+
+  FILE *f = out ? fopen(out, "w") : stdout;
+  if(!f){ fprintf(stderr, "eval_search: cannot write %s\n", out); return 1; }
+  fprintf(f, "{\n  \"timestamp\": %lld,\n", (long long)time(NULL));
+  fprintf(f, "  \"index\": { \"path\": ");
+  print_json_str(f, index);
+  fprintf(f, ", \"model\": ");
+  print_json_str(f, model);
+  fprintf(f, ", \"count\": %u, \"dim\": %u },\n", ci_count(ci), dim);
+  fprintf(f, "  \"queries\": { \"source\": \"%s\", \"count\": %u },\n  \"k\": %u,\n",
+          vectors ? "vectors" : texts ? "texts" : "sample", nq, K);
+  fprintf(f, "  \"results\": [");
+  print_row(f, 1, "exact", NULL, 0, evaluate(ci, qs, nq, dim, K, run_exact, 0, gt, gt_n));
+  for(size_t m = 0; m < NMODE; m++)
+    for(uint32_t b = 0; b < nsweep; b++)
+      print_row(f, 0, MODES[m].name, MODES[m].param, sweep[b],
+                evaluate(ci, qs, nq, dim, K, MODES[m].run, sweep[b], gt, gt_n));
+  fprintf(f, "\n  ]\n}\n");
+  if(f != stdout) fclose(f);
+
+  free(qs); free(gt); free(gt_n);
+  ci_free(ci);
+  return 0;
+}
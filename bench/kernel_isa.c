@@ -0,0 +1,63 @@
+// kernel_isa.c — roofline probes, compiled once per ISA next to cosine_simd.c
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Both probes use GCC/Clang vector extensions at the width of the ISA the
+ *  file is built for (KB_VEC_BYTES), so the compiler picks the same
+ *  registers and FMA instructions the kernels can use.
+ */
+
+#if KB_VEC_BYTES == 4
+typedef float kb_vf;      // one-lane vectors compile to poor code; use float
+#define KB_LANE(v, l) (v)
+#else
+typedef float kb_vf __attribute__((vector_size(KB_VEC_BYTES)));
+#define KB_LANE(v, l) (v)[l]
+#endif
+
+#define KB_CHAINS 12   // independent FMAs in flight: covers latency x ports
+
+uint32_t kb_lanes(void){ return KB_VEC_BYTES / sizeof(float); }
+
+// iters x KB_CHAINS vector FMAs; the result only defeats dead-code removal.
+float kb_fma_loop(uint64_t iters){
+  kb_vf a[KB_CHAINS], b, c;
+  for(uint32_t l = 0; l < KB_VEC_BYTES / sizeof(float); l++){ KB_LANE(b, l) = 0.999f; KB_LANE(c, l) = 1e-3f; }
+  for(int k = 0; k < KB_CHAINS; k++) a[k] = b * (float)(k + 1);
+  for(uint64_t i = 0; i < iters; i++){
+    for(int k = 0; k < KB_CHAINS; k++) a[k] = a[k] * b + c;
+  }
+  kb_vf s = a[0];
+  for(int k = 1; k < KB_CHAINS; k++) s += a[k];
+  float r = 0;
+  for(uint32_t l = 0; l < KB_VEC_BYTES / sizeof(float); l++) r += KB_LANE(s, l);
+  return r;
+}
+
+// Streams n floats (n a multiple of 4 x KB_READ_ACC vectors) as four
+// concurrent sequential streams: kernels read two or more operands at once
+// and the prefetchers track each stream separately. Each stream feeds
+// KB_READ_ACC independent sums, so add latency never caps the loads and
+// the probe measures what the cache or memory delivers. The buffer is read
+// `passes` times.
+#define KB_READ_ACC 4
+
+float kb_read_loop(const float *p, size_t n, uint32_t passes){
+  const size_t w = KB_VEC_BYTES / sizeof(float), step = KB_READ_ACC * w, q = n / 4 / step * step;
+  kb_vf s[4][KB_READ_ACC], v;
+  __builtin_memset(s, 0, sizeof s);
+  for(uint32_t r = 0; r < passes; r++){
+    for(size_t i = 0; i < q; i += step)
+      for(int t = 0; t < 4; t++)
+        for(int a = 0; a < KB_READ_ACC; a++){
+          __builtin_memcpy(&v, p + t * q + i + a * w, sizeof v);
+          s[t][a] += v;
+        }
+  }
+  kb_vf sum = s[0][0];
+  for(int k = 1; k < 4 * KB_READ_ACC; k++) sum += s[k / KB_READ_ACC][k % KB_READ_ACC];
+  float r = 0;
+  for(size_t l = 0; l < w; l++) r += KB_LANE(sum, l);
+  return r;
+}
@@ -0,0 +1,17 @@
+// kernel_names.h — force-included into each per-ISA build of the kernels
+#pragma once
+
+// bench_kernels links cosine_simd.c once per ISA; KB_ISA (scalar, avx2,
+// ...) prefixes every exported symbol so the copies can coexist.
+#define KB_CAT2(a, b) a##_##b
+#define KB_CAT(a, b)  KB_CAT2(a, b)
+#define KB_NAME(f)    KB_CAT(KB_ISA, f)
+
+#define f32_cosine_distance_simd KB_NAME(f32_cosine_distance_simd)
+#define f32_dot_product_simd     KB_NAME(f32_dot_product_simd)
+#define norm_simd                KB_NAME(norm_simd)
+#define i8_dot_product_simd      KB_NAME(i8_dot_product_simd)
+#define f32_quantize_i8_simd     KB_NAME(f32_quantize_i8_simd)
+#define kb_lanes                 KB_NAME(kb_lanes)
+#define kb_fma_loop              KB_NAME(kb_fma_loop)
+#define kb_read_loop             KB_NAME(kb_read_loop)
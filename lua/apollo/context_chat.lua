@@ -9,6 +9,13 @@ local cfg = {
   embedEndpoint= 'http://127.0.0.1:8080/v1/embeddings',
   chatEndpoint = 'http://127.0.0.1:8080/v1/chat/completions',
   topK         = 12, -- number of top ranking results
+  liveBudgetMs = 5,  -- time budget per live-search scan (0 = exact)
+  liveDebounceMs = 60, -- quiet time before a live query is embedded
+  sharedIndex  = true, -- map a prepared copy shared by all editor instances
+  indexDaemon  = false, -- search through apollo-indexd instead of in-process
+  daemonSocket = nil,   -- nil = the daemon's default socket
+  indexBudgetMB = 1024, -- indexes kept in memory across :cd (0 = free on switch)
+  extraProjects = {},   -- other projects whose indexes Q&A also searches
 }
 
 -- ── UI state ─────────────────────────────────────────────────────────────
@@ -18,43 +25,175 @@ local H  = { history_lines = {}, pending = '' }
 -- ── load C index library ─────────────────────────────────────────────────
 local this_file   = debug.getinfo(1,'S').source:sub(2)
 local plugin_root = fn.fnamemodify(this_file, ':p:h:h:h')
-local lib_path    = plugin_root .. '/lib/libchunks.so'
-local chunks_c    = ffi.load(lib_path)
-
-ffi.cdef[[
-  typedef struct ChunkIndex ChunkIndex;
-  ChunkIndex* ci_load(const char *filename);
-  void         ci_free(ChunkIndex *ci);
-  uint32_t ci_search(
-    ChunkIndex *ci,
-    const float *qemb,
-    uint32_t     dim,
-    uint32_t     K,
-    uint32_t    *out_idxs,
-    double      *out_scores
-  );
-  const char* ci_get_file (ChunkIndex*, uint32_t idx);
-  const char* ci_get_text (ChunkIndex*, uint32_t idx);
-  const char* ci_get_parent (ChunkIndex*, uint32_t idx);
-  uint32_t    ci_get_start  (ChunkIndex*, uint32_t idx);
-  uint32_t    ci_get_end    (ChunkIndex*, uint32_t idx);
-]]
+local chunks_c    = require('apollo.libchunks')
 
 -- ── load binary index ─────────────────────────────────────────────────────
 local bin_path = fn.stdpath('data') .. '/' .. cfg.projectName .. '_chunks.bin'
 local ci
+local daemon, dhandle  -- IcConn and index handle when apollo-indexd serves us
+local index_dim
 local has_index = false
+local hasher  -- set when the index was built with the offline hash embedder
+local loading -- CiLoad while the index is read on a background thread
+local ready_cbs = {}  -- work waiting for the index
+local ensure_poll     -- defined with the async poll below
+local LOAD_RUNNING = -2
+
+local dopening = false -- apollo-indexd is being connected to or loading the index
+local dgen = 0         -- bumped by drop_index; late replies for an older index are ignored
+
+-- Connect to apollo-indexd, starting it (detached, so it outlives this
+-- editor and keeps the index warm) when nobody is listening yet. `cb(conn)`
+-- or `cb(nil)`; retries run from a timer, never blocking the editor.
+local function connect_daemon(cb)
+  local c = chunks_c.ic_connect(cfg.daemonSocket)
+  if c ~= nil then return cb(ffi.gc(c, chunks_c.ic_close)) end
+  local bin = plugin_root .. '/lib/apollo-indexd'
+  if fn.executable(bin) == 0 then return cb(nil) end
+  fn.jobstart({ bin, cfg.daemonSocket }, { detach = true })
+  local timer, tries, done = vim.loop.new_timer(), 0, false
+  timer:start(20, 20, vim.schedule_wrap(function()
+    if done then return end
+    tries = tries + 1
+    c = chunks_c.ic_connect(cfg.daemonSocket)
+    if c == nil and tries < 100 then return end
+    done = true
+    timer:stop()
+    timer:close()
+    cb(c ~= nil and ffi.gc(c, chunks_c.ic_close) or nil)
+  end))
+end
+
+-- Replies apollo-indexd still owes us, oldest first. Requests are only
+-- sent; each handler reads its reply once the socket turns readable. The
+-- handlers run in libuv's fast context: FFI only, then vim.schedule.
+local dpend, dpoll = {}, nil
+
+local function daemon_expect(handler)
+  dpend[#dpend+1] = handler
+  if not dpoll then dpoll = vim.loop.new_poll(chunks_c.ic_fd(daemon)) end
+  dpoll:start('r', function()
+    local h = table.remove(dpend, 1)
+    if h then h() end
+    -- idle (or the daemon hung up): stop before it fires again
+    if #dpend == 0 then dpoll:stop() end
+  end)
+end
+
+-- Read every owed reply now, in order, before a blocking round trip.
+local function daemon_drain()
+  while #dpend > 0 do table.remove(dpend, 1)() end
+end
+
+local function daemon_close()
+  if dpoll then dpoll:close() end
+  dpoll, dpend, daemon, dhandle = nil, {}, nil, nil
+end
 
-if fn.filereadable(bin_path) == 1 then
-  ci = chunks_c.ci_load(bin_path)
-  if ci then
-    has_index = true
-    vim.notify('[Apollo] Retrieved chunks.bin, semantic search enabled.')
+local function index_ready(model)
+  has_index = true
+  if model == 'hash' then
+    hasher = ffi.gc(chunks_c.hx_new(index_dim), chunks_c.hx_free)
+  end
+  vim.notify('[Apollo] Retrieved chunks.bin, semantic search enabled.')
+  local cbs = ready_cbs
+  ready_cbs = {}
+  for _, cb in ipairs(cbs) do cb() end
+end
+
+local function poll_load()
+  if not loading then return end
+  local out = ffi.new('ChunkIndex*[1]')
+  local st  = chunks_c.ci_load_result(loading, out)
+  if st == LOAD_RUNNING then return end
+  chunks_c.ci_load_release(loading)
+  loading = nil
+  if st == 0 then
+    ci = out[0]
+    index_dim = chunks_c.ci_get_dim(ci)
+    index_ready(ffi.string(chunks_c.ci_get_model(ci)))
   else
+    ready_cbs = {}
     vim.notify('[Apollo] Failed to load chunks.bin, semantic search disabled.', vim.log.levels.WARN)
   end
-else
-  vim.notify('[Apollo] No chunks.bin found, semantic search disabled.', vim.log.levels.INFO)
+end
+
+-- Block until a background load has finished; true when there is an index.
+local function wait_index()
+  if dopening then vim.wait(60000, function() return not dopening end, 10) end
+  if loading then
+    chunks_c.ci_load_wait(loading)
+    poll_load()
+  end
+  return has_index
+end
+
+-- Run `cb` once the index is available (now, if it already is).
+local function when_ready(cb)
+  if has_index then return cb() end
+  if loading or dopening then ready_cbs[#ready_cbs+1] = cb end
+end
+
+local function load_local()
+  loading = chunks_c.ci_load_async(bin_path, cfg.sharedIndex and 1 or 0)
+  if loading == nil then
+    loading = nil
+    ready_cbs = {}
+    vim.notify('[Apollo] Failed to load chunks.bin, semantic search disabled.', vim.log.levels.WARN)
+  end
+end
+
+local function daemon_failed(msg)
+  dopening = false
+  daemon_close()
+  if msg then vim.notify('[Apollo] '..msg, vim.log.levels.WARN) end
+  vim.notify('[Apollo] apollo-indexd unavailable, searching in-process.', vim.log.levels.WARN)
+  load_local()
+  if loading and not ensure_poll() then wait_index() end
+end
+
+-- The daemon reads the whole index before it answers IX_OPEN, so the
+-- reply is picked up from the poll like any other.
+local function open_daemon(c)
+  daemon = c
+  if chunks_c.ic_open_send(daemon, bin_path) ~= 0 then
+    return daemon_failed(ffi.string(chunks_c.ic_error(daemon)))
+  end
+  local gen = dgen
+  daemon_expect(function()
+    local d = ffi.new('uint32_t[2]')
+    local m = ffi.new('const char*[1]')
+    local h = chunks_c.ic_open_recv(c, d, d + 1, m)
+    local model = h >= 0 and ffi.string(m[0]) or nil
+    local err = h < 0 and ffi.string(chunks_c.ic_error(c)) or nil
+    vim.schedule(function()
+      if gen ~= dgen then return end
+      if h < 0 then return daemon_failed(err) end
+      dopening  = false
+      dhandle   = h
+      index_dim = d[0]
+      index_ready(model)
+    end)
+  end)
+end
+
+-- Startup only queues the load (or the daemon connect); the poll handles
+-- pick up the result, so editor startup does not depend on the size of
+-- the index.
+local function load_index()
+  if fn.filereadable(bin_path) == 0 then
+    vim.notify('[Apollo] No chunks.bin found, semantic search disabled.', vim.log.levels.INFO)
+    return
+  end
+  if cfg.indexDaemon then
+    dopening = true
+    local gen = dgen
+    return connect_daemon(function(c)
+      if gen ~= dgen then return end
+      if c then open_daemon(c) else daemon_failed() end
+    end)
+  end
+  load_local()
 end
 
 -- ── embedding helper ──────────────────────────────────────────────────────
@@ -64,14 +203,30 @@ local function system_json(cmd)
   return fn.json_decode(out)
 end
 
+-- queries go through libchunks' keep-alive client straight into `qbuf`
+local MAX_DIM = 8192
+local qbuf    = ffi.new("float[?]", MAX_DIM)
+local http
+
+local function embed_body(text)
+  return fn.json_encode{ model='gemma3-embed', input={text}, pooling='mean',
+                         encoding_format='base64' }
+end
+
 local function embed(text)
-  local res = system_json{
-    'curl','-s','-X','POST',cfg.embedEndpoint,
-    '-H','Content-Type: application/json',
-    '-d', fn.json_encode{ model='gemma3-embed', input={text}, pooling='mean' }
-  }
-  if res.error then error(res.error.message) end
-  return res.data[1].embedding
+  if hasher ~= nil then
+    chunks_c.hx_embed(hasher, text, #text, qbuf)
+    return qbuf, index_dim
+  end
+  if http == nil then
+    http = chunks_c.hc_open(cfg.embedEndpoint)
+    if http == nil then error('invalid embedEndpoint '..cfg.embedEndpoint) end
+    http = ffi.gc(http, chunks_c.hc_close)
+  end
+  local body = embed_body(text)
+  local dim  = chunks_c.hc_embed(http, body, #body, qbuf, MAX_DIM)
+  if dim < 0 then error(ffi.string(chunks_c.hc_error(http))) end
+  return qbuf, dim
 end
 
 -- simplify query
@@ -99,61 +254,125 @@ end
 
 
 -- ── retrieve via C index ─────────────────────────────────────────────────
-local function retrieve(query)
-
-  if not has_index then
-    return {}  -- or maybe warn once
+-- With `out_src`, hit i comes from sources[out_src[i]] (see multi_sources).
+local function hits_meta(out_i, out_s, cnt, out_src, sources)
+  local results = {}
+  for i = 0, cnt-1 do
+    local idx   = out_i[i]
+    local src   = out_src and sources[out_src[i]]
+    local from  = src and src.ci or ci
+    results[#results+1] = {
+      score    = out_s[i] * 100,
+      project  = src and src.name or cfg.projectName,
+      file     = ffi.string(chunks_c.ci_get_file(from, idx)),
+      parent   = ffi.string(chunks_c.ci_get_parent(from, idx)),
+      start_ln = tonumber(chunks_c.ci_get_start(from, idx)),
+      end_ln   = tonumber(chunks_c.ci_get_end(from, idx)),
+      text     = ffi.string(chunks_c.ci_get_text(from, idx)),
+    }
   end
+  return results
+end
 
-  -- embed query → C float array
-  local qv  = embed(query)
-  local dim = #qv
-  local q_c = ffi.new("float[?]", dim, qv)
+-- Indexes of cfg.extraProjects, opened on first use through the shared
+-- registry. Returns the ChunkIndex* array (0-based, ours first) and the
+-- matching { ci, name } list, or nil when there is nothing to add.
+local extra_open = {}  -- project name -> ChunkIndex* (false when missing)
+local function multi_sources()
+  local sources = { [0] = { ci = ci, name = cfg.projectName } }
+  for _, name in ipairs(cfg.extraProjects) do
+    if extra_open[name] == nil then
+      local path = fn.stdpath('data') .. '/' .. name .. '_chunks.bin'
+      local x = fn.filereadable(path) == 1 and chunks_c.ci_open(path, cfg.sharedIndex and 1 or 0)
+      extra_open[name] = (x and x ~= nil) and x or false
+    end
+    if extra_open[name] and name ~= cfg.projectName then
+      sources[#sources+1] = { ci = extra_open[name], name = name }
+    end
+  end
+  if #sources == 0 then return nil end
+  local arr = ffi.new('ChunkIndex*[?]', #sources + 1)
+  for k = 0, #sources do arr[k] = sources[k].ci end
+  return arr, sources
+end
 
-  -- prepare output buffers
-  local K     = cfg.topK
+-- Read the reply to one ic_search_send; the metadata comes back with the
+-- hits. Returns the hits, or nil and the error.
+local function daemon_read_hits(c, K)
+  local out_n = ffi.new("uint32_t[1]")
   local out_i = ffi.new("uint32_t[?]", K)
   local out_s = ffi.new("double[?]",   K)
-
-  -- call C search
-  local cnt = tonumber(chunks_c.ci_search(ci, q_c, dim, K, out_i, out_s))
-
-  -- collect results
+  if chunks_c.ic_search_recv(c, 1, K, out_n, out_i, out_s) ~= 0 then
+    return nil, ffi.string(chunks_c.ic_error(c))
+  end
   local results = {}
-  for i = 0, cnt-1 do
-    local txt   = ffi.string(chunks_c.ci_get_text(ci, out_i[i]))
-    results[#results+1] = txt
+  for i = 0, out_n[0]-1 do
+    results[#results+1] = {
+      score    = out_s[i] * 100,
+      file     = ffi.string(chunks_c.ic_hit_file(c, i)),
+      parent   = ffi.string(chunks_c.ic_hit_parent(c, i)),
+      start_ln = tonumber(chunks_c.ic_hit_start(c, i)),
+      end_ln   = tonumber(chunks_c.ic_hit_end(c, i)),
+      text     = ffi.string(chunks_c.ic_hit_text(c, i)),
+    }
   end
-
   return results
 end
 
+local function daemon_send(q_c, dim, budget_ms)
+  if chunks_c.ic_search_send(daemon, dhandle, q_c, dim, 1, cfg.topK,
+                             math.floor((budget_ms or 0) * 1000), 1) ~= 0 then
+    error('[Apollo] '..ffi.string(chunks_c.ic_error(daemon)))
+  end
+end
+
+-- Blocking round trip, for the Q&A path that waits on its hits anyway.
+local function daemon_hits(q_c, dim, budget_ms)
+  daemon_drain()
+  daemon_send(q_c, dim, budget_ms)
+  local hits, err = daemon_read_hits(daemon, cfg.topK)
+  if not hits then error('[Apollo] '..err) end
+  return hits
+end
+
+-- Send the search and hand `cb` the hits when the reply arrives.
+local function daemon_search(q_c, dim, budget_ms, cb)
+  daemon_send(q_c, dim, budget_ms)
+  local c, K, gen = daemon, cfg.topK, dgen
+  daemon_expect(function()
+    local hits, err = daemon_read_hits(c, K)
+    vim.schedule(function()
+      if gen ~= dgen then return end
+      if hits then return cb(hits) end
+      vim.notify('[Apollo] '..err, vim.log.levels.WARN)
+    end)
+  end)
+end
+
 local function retrieve_meta(query)
 
-  if not has_index then
+  if not wait_index() then
     return {}  -- or maybe warn once
   end
 
-  local qv  = embed(query)
-  local dim = #qv
-  local q_c = ffi.new("float[?]", dim, qv)
+  local q_c, dim = embed(query)
+  if daemon then return daemon_hits(q_c, dim) end
 
   local K     = cfg.topK
   local out_i = ffi.new("uint32_t[?]", K)
   local out_s = ffi.new("double[?]",   K)
 
-  local cnt = tonumber(chunks_c.ci_search(ci, q_c, dim, K, out_i, out_s))
-  local results = {}
-  for i = 0, cnt-1 do
-    local idx   = out_i[i]
-    results[#results+1] = {
-      score    = out_s[i] * 100,
-      file     = ffi.string(chunks_c.ci_get_file(ci, idx)),
-      parent   = ffi.string(chunks_c.ci_get_parent(ci, idx)),
-      start_ln = tonumber(chunks_c.ci_get_start(ci, idx)),
-      end_ln   = tonumber(chunks_c.ci_get_end(ci, idx)),
-      text     = ffi.string(chunks_c.ci_get_text(ci, idx)),
-    }
+  local results
+  local arr, sources = multi_sources()
+  if arr then
+    -- one call scans every project in parallel and merges the rankings
+    local out_src = ffi.new("uint32_t[?]", K)
+    local cnt = tonumber(chunks_c.ci_search_multi(arr, #sources + 1, q_c, dim, K, 0,
+                                                  out_src, out_i, out_s))
+    results = hits_meta(out_i, out_s, cnt, out_src, sources)
+  else
+    local cnt = tonumber(chunks_c.ci_search(ci, q_c, dim, K, out_i, out_s))
+    results = hits_meta(out_i, out_s, cnt)
   end
 
   table.sort(results, function(a,b)
@@ -163,9 +382,150 @@ local function retrieve_meta(query)
   return results
 end
 
+local function retrieve(query)
+  local results = {}
+  for _, hit in ipairs(retrieve_meta(query)) do
+    results[#results+1] = hit.text
+  end
+  return results
+end
+
+-- ── background search ────────────────────────────────────────────────────
+-- Embeds and scans run on the libchunks thread pool; completions wake a
+-- poll handle on the library's notification fd, and callbacks run
+-- scheduled on the main loop.
+local inflight   = {}   -- searches: { handle, K, cb, shown_partial }
+local embed_jobs = {}   -- embeds:   { handle, cb }
+local async_poll
+local SEARCH_RUNNING = -1
+local JOB_RUNNING    = -2
+local LIVE_CHANNEL   = 1   -- a new live query cancels the previous scan
+local jbuf = ffi.new("float[?]", MAX_DIM)
+
+local function poll_searches()
+  local still = {}
+  for _, req in ipairs(inflight) do
+    local out_i = ffi.new("uint32_t[?]", req.K)
+    local out_s = ffi.new("double[?]",   req.K)
+    local cnt   = chunks_c.ci_search_result(req.handle, out_i, out_s)
+    if cnt == SEARCH_RUNNING then
+      still[#still+1] = req
+      -- deadline searches publish a coarse top K before refining
+      if not req.shown_partial then
+        local pcnt = chunks_c.ci_search_partial(req.handle, out_i, out_s)
+        if pcnt >= 0 then
+          req.shown_partial = true
+          req.cb(hits_meta(out_i, out_s, pcnt), true)
+        end
+      end
+    else
+      chunks_c.ci_search_release(req.handle)
+      -- superseded searches end cancelled and have nobody to tell
+      if cnt >= 0 then req.cb(hits_meta(out_i, out_s, cnt)) end
+    end
+  end
+  inflight = still
+end
+
+local function poll_embeds()
+  local still = {}
+  for _, job in ipairs(embed_jobs) do
+    local dim = chunks_c.hc_job_result(job.handle, jbuf)
+    if dim == JOB_RUNNING then
+      still[#still+1] = job
+    else
+      local err = dim < 0 and ffi.string(chunks_c.hc_job_error(job.handle))
+      chunks_c.hc_job_release(job.handle)
+      job.cb(dim > 0 and jbuf or nil, dim > 0 and dim or err)
+    end
+  end
+  embed_jobs = still
+end
+
+function ensure_poll()
+  if async_poll then return true end
+  local fd = chunks_c.ci_async_fd()
+  if fd < 0 then return false end
+  async_poll = vim.loop.new_poll(fd)
+  async_poll:start('r', vim.schedule_wrap(function()
+    chunks_c.ci_async_drain()
+    poll_load()
+    poll_embeds()
+    poll_searches()
+  end))
+  return true
+end
+
+-- Scan for an already embedded query. `cb` gets the hits (best first) once
+-- the search finishes. A search on a non-zero `channel` cancels the one
+-- before it, whose callback never runs. With a `budget_ms`, `cb(hits,
+-- true)` may first receive provisional hits.
+local function search_async(q_c, dim, cb, channel, budget_ms)
+  if daemon then return daemon_search(q_c, dim, budget_ms, cb) end
+  local h = chunks_c.ci_search_async(ci, q_c, dim, cfg.topK, channel or 0,
+                                    math.floor((budget_ms or 0) * 1000))
+  if h == nil then error('[Apollo] out of memory starting a search') end
+  inflight[#inflight+1] = { handle = h, K = cfg.topK, cb = cb }
+end
+
+-- Embed off the main thread; `cb(vec, dim)` or `cb(nil, err)` runs from the
+-- poll callback, with `vec` valid only during the call. The offline hash
+-- embedder takes microseconds and answers inline.
+local live_http
+local function embed_async(text, cb)
+  if hasher ~= nil then return cb(embed(text)) end
+  if live_http == nil then
+    live_http = chunks_c.hc_open(cfg.embedEndpoint)
+    if live_http == nil then return cb(nil, 'invalid embedEndpoint '..cfg.embedEndpoint) end
+    live_http = ffi.gc(live_http, chunks_c.hc_close)
+  end
+  local body = embed_body(text)
+  local h = chunks_c.hc_embed_async(live_http, body, #body, MAX_DIM)
+  if h == nil then return cb(nil, 'out of memory') end
+  embed_jobs[#embed_jobs+1] = { handle = h, cb = cb }
+end
+
+-- Let go of the current index. Under the memory budget libchunks keeps it
+-- cached, so returning to the project does not read it again.
+local function drop_index()
+  -- searches still scanning hold pointers into the index
+  for _, req in ipairs(inflight) do
+    chunks_c.ci_search_wait(req.handle)
+    chunks_c.ci_search_release(req.handle)
+  end
+  inflight = {}
+  if loading then chunks_c.ci_load_release(loading) end
+  loading, ready_cbs = nil, {}
+  chunks_c.ci_close(ci)
+  dgen, dopening = dgen + 1, false
+  daemon_close()
+  ci, hasher = nil, nil
+  has_index = false
+end
+
+-- Follow :cd into another project unless setup() pinned projectName.
+local follow_cwd = true
+local function switch_project()
+  local name = fn.fnamemodify(fn.getcwd(), ':t')
+  if not follow_cwd or name == cfg.projectName then return end
+  drop_index()
+  cfg.projectName = name
+  bin_path = fn.stdpath('data') .. '/' .. name .. '_chunks.bin'
+  load_index()
+  if loading and not ensure_poll() then wait_index() end
+end
+
 -- ── cleanup on exit ───────────────────────────────────────────────────────
 api.nvim_create_autocmd('VimLeavePre', {
-  callback = function() chunks_c.ci_free(ci) end,
+  callback = function()
+    drop_index()
+    for _, job in ipairs(embed_jobs) do chunks_c.hc_job_release(job.handle) end
+    embed_jobs = {}
+    if async_poll then async_poll:stop() end
+    for _, x in pairs(extra_open) do
+      if x then chunks_c.ci_close(x) end
+    end
+  end,
 })
 
 local function _flatten(buf)
@@ -348,6 +708,61 @@ local function render_live(results)
   api.nvim_buf_set_option(SUI.res_buf,'modifiable',false)
 end
 
+-- Live search pipeline. At most one embed request is in flight; input that
+-- arrives meanwhile waits in `want`, newer input overwriting older, and is
+-- sent when the request returns (whose own result is then dropped as stale).
+local live = { seq = 0, busy = false, want = nil, timer = nil }
+
+local function live_dispatch(q, seq)
+  if not has_index then
+    -- still loading: go once it is in, unless typing has moved on
+    return when_ready(function()
+      if seq == live.seq then live_dispatch(q, seq) end
+    end)
+  end
+  if live.busy then live.want = { q = q, seq = seq } return end
+  live.busy = true
+  embed_async(q, function(vec, dim)
+    live.busy = false
+    if live.want then
+      local w = live.want
+      live.want = nil
+      return live_dispatch(w.q, w.seq)
+    end
+    if seq ~= live.seq then return end
+    if not vec then
+      vim.notify('[Apollo] live search embed failed: '..dim, vim.log.levels.WARN)
+      return
+    end
+    search_async(vec, dim, function(hits)
+      if seq == live.seq then render_live(hits) end
+    end, LIVE_CHANNEL, cfg.liveBudgetMs)
+  end)
+end
+
+local function live_input(buf)
+  if not (has_index or loading) or not ensure_poll() then
+    vim.notify('[Apollo] live search needs a loaded index', vim.log.levels.WARN)
+    return
+  end
+  live.timer = live.timer or vim.loop.new_timer()
+  api.nvim_create_autocmd({'TextChangedI','TextChangedP'},{
+    buffer=buf,
+    callback = function()
+      local l = api.nvim_buf_get_lines(buf,0,-1,false)[1] or ""
+      local q = l:gsub('^Search→%s*','')
+      live.seq = live.seq + 1
+      local seq = live.seq
+      live.timer:stop()
+      if #q > 0 then
+        live.timer:start(cfg.liveDebounceMs, 0, vim.schedule_wrap(function() live_dispatch(q, seq) end))
+      else
+        render_live({})
+      end
+    end,
+  })
+end
+
 local function _open_live_search()
   -- results window
   local h = math.floor(vim.o.lines*0.6)
@@ -371,20 +786,9 @@ local function _open_live_search()
   vim.fn.prompt_setprompt(SUI.inp_buf,'Search→ ')
   api.nvim_command('startinsert')
 
-  -- on every change, re-render
-  api.nvim_create_autocmd({'TextChangedI','TextChangedP'},{
-    buffer=SUI.inp_buf,
-    callback = function()
-      local l = api.nvim_buf_get_lines(SUI.inp_buf,0,-1,false)[1] or ""
-      local q = l:gsub('^Search→%s*','')
-      if #q > 0 then
-        local hits = retrieve_meta(q)
-        render_live(hits)
-      else
-        api.nvim_buf_set_lines(SUI.res_buf,0,-1,false,{})
-      end
-    end,
-  })
+  -- keystrokes → debounce → embed → search → render, all off the main
+  -- thread; only the newest query's results are rendered
+  live_input(SUI.inp_buf)
 end
 
 function M.live_search()
@@ -419,7 +823,7 @@ function M._send()
 
   for i,hit in ipairs(meta) do
     prompt = prompt
-    .. ("----- snippet %2d [%.1f%%] -----\n"):format(i, hit.score)
+    .. ("----- snippet %2d [%.1f%%] %s -----\n"):format(i, hit.score, hit.project or '')
     .. hit.text .. "\n\n"
   end
 
@@ -427,12 +831,68 @@ function M._send()
   _stream(prompt)
 end
 
+-- ── statistics ───────────────────────────────────────────────────────────
+local function fmt_ns(ns)
+  if ns >= 1e9 then return ('%.2fs'):format(ns / 1e9) end
+  if ns >= 1e6 then return ('%.2fms'):format(ns / 1e6) end
+  if ns >= 1e3 then return ('%.1fus'):format(ns / 1e3) end
+  return ('%dns'):format(ns)
+end
+
+local function hist_line(name, h)
+  local n = tonumber(h.count)
+  if n == 0 then return ('  %-7s -'):format(name) end
+  local function q(p) return fmt_ns(tonumber(chunks_c.ci_hist_quantile(h, p))) end
+  return ('  %-7s n=%-8d mean %-9s p50 %-9s p90 %-9s p99 %-9s max %s'):format(
+    name, n, fmt_ns(tonumber(h.sum_ns) / n), q(.5), q(.9), q(.99), fmt_ns(tonumber(h.max_ns)))
+end
+
+-- Counters and latency percentiles of every index this editor has open;
+-- `reset` zeroes them afterwards.
+function M.stats(reset)
+  local open = {}
+  if ci ~= nil then open[#open+1] = { ci = ci, name = cfg.projectName } end
+  for name, x in pairs(extra_open) do
+    if x then open[#open+1] = { ci = x, name = name } end
+  end
+  if #open == 0 then
+    return vim.notify(daemon and '[Apollo] Searches go through apollo-indexd; no in-process index.'
+                             or  '[Apollo] No index loaded.')
+  end
+  local st, lines = ffi.new('CiStats'), {}
+  for _, x in ipairs(open) do
+    chunks_c.ci_stats_get(x.ci, st)
+    local q = tonumber(st.queries)
+    lines[#lines+1] = ('%s  (%d chunks, %.1f MB resident)'):format(x.name,
+      chunks_c.ci_count(x.ci), tonumber(chunks_c.ci_resident_bytes(x.ci)) / 1048576)
+    lines[#lines+1] = ('  queries %d  rows scanned %d (%.0f/query)  pruned %d  rescored %d'):format(
+      q, tonumber(st.rows_scanned), q > 0 and tonumber(st.rows_scanned) / q or 0,
+      tonumber(st.rows_pruned), tonumber(st.rows_rescored))
+    lines[#lines+1] = ('  cache: registry hits %d  prepared %d mapped / %d built'):format(
+      tonumber(st.cache_hits), tonumber(st.prep_hits), tonumber(st.prep_builds))
+    lines[#lines+1] = hist_line('load', st.load)
+    lines[#lines+1] = hist_line('search', st.search)
+    lines[#lines+1] = hist_line('meta', st.meta)
+    if reset then chunks_c.ci_stats_reset(x.ci) end
+  end
+  vim.notify(table.concat(lines, '\n'))
+end
+
 -- ── command wiring ───────────────────────────────────────────────────────
 function M.open() _open_ui() end
 function M.quit() _close(true) end
-function M.setup()
+function M.setup(opts)
+  for k, v in pairs(opts or {}) do cfg[k] = v end
+  follow_cwd = not (opts and opts.projectName)
+  bin_path = fn.stdpath('data') .. '/' .. cfg.projectName .. '_chunks.bin'
+  chunks_c.ci_set_budget(cfg.indexBudgetMB * 1048576)
+  load_index()
+  if loading and not ensure_poll() then wait_index() end
+  api.nvim_create_autocmd('DirChanged', { pattern = 'global', callback = switch_project })
   api.nvim_create_user_command('ApolloAsk', M.open, {})
   api.nvim_create_user_command('ApolloAskQuit', M.quit, {})
   api.nvim_create_user_command('ApolloLive', M.live_search, {})
+  api.nvim_create_user_command('ApolloStats', function(o) M.stats(o.bang) end,
+                               { bang = true })
 end
 return M
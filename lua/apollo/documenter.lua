@@ -17,22 +17,7 @@ local chatEndpoint = 'http://127.0.0.1:8080/v1/chat/completions'
 local throttle_sec = 1.0
 
 -- FFI C INDEX LOADING ----------------------------------------------------
-local this_file   = debug.getinfo(1,'S').source:sub(2)
-local plugin_root = fn.fnamemodify(this_file, ':p:h:h:h')
-local lib_path    = plugin_root .. '/lib/libchunks.so'
-local chunks_c    = ffi.load(lib_path)
-
-ffi.cdef[[
-  typedef struct ChunkIndex ChunkIndex;
-  struct ChunkIndex { uint8_t *arena_base; size_t arena_sz; uint32_t N; void *chunks; };
-  ChunkIndex* ci_load(const char *filename);
-  void         ci_free(ChunkIndex *ci);
-  uint32_t ci_search(ChunkIndex*, const float*, uint32_t, uint32_t, uint32_t*, double*);
-  const char* ci_get_file   (ChunkIndex*, uint32_t);
-  const char* ci_get_ext    (ChunkIndex*, uint32_t);
-  uint32_t    ci_get_start  (ChunkIndex*, uint32_t);
-  const char* ci_get_text   (ChunkIndex*, uint32_t);
-]]
+local chunks_c = require('apollo.libchunks')
 
 -- HELPER: JSON system call ------------------------------------------------
 local function system_json(cmd)
@@ -82,11 +67,12 @@ function M.document()
     error('No chunks.bin found at ' .. bin_path)
   end
 
-  local idx = chunks_c.ci_load(bin_path)
-  if not idx then error('Failed to load chunks.bin at ' .. bin_path) end
+  -- the registry hands back the index context_chat already holds
+  local idx = chunks_c.ci_open(bin_path, 1)
+  if idx == nil then error('Failed to load chunks.bin at ' .. bin_path) end
 
   -- collect entries
-  local total = tonumber(idx.N)
+  local total = tonumber(chunks_c.ci_count(idx))
   local entries = {}
   for i=0,total-1 do
     entries[#entries+1] = {
@@ -127,7 +113,7 @@ function M.document()
   end
 
   out_f:close()
-  chunks_c.ci_free(idx)
+  chunks_c.ci_close(idx)
   print('Documentation generated at '..out_md)
 end
 
@@ -1,10 +1,8 @@
 -- lua/apollo/indexer.lua
 -- Build a binary `chunks.bin` via Tree-sitter + embedding, with directory-picker UI
 
-local scan   = require('plenary.scandir')
 local ftd    = require('plenary.filetype')
 local ts     = require('vim.treesitter')
-local bit = require('bit')
 local ffi = require('ffi')
 local api, fn= vim.api, vim.fn
 local encode = fn.json_encode
@@ -15,6 +13,14 @@ local encode = fn.json_encode
 local cfg = {
   projectName   = fn.fnamemodify(fn.getcwd(), ':t'),
   embedEndpoint = 'http://127.0.0.1:8080/v1/embeddings',
+  embedModel    = 'gemma3-embed',  -- server model, or 'hash' for the offline embedder
+  embeddingDim  = 256,             -- output size of the 'hash' embedder
+  hashFallback  = true,            -- index with 'hash' when the server is unreachable
+  chunkTokens   = 512,             -- window size for files without a parser
+  chunkOverlap  = 2,               -- lines shared by consecutive windows
+  checkpointEvery = 256,           -- chunks between durable checkpoints
+  writeBuffer   = 1048576,         -- bytes buffered by the index writer
+  chunkIdHash   = 'fast',          -- 'fast' (128-bit content hash) or 'sha256'
   maxLines      = 200,
 }
 
@@ -24,158 +30,291 @@ local out_path = fn.stdpath('data')..'/'..cfg.projectName..'_chunks.bin'
 -- Embedding helper
 ---------------------------------------------------------------------
 
--- pack a 32-bit unsigned little-endian
-local function pack_u32(n)
-  return string.char(
-    bit.band(n, 0xFF),
-    bit.band(bit.rshift(n, 8), 0xFF),
-    bit.band(bit.rshift(n, 16), 0xFF),
-    bit.band(bit.rshift(n, 24), 0xFF)
-  )
-end
+-- keep-alive HTTP client from libchunks: one connection reused per embed
+local chunks_c = require('apollo.libchunks')
 
--- reuse ffi to pack float32 array
-local function pack_floats(tbl)
-  local n   = #tbl
-  local buf = ffi.new("float[?]", n, tbl)
-  return ffi.string(buf, n * 4)
-end
-
-local function system_json(cmd)
-  local out = fn.system(cmd)
-  if vim.v.shell_error ~= 0 then error(out) end
-  return fn.json_decode(out)
-end
+local MAX_DIM = 8192
+local vbuf    = ffi.new("float[?]", MAX_DIM)
+local http
+local hasher  -- HashEmbedder while a build uses the offline model
 
+-- Returns the shared vbuf, valid until the next call.
 local function embed(text)
-  local res = system_json{
-    'curl','-s','-X','POST',cfg.embedEndpoint,
-    '-H','Content-Type: application/json',
-    '-d', encode{ model='gemma3-embed', input={text}, pooling='mean' }
-  }
-  if res.error then error(res.error.message) end
-  return res.data[1].embedding
+  if hasher ~= nil then
+    chunks_c.hx_embed(hasher, text, #text, vbuf)
+    return vbuf, cfg.embeddingDim
+  end
+  if http == nil then
+    http = chunks_c.hc_open(cfg.embedEndpoint)
+    if http == nil then error('invalid embedEndpoint '..cfg.embedEndpoint) end
+    http = ffi.gc(http, chunks_c.hc_close)
+  end
+  local body = encode{ model=cfg.embedModel, input={text}, pooling='mean',
+                      encoding_format='base64' }
+  local dim  = chunks_c.hc_embed(http, body, #body, vbuf, MAX_DIM)
+  if dim < 0 then error(ffi.string(chunks_c.hc_error(http))) end
+  return vbuf, dim
 end
 
 local function try_embed(text)
-  local ok, vec = pcall(embed, text)
-  if ok then return vec end
+  local ok, vec, dim = pcall(embed, text)
+  if ok then return vec, dim end
   return nil, tostring(vec)
 end
 
 ---------------------------------------------------------------------
 -- Tree-sitter chunk splitting
 ---------------------------------------------------------------------
-local function get_function_ranges(bufnr, lang)
-  local ok, parser = pcall(ts.get_parser, bufnr, lang)
-  if not ok then return {} end
+-- Definition nodes that become their own chunk, per parser language, and
+-- the containers (classes, namespaces, impls) around them. A container is
+-- not one chunk: its methods are, with the container's name as `parent`,
+-- and the lines between them (fields, declarations) fill the gaps. A
+-- container enclosing no definition is a chunk of its own.
+local node_types = {
+  default    = { 'function_definition', 'function_declaration' },
+  c          = { 'function_definition', 'struct_specifier' },
+  cpp        = { 'function_definition' },
+  rust       = { 'function_item', 'struct_item', 'enum_item' },
+  go         = { 'function_declaration', 'method_declaration', 'type_declaration' },
+  python     = { 'function_definition' },
+  lua        = { 'function_declaration', 'function_definition' },
+  javascript = { 'function_declaration', 'method_definition' },
+  typescript = { 'function_declaration', 'method_definition' },
+  tsx        = { 'function_declaration', 'method_definition' },
+  java       = { 'method_declaration', 'constructor_declaration' },
+}
+
+local container_types = {
+  cpp        = { 'class_specifier', 'struct_specifier', 'namespace_definition' },
+  rust       = { 'impl_item', 'trait_item' },
+  python     = { 'class_definition' },
+  javascript = { 'class_declaration' },
+  typescript = { 'class_declaration', 'interface_declaration' },
+  tsx        = { 'class_declaration', 'interface_declaration' },
+  java       = { 'class_declaration', 'interface_declaration', 'enum_declaration' },
+}
+
+-- Compiled queries per language; false when the language has no parser or
+-- none of its node types exist in the grammar.
+local query_cache = {}
+
+local function get_query(lang)
+  local q = query_cache[lang]
+  if q ~= nil then return q or nil end
+  local pats = {}
+  local function add(types, cap)
+    for _, t in ipairs(types) do
+      local pat = ('(%s) @%s'):format(t, cap)
+      if pcall(ts.query.parse, lang, pat) then pats[#pats+1] = pat end
+    end
+  end
+  add(node_types[lang] or node_types.default, 'def')
+  add(container_types[lang] or {}, 'container')
+  q = #pats > 0 and ts.query.parse(lang, table.concat(pats, '\n'))
+  query_cache[lang] = q or false
+  return q or nil
+end
+
+-- Name of a class/namespace/impl node (impls have a type, not a name).
+local function container_name(node, src)
+  local n = node:field('name')[1] or node:field('type')[1]
+  return n and ts.get_node_text(n, src) or node:type()
+end
+
+-- Dotted names of the containers enclosing lines s..e, outermost first;
+-- '' at top level. `boxes` is in document order.
+local function enclosing(boxes, s, e)
+  local names = {}
+  for _, b in ipairs(boxes) do
+    if b.start_ln <= s and b.end_ln >= e then names[#names+1] = b.name end
+  end
+  return table.concat(names, '.')
+end
+
+-- Parse `src` without creating a buffer and return the outermost
+-- definition ranges (1-based lines, with their `parent`) and the container
+-- ranges.
+local function get_function_ranges(src, ft)
+  if not ft then return {}, {} end
+  local lang = ts.language.get_lang and ts.language.get_lang(ft) or ft
+  local ok, query = pcall(get_query, lang)
+  if not ok or not query then return {}, {} end
+  local okp, parser = pcall(ts.get_string_parser, src, lang)
+  if not okp then return {}, {} end
   local root = parser:parse()[1]:root()
 
-  local types = { 'function_definition' }
-  if lang=='javascript' or lang=='typescript' then
-    table.insert(types,'method_definition')
+  local defs, boxes = {}, {}
+  for id, node in query:iter_captures(root, src, 0, -1) do
+    local sr,_,er,_ = node:range()
+    local r = { start_ln=sr+1, end_ln=er+1 }
+    if query.captures[id]=='container' then
+      r.name = container_name(node, src)
+      boxes[#boxes+1] = r
+    else
+      defs[#defs+1] = r
+    end
   end
-  local pats = vim.tbl_map(function(n) return ('(%s) @def'):format(n) end, types)
-  local query = ts.query.parse(lang, table.concat(pats, '\n'))
-
-  local ranges = {}
-  for id, node in query:iter_captures(root, bufnr, 0, -1) do
-    if query.captures[id]=='def' then
-      local sr,_,er,_ = node:range()
-      table.insert(ranges,{ start_ln=sr+1, end_ln=er+1 })
+  parser:destroy()
+
+  -- containers with nothing to split out stay whole
+  local cands = vim.list_extend({}, defs)
+  for _, b in ipairs(boxes) do
+    local inner = false
+    for _, d in ipairs(defs) do
+      if d.start_ln >= b.start_ln and d.end_ln <= b.end_ln then inner = true break end
+    end
+    if not inner then cands[#cands+1] = { start_ln=b.start_ln, end_ln=b.end_ln, leaf=b } end
+  end
+  table.sort(cands, function(a,b)
+    if a.start_ln ~= b.start_ln then return a.start_ln < b.start_ln end
+    return a.end_ln > b.end_ln
+  end)
+
+  local ranges, last = {}, 0
+  for _, r in ipairs(cands) do
+    -- nested definitions stay part of the outermost one
+    if r.start_ln > last then
+      local outer = {}
+      for _, b in ipairs(boxes) do
+        if b ~= r.leaf then outer[#outer+1] = b end
+      end
+      r.parent = enclosing(outer, r.start_ln, r.end_ln)
+      r.leaf = nil
+      table.insert(ranges, r)
+      last = r.end_ln
     end
   end
-  return ranges
+  return ranges, boxes
 end
 
-local function cover_whole_file(ranges, last_line)
+-- Fill the gaps between `ranges` so every line is in one chunk; a gap
+-- inside a container gets that container as its parent.
+local function cover_whole_file(ranges, last_line, boxes)
   if vim.tbl_isempty(ranges) then
-    return { { start_ln=1, end_ln=last_line } }
+    return { { start_ln=1, end_ln=last_line, parent='' } }
   end
   table.sort(ranges, function(a,b) return a.start_ln<b.start_ln end)
   local out, prev = {}, 1
+  local function gap(s, e)
+    table.insert(out,{ start_ln=s, end_ln=e, parent=enclosing(boxes, s, e) })
+  end
   for _, r in ipairs(ranges) do
-    if r.start_ln>prev then
-      table.insert(out,{ start_ln=prev, end_ln=r.start_ln-1 })
-    end
+    if r.start_ln>prev then gap(prev, r.start_ln-1) end
     table.insert(out, r)
     prev = r.end_ln + 1
   end
-  if prev<=last_line then
-    table.insert(out,{ start_ln=prev, end_ln=last_line })
-  end
+  if prev<=last_line then gap(prev, last_line) end
   return out
 end
 
 ---------------------------------------------------------------------
 -- Collect & write chunks
 ---------------------------------------------------------------------
-local chunks = {}
+-- The build streams records through a ChunkWriter into `<out>.partial`
+-- as they are embedded. Every cfg.checkpointEvery chunks (at a file
+-- boundary) the writer is synced and the files done and byte offset are
+-- recorded in `<out>.ckpt`. A rerun over the same selection with the same
+-- model resumes from there; finishing patches the chunk count into the
+-- header and renames the partial file into place.
+local build = nil
+
+-- Did the server answer and turn down this one input (4xx, an error body,
+-- too large to split further)? Anything else — no connection, a dropped or
+-- truncated reply, a 5xx — means the server is gone or failing, and
+-- skipping would silently lose every chunk until it is back.
+local function rejected(err)
+  return err:match('^HTTP 4%d%d') or err:match('^%s*{') or err:match('too large')
+      or err:match('exceeds buffer')
+end
 
 local function collect_chunk(meta, lines)
   local text = table.concat(lines, '\n')
-  local vec, err = try_embed(text)
+  local vec, dim = try_embed(text)
   if not vec then
+    local err = dim
     if err:match('too large') and #lines>8 then
       local mid = math.floor(#lines/2)
       collect_chunk(vim.tbl_extend('force', meta, { end_ln=meta.start_ln+mid-1 }),
                     vim.list_slice(lines,1,mid))
       collect_chunk(vim.tbl_extend('force', meta, { start_ln=meta.start_ln+mid }),
                     vim.list_slice(lines,mid+1,#lines))
-    else
+    elseif rejected(err) then
       vim.notify(('[Apollo] embed failed %s:%d — %s')
         :format(meta.file,meta.start_ln,err),vim.log.levels.WARN)
+    else
+      error(('embed failed %s:%d — %s'):format(meta.file, meta.start_ln, err), 0)
     end
     return
   end
 
-  local id = fn.sha256(meta.file..meta.start_ln..meta.end_ln..text)
-  table.insert(chunks,{
-    id       = id,
-    parent   = meta.parent or '',
-    file     = meta.file,
-    ext      = fn.fnamemodify(meta.file,':e'),
-    start_ln = meta.start_ln,
-    end_ln   = meta.end_ln,
-    text     = text,
-    vec      = vec,
-  })
+  -- id: content hash computed by the writer
+  if chunks_c.cw_add(build.cw, nil, meta.parent or '', meta.file,
+                     fn.fnamemodify(meta.file,':e'), meta.start_ln, meta.end_ln,
+                     text, #text, vec, dim) ~= 0 then
+    error(ffi.string(chunks_c.cw_error()))
+  end
 end
 
-local function write_chunks_bin()
-  local fh = io.open(out_path, 'wb')
-  assert(fh, 'Could not open ' .. out_path)
-
-  -- header: number of chunks
-  fh:write(pack_u32(#chunks))
-
-  for _, c in ipairs(chunks) do
-    -- length-prefixed strings
-    for _, field in ipairs({ 'id','parent','file','ext' }) do
-      local s = c[field]
-      fh:write(pack_u32(#s), s)
-    end
-
-    -- start_ln, end_ln
-    fh:write(pack_u32(c.start_ln), pack_u32(c.end_ln))
+local function save_checkpoint()
+  local tmp = build.ckpt..'.tmp'
+  fn.writefile({ encode({
+    model  = build.model,
+    sig    = build.sig,
+    offset = build.offset,
+    count  = build.count,
+    done   = vim.tbl_keys(build.done),
+  }) }, tmp)
+  fn.rename(tmp, build.ckpt)
+end
 
-    -- text
-    fh:write(pack_u32(#c.text), c.text)
+-- Resume from a checkpoint written for the same selection and model, or
+-- start a fresh partial file.
+local function open_build(files, model)
+  local sig = fn.sha256(model..'\n'..cfg.chunkIdHash..'\n'..table.concat(files, '\n'))
+  build = {
+    partial = out_path..'.partial', ckpt = out_path..'.ckpt',
+    model = model, sig = sig, offset = 0, count = 0, done = {},
+  }
+  local ok, st = pcall(function() return fn.json_decode(fn.readfile(build.ckpt)[1]) end)
+  if ok and type(st) == 'table' and st.sig == sig and st.model == model
+     and st.offset > 0 and fn.getfsize(build.partial) >= st.offset then
+    build.offset, build.count = st.offset, st.count
+    for _, f in ipairs(st.done) do build.done[f] = true end
+    vim.notify(('[Apollo] resuming build: %d chunks from %d files already written')
+      :format(st.count, #st.done), vim.log.levels.INFO)
+  else
+    fn.delete(build.ckpt)
+  end
+  local cw = chunks_c.cw_open(build.partial, model, build.offset, build.count, cfg.writeBuffer)
+  if cw == nil then error(ffi.string(chunks_c.cw_error())) end
+  build.cw = ffi.gc(cw, chunks_c.cw_close)
+  chunks_c.cw_set_id_hash(build.cw, cfg.chunkIdHash == 'sha256' and 1 or 0)
+end
 
-    -- dimension
-    local dim = #c.vec
-    fh:write(pack_u32(dim))
+-- Make everything written so far durable and checkpoint once every file
+-- in `finished` has all its chunks on disk.
+local function flush_build(finished)
+  local off = chunks_c.cw_flush(build.cw)
+  if off < 0 then error(ffi.string(chunks_c.cw_error())) end
+  build.offset = tonumber(off)
+  build.count  = chunks_c.cw_count(build.cw)
+  for _, f in ipairs(finished) do build.done[f] = true end
+  if build.offset > 0 then save_checkpoint() end
+end
 
-    -- raw float32 values
-    fh:write(pack_floats(c.vec))
+local function finish_build()
+  local cw = ffi.gc(build.cw, nil)
+  local n  = chunks_c.cw_count(cw)
+  build.cw = nil
+  if chunks_c.cw_finish(cw, out_path) ~= 0 then
+    error(ffi.string(chunks_c.cw_error()))
   end
-
-  fh:close()
-  vim.notify(('[Apollo] wrote %d chunks → %s'):format(#chunks, out_path),
+  fn.delete(build.ckpt)
+  vim.notify(('[Apollo] wrote %d chunks → %s'):format(n, out_path),
              vim.log.levels.INFO)
+  build = nil
 end
 
-
 local picker = {
   items  = {},
   mark   = {},
@@ -187,43 +326,36 @@ local ui_buf, ui_win
 ---------------------------------------------------------------------
 -- Build tree of items under cwd (recursive)
 ---------------------------------------------------------------------
-local uv = vim.loop
-local function is_dir(path)
-  local stat = uv.fs_stat(path)
-  return stat and stat.type == 'directory'
-end
+local DW_DIR, DW_HIDDEN = 1, 1
 
+-- one native walk (gitignore-aware, binaries dropped); entries come back
+-- sorted with each directory right before its contents
 local function build_tree(base)
-  local entries = {}
-  for _, path in ipairs(scan.scan_dir(base, { hidden=true })) do
-    local rel = path:sub(#base+2)
-    if rel and rel ~= '' then
-      local parts = vim.split(rel, '/', { plain=true })
-      local node = entries
-      for i, part in ipairs(parts) do
-        local key = table.concat(vim.list_slice(parts,1,i), '/')
-        if not node[key] then
-          node[key] = {
-            name = part,
-            path = base..'/'..key,
-            type = is_dir(base..'/'..key) and 'dir' or 'file',
-            children = {}
-          }
-        end
-        if i < #parts then
-          node = node[key].children
-        end
-      end
-    end
+  local list = chunks_c.dw_walk(base, DW_HIDDEN)
+  if list == nil then return {} end
+  local root, dirs = {}, {}
+  for i = 0, chunks_c.dw_count(list) - 1 do
+    local rel = ffi.string(chunks_c.dw_path(list, i))
+    local parent, name = rel:match('^(.*)/([^/]+)$')
+    local node = {
+      name = name or rel,
+      path = base..'/'..rel,
+      type = chunks_c.dw_type(list, i) == DW_DIR and 'dir' or 'file',
+      children = {},
+    }
+    local siblings = parent and dirs[parent].children or root
+    siblings[#siblings+1] = node
+    if node.type == 'dir' then dirs[rel] = node end
   end
-  return entries
+  chunks_c.dw_free(list)
+  return root
 end
 
 ---------------------------------------------------------------------
 -- Flatten tree to list with indent
 ---------------------------------------------------------------------
 local function flatten_tree(nodes, depth, list)
-  for _, node_data in pairs(nodes) do
+  for _, node_data in ipairs(nodes) do
     table.insert(list, { node=node_data, depth=depth })
     if node_data.type == 'dir' and picker.opened[node_data.path] then
       flatten_tree(node_data.children, depth+1, list)
@@ -283,23 +415,104 @@ local function toggle()
   refresh()
 end
 
-local function commit()
-  local files = vim.tbl_keys(picker.mark)
-  api.nvim_win_close(ui_win,true)
-  api.nvim_buf_delete(ui_buf,{force=true})
-  chunks = {}
-  for _,path in ipairs(files) do
+-- Per file, the lines read once and the line ranges to embed from them:
+-- tree-sitter definitions plus the gaps between them, or, for files no
+-- parser gives ranges for, token-bounded windows from the native chunker
+-- (one parallel call over all of their texts). Later passes slice
+-- plan[path].lines, so the ranges always match the text they came from.
+local function plan_ranges(files)
+  local plan, rest, texts = {}, {}, {}
+  for _, path in ipairs(files) do
     local lines = fn.readfile(path)
-    if #lines>0 then
+    if #lines > 0 then
+      local src  = table.concat(lines, '\n')
       local lang = ftd.detect_from_extension(path) or ftd.detect(path,{})
-      local ranges = cover_whole_file(get_function_ranges(fn.bufadd(path), lang), #lines)
-      for _,r in ipairs(ranges) do
-        collect_chunk({ file=path, parent='', start_ln=r.start_ln, end_ln=r.end_ln },
-                      vim.list_slice(lines,r.start_ln,r.end_ln))
+      local ranges, boxes = get_function_ranges(src, lang)
+      if vim.tbl_isempty(ranges) then
+        plan[path] = { lines = lines, ranges = {} }
+        rest[#rest+1], texts[#texts+1] = path, src
+      else
+        plan[path] = { lines = lines, ranges = cover_whole_file(ranges, #lines, boxes) }
+      end
+    end
+  end
+  if #rest > 0 then
+    local lens = {}
+    for i, t in ipairs(texts) do lens[i] = #t end
+    local cp = chunks_c.tc_chunk_texts(ffi.new("const char*[?]", #texts, texts),
+                                       ffi.new("size_t[?]", #lens, lens),
+                                       #texts, cfg.chunkTokens, cfg.chunkOverlap)
+    if cp == nil then error('[Apollo] out of memory while chunking files') end
+    for i = 0, chunks_c.tc_count(cp) - 1 do
+      local ranges = plan[rest[chunks_c.tc_file(cp, i) + 1]].ranges
+      ranges[#ranges+1] = { start_ln = chunks_c.tc_start(cp, i), end_ln = chunks_c.tc_end(cp, i) }
+    end
+    chunks_c.tc_free(cp)
+  end
+  return plan
+end
+
+-- Pick the embedder for this build: the configured server model, or the
+-- offline hashing embedder when asked for (or when the server is down).
+-- The hashing embedder needs document frequencies, so it sees every chunk
+-- once before anything is embedded.
+local function start_embedder(files, plan)
+  hasher = nil
+  if cfg.embedModel ~= 'hash' then
+    local ok, err = pcall(embed, 'ping')
+    if ok or not cfg.hashFallback then return cfg.embedModel end
+    vim.notify(('[Apollo] embedding server unavailable (%s), indexing with the offline hash embedder')
+      :format(err), vim.log.levels.WARN)
+  end
+  hasher = ffi.gc(chunks_c.hx_new(cfg.embeddingDim), chunks_c.hx_free)
+  for _, path in ipairs(files) do
+    local p = plan[path]
+    for _, r in ipairs(p and p.ranges or {}) do
+      local text = table.concat(vim.list_slice(p.lines, r.start_ln, r.end_ln), '\n')
+      chunks_c.hx_observe(hasher, text, #text)
+    end
+  end
+  return 'hash'
+end
+
+-- Embed and write every file not done yet, checkpointing at file
+-- boundaries.
+local function write_chunks(files, plan)
+  local finished, since = {}, build.count
+  for _,path in ipairs(files) do
+    if not build.done[path] then
+      local p = plan[path]
+      for _,r in ipairs(p and p.ranges or {}) do
+        collect_chunk({ file=path, parent=r.parent or '', start_ln=r.start_ln, end_ln=r.end_ln },
+                      vim.list_slice(p.lines,r.start_ln,r.end_ln))
+      end
+      finished[#finished+1] = path
+      if chunks_c.cw_count(build.cw) - since >= cfg.checkpointEvery then
+        flush_build(finished)
+        finished, since = {}, build.count
       end
     end
   end
-  write_chunks_bin()
+end
+
+local function commit()
+  local files = vim.tbl_keys(picker.mark)
+  table.sort(files)
+  api.nvim_win_close(ui_win,true)
+  api.nvim_buf_delete(ui_buf,{force=true})
+  local plan  = plan_ranges(files)
+  local model = start_embedder(files, plan)
+  open_build(files, model)
+  local ok, err = pcall(write_chunks, files, plan)
+  if not ok then
+    -- the checkpoint still names the last synced file boundary; chunks
+    -- written after it are dropped when the rerun reopens the partial file
+    chunks_c.cw_close(ffi.gc(build.cw, nil))
+    build, hasher = nil, nil
+    error(('[Apollo] build stopped: %s (run it again to resume)'):format(err), 0)
+  end
+  finish_build()
+  hasher = nil
 end
 
 ---------------------------------------------------------------------
@@ -327,4 +540,10 @@ end, {})
 local M = {}
 M.toggle = toggle
 M.commit = commit
+
+function M.setup(opts)
+  for k, v in pairs(opts or {}) do cfg[k] = v end
+  out_path = fn.stdpath('data')..'/'..cfg.projectName..'_chunks.bin'
+end
+
 return M
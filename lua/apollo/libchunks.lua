@@ -0,0 +1,133 @@
+-- lua/apollo/libchunks.lua  –  the one LuaJIT binding of lib/libchunks
+-- Every module requires this instead of declaring its own cdefs, so the
+-- declarations cannot drift apart and the library is loaded once. Indexes
+-- are shared through ci_open/ci_close (a refcounted registry keyed by
+-- canonical path), so features opening the same chunks.bin share it.
+local ffi = require('ffi')
+local fn  = vim.fn
+
+local this_file   = debug.getinfo(1,'S').source:sub(2)
+local plugin_root = fn.fnamemodify(this_file, ':p:h:h:h')
+
+ffi.cdef[[
+  typedef struct ChunkIndex ChunkIndex;
+  ChunkIndex* ci_load(const char *filename);
+  ChunkIndex* ci_load_shared(const char *filename, const char *cache_path);
+  void        ci_free(ChunkIndex *ci);
+  ChunkIndex* ci_open(const char *filename, int shared);
+  void        ci_close(ChunkIndex *ci);
+  void        ci_set_budget(size_t bytes);
+  size_t      ci_resident_bytes(ChunkIndex *ci);
+  uint32_t    ci_count(ChunkIndex *ci);
+  uint32_t    ci_search(ChunkIndex *ci, const float *qemb, uint32_t dim, uint32_t K,
+                        uint32_t *out_idxs, double *out_scores);
+  uint32_t    ci_search_multi(ChunkIndex **cis, uint32_t n, const float *qemb, uint32_t dim,
+                              uint32_t K, uint32_t budget_us,
+                              uint32_t *out_src, uint32_t *out_idxs, double *out_scores);
+  typedef struct {
+    uint64_t count, sum_ns, max_ns;
+    uint64_t buckets[496];  /* CI_HIST_BUCKETS */
+  } CiHist;
+  typedef struct {
+    uint64_t queries;
+    uint64_t rows_scanned, rows_pruned, rows_rescored;
+    uint64_t cache_hits, prep_hits, prep_builds;
+    CiHist   load, search, meta;
+  } CiStats;
+  void        ci_stats_get  (ChunkIndex *ci, CiStats *out);
+  void        ci_stats_reset(ChunkIndex *ci);
+  uint64_t    ci_hist_quantile(const CiHist *h, double q);
+  const char* ci_get_id     (ChunkIndex*, uint32_t idx);
+  uint32_t    ci_get_id_len (ChunkIndex*, uint32_t idx);
+  const char* ci_get_parent (ChunkIndex*, uint32_t idx);
+  const char* ci_get_file   (ChunkIndex*, uint32_t idx);
+  const char* ci_get_ext    (ChunkIndex*, uint32_t idx);
+  uint32_t    ci_get_start  (ChunkIndex*, uint32_t idx);
+  uint32_t    ci_get_end    (ChunkIndex*, uint32_t idx);
+  const char* ci_get_text   (ChunkIndex*, uint32_t idx);
+  const char* ci_get_model  (ChunkIndex*);
+  uint32_t    ci_get_dim    (ChunkIndex*);
+
+  typedef struct CiSearch CiSearch;
+  int       ci_async_fd(void);
+  void      ci_async_drain(void);
+  CiSearch* ci_search_async(ChunkIndex *ci, const float *qemb, uint32_t dim, uint32_t K,
+                            uint32_t channel, uint32_t budget_us);
+  void      ci_search_cancel(CiSearch *s);
+  int       ci_search_result(CiSearch *s, uint32_t *out_idxs, double *out_scores);
+  int       ci_search_partial(CiSearch *s, uint32_t *out_idxs, double *out_scores);
+  void      ci_search_wait(CiSearch *s);
+  void      ci_search_release(CiSearch *s);
+
+  typedef struct CiLoad CiLoad;
+  CiLoad* ci_load_async(const char *filename, int shared);
+  int     ci_load_result(CiLoad *l, ChunkIndex **out);
+  void    ci_load_wait(CiLoad *l);
+  void    ci_load_release(CiLoad *l);
+
+  typedef struct HttpClient HttpClient;
+  HttpClient* hc_open(const char *url);
+  void        hc_close(HttpClient *hc);
+  int         hc_embed(HttpClient *hc, const char *body, size_t len, float *out, uint32_t cap);
+  const char* hc_error(HttpClient *hc);
+
+  typedef struct HcJob HcJob;
+  HcJob*      hc_embed_async(HttpClient *hc, const char *body, size_t len, uint32_t cap);
+  int         hc_job_result(HcJob *job, float *out);
+  const char* hc_job_error(HcJob *job);
+  void        hc_job_release(HcJob *job);
+
+  typedef struct HashEmbedder HashEmbedder;
+  HashEmbedder* hx_new(uint32_t dim);
+  void          hx_free(HashEmbedder *hx);
+  void          hx_observe(HashEmbedder *hx, const char *text, size_t len);
+  void          hx_embed(const HashEmbedder *hx, const char *text, size_t len, float *out);
+
+  typedef struct DirList DirList;
+  DirList*    dw_walk(const char *root, uint32_t flags);
+  uint32_t    dw_count(DirList *dl);
+  const char* dw_path (DirList *dl, uint32_t i);
+  uint32_t    dw_type (DirList *dl, uint32_t i);
+  void        dw_free (DirList *dl);
+
+  typedef struct ChunkPlan ChunkPlan;
+  ChunkPlan* tc_chunk_files(const char **paths, uint32_t n, uint32_t max_tokens, uint32_t overlap);
+  ChunkPlan* tc_chunk_texts(const char **texts, const size_t *lens, uint32_t n,
+                            uint32_t max_tokens, uint32_t overlap);
+  uint32_t   tc_count(ChunkPlan *cp);
+  uint32_t   tc_file (ChunkPlan *cp, uint32_t i);
+  uint32_t   tc_start(ChunkPlan *cp, uint32_t i);
+  uint32_t   tc_end  (ChunkPlan *cp, uint32_t i);
+  void       tc_free (ChunkPlan *cp);
+
+  typedef struct ChunkWriter ChunkWriter;
+  ChunkWriter* cw_open(const char *path, const char *model, uint64_t offset, uint32_t count, size_t cap);
+  int          cw_add(ChunkWriter *cw, const char *id, const char *parent, const char *file, const char *ext,
+                      uint32_t start, uint32_t end, const char *text, size_t text_len,
+                      const float *emb, uint32_t dim);
+  void         cw_set_id_hash(ChunkWriter *cw, int kind);
+  int64_t      cw_flush(ChunkWriter *cw);
+  uint32_t     cw_count(ChunkWriter *cw);
+  int          cw_finish(ChunkWriter *cw, const char *final_path);
+  void         cw_close(ChunkWriter *cw);
+  const char*  cw_error(void);
+
+  typedef struct IcConn IcConn;
+  IcConn*     ic_connect(const char *sock_path);
+  void        ic_close(IcConn *c);
+  int         ic_fd(IcConn *c);
+  int         ic_open_send(IcConn *c, const char *path);
+  int32_t     ic_open_recv(IcConn *c, uint32_t *dim, uint32_t *count, const char **model);
+  int         ic_search_send(IcConn *c, uint32_t handle, const float *q, uint32_t dim, uint32_t nq,
+                             uint32_t K, uint32_t budget_us, int with_meta);
+  int         ic_search_recv(IcConn *c, uint32_t nq, uint32_t K,
+                             uint32_t *out_n, uint32_t *out_idxs, double *out_scores);
+  const char* ic_hit_parent(IcConn *c, uint32_t i);
+  const char* ic_hit_file  (IcConn *c, uint32_t i);
+  uint32_t    ic_hit_start (IcConn *c, uint32_t i);
+  uint32_t    ic_hit_end   (IcConn *c, uint32_t i);
+  const char* ic_hit_text  (IcConn *c, uint32_t i);
+  const char* ic_error(IcConn *c);
+]]
+
+return ffi.load(plugin_root .. '/lib/libchunks.so')
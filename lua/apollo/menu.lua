@@ -14,6 +14,7 @@ local COMMANDS = {
   { cmd = "ApolloAsk", label = "Apollo Context Chat" },
   { cmd = "ApolloLive", label = "Vector Search Context" },
   { cmd = "ApolloBuildChunks", label = "Embed src files" },
+  { cmd = "ApolloStats", label = "Index Statistics" },
   { cmd = "ApolloQuit", label = "Reset Chat" },
   { cmd = "ApolloAskQuit", label = "Reset Context Chat" },
 }
@@ -28,6 +28,7 @@ load('apollo.documenter')
 -- RAG indexer ---------------------------------------------------------------
 load('apollo.indexer', {
   projectName   = vim.fn.fnamemodify(vim.fn.getcwd(), ':t'), -- default: folder name
+  embedModel    = 'gemma3-embed',                            -- or 'hash': offline embedder
   embeddingDim  = 256,                                       -- Gemma-3 dim
   embedEndpoint = 'http://127.0.0.1:8080/v1/embeddings',     -- local embeddings
 })
@@ -0,0 +1,909 @@
+// test_chunks.c — libchunks tests: HTTP client against a loopback stub,
+// known answers for the float parser, base64 decoder and hashes, search
+// against a brute-force reference, async search, the text chunker, the
+// index registry, writer resume, multi-index search, the directory walker
+#include "base64_simd.h"
+#include "chunk_writer.h"
+#include "chunks.h"
+#include "content_hash.h"
+#include "dirwalk.h"
+#include "http_client.h"
+#include "json_floats.h"
+#include "search_async.h"
+#include "text_chunker.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ *  One binary, run by ctest. Each check prints the failing expression and
+ *  the run exits non-zero if any failed.
+ *
+ *  The stub is a single-threaded HTTP/1.1 server on 127.0.0.1 (ephemeral
+ *  port). It answers each request according to `g_mode`, set by the test
+ *  before the request, and counts accepted connections so keep-alive reuse
+ *  and reconnects can be checked.
+ */
+
+static int g_failed;
+
+#define CHECK(cond) do {                                                   \
+    if(!(cond)){ fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); g_failed++; } \
+  } while(0)
+
+/* ---------------------------------------------------------------------
+ * Loopback stub
+ * ------------------------------------------------------------------- */
+
+enum {
+  STUB_LENGTH,     // 200, Content-Length body
+  STUB_CHUNKED,    // 200, chunked body split into small chunks
+  STUB_DROP,       // 200, then close the connection it kept alive
+  STUB_CLOSE,      // 200 with Connection: close
+  STUB_ERROR,      // 500 with an error body
+  STUB_TRUNCATE,   // Content-Length larger than the body sent, then close
+};
+
+static atomic_int g_mode, g_accepts;
+static int        g_listen;
+static char       g_body[8192];   // response body for 200s
+
+static int read_request(int fd){
+  char buf[65536];
+  size_t len = 0;
+  char *hend = NULL;
+  while(!hend){
+    if(len == sizeof buf - 1) return -1;
+    ssize_t r = recv(fd, buf + len, sizeof buf - 1 - len, 0);
+    if(r <= 0) return -1;
+    len += (size_t)r;
+    buf[len] = 0;
+    hend = strstr(buf, "\r\n\r\n");
+  }
+  const char *cl = strstr(buf, "Content-Length:");
+  size_t want = (size_t)(hend + 4 - buf) + (cl ? strtoul(cl + 15, NULL, 10) : 0);
+  while(len < want){
+    ssize_t r = recv(fd, buf, sizeof buf, 0);
+    if(r <= 0) return -1;
+    len += (size_t)r;
+  }
+  return 0;
+}
+
+static void send_all(int fd, const char *p, size_t n){
+  while(n){
+    ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+    if(w <= 0) return;
+    p += w; n -= (size_t)w;
+  }
+}
+
+// Answer one request; returns 0 to keep the connection open.
+static int respond(int fd){
+  char hdr[256];
+  size_t n = strlen(g_body);
+  switch(atomic_load(&g_mode)){
+  case STUB_CHUNKED:
+    send_all(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n", 47);
+    for(size_t i = 0; i < n; i += 7){
+      size_t k = n - i < 7 ? n - i : 7;
+      int hl = snprintf(hdr, sizeof hdr, "%zx\r\n", k);
+      send_all(fd, hdr, (size_t)hl);
+      send_all(fd, g_body + i, k);
+      send_all(fd, "\r\n", 2);
+    }
+    send_all(fd, "0\r\n\r\n", 5);
+    return 0;
+  case STUB_ERROR: {
+    const char *e = "{\"error\":{\"message\":\"input is too large\"}}";
+    int hl = snprintf(hdr, sizeof hdr, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: %zu\r\n\r\n", strlen(e));
+    send_all(fd, hdr, (size_t)hl);
+    send_all(fd, e, strlen(e));
+    return 0;
+  }
+  case STUB_TRUNCATE: {
+    int hl = snprintf(hdr, sizeof hdr, "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", n + 100);
+    send_all(fd, hdr, (size_t)hl);
+    send_all(fd, g_body, n);
+    return -1;
+  }
+  default: {
+    int mode = atomic_load(&g_mode);
+    int hl = snprintf(hdr, sizeof hdr, "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n%s\r\n",
+                      n, mode == STUB_CLOSE ? "Connection: close\r\n" : "");
+    send_all(fd, hdr, (size_t)hl);
+    send_all(fd, g_body, n);
+    return mode == STUB_DROP || mode == STUB_CLOSE ? -1 : 0;
+  }
+  }
+}
+
+static void* stub_main(void *arg){
+  (void)arg;
+  for(;;){
+    int fd = accept(g_listen, NULL, NULL);
+    if(fd < 0) continue;
+    atomic_fetch_add(&g_accepts, 1);
+    while(read_request(fd) == 0 && respond(fd) == 0);
+    close(fd);
+  }
+  return NULL;
+}
+
+// Start the stub; returns its port.
+static int stub_start(void){
+  struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t al = sizeof a;
+  g_listen = socket(AF_INET, SOCK_STREAM, 0);
+  if(g_listen < 0 || bind(g_listen, (struct sockaddr*)&a, sizeof a) != 0 ||
+     listen(g_listen, 8) != 0 || getsockname(g_listen, (struct sockaddr*)&a, &al) != 0)
+    return -1;
+  pthread_t t;
+  if(pthread_create(&t, NULL, stub_main, NULL) != 0) return -1;
+  pthread_detach(t);
+  return ntohs(a.sin_port);
+}
+
+/* ---------------------------------------------------------------------
+ * HTTP client
+ * ------------------------------------------------------------------- */
+
+static void test_http(void){
+  int port = stub_start();
+  CHECK(port > 0);
+  if(port <= 0) return;
+  char url[64];
+  snprintf(url, sizeof url, "http://127.0.0.1:%d/v1/embeddings", port);
+
+  CHECK(hc_open("https://127.0.0.1/") == NULL);
+  CHECK(hc_open("http://:80/") == NULL);
+  CHECK(hc_open("http://host:1234567890/") == NULL);
+
+  HttpClient *hc = hc_open(url);
+  CHECK(hc != NULL);
+  if(!hc) return;
+  hc_set_timeout(hc, 2000);
+  size_t n;
+  const char *r;
+
+  // Content-Length bodies, two requests over one connection
+  strcpy(g_body, "{\"ok\":1}");
+  atomic_store(&g_mode, STUB_LENGTH);
+  r = hc_post(hc, "{}", 2, &n);
+  CHECK(r && n == 8 && strcmp(r, "{\"ok\":1}") == 0);
+  r = hc_post(hc, "{}", 2, &n);
+  CHECK(r && n == 8);
+  CHECK(atomic_load(&g_accepts) == 1);
+
+  // chunked body, reassembled
+  strcpy(g_body, "{\"data\":[{\"embedding\":[0.5,-1.25,2],\"index\":0}]}");
+  atomic_store(&g_mode, STUB_CHUNKED);
+  r = hc_post(hc, "{}", 2, &n);
+  CHECK(r && n == strlen(g_body) && strcmp(r, g_body) == 0);
+  float v[8];
+  CHECK(hc_embed(hc, "{}", 2, v, 8) == 3 && v[0] == 0.5f && v[1] == -1.25f && v[2] == 2.0f);
+  CHECK(atomic_load(&g_accepts) == 1);
+
+  // the server drops the kept-alive connection: the next request
+  // reconnects once and succeeds
+  strcpy(g_body, "{\"ok\":2}");
+  atomic_store(&g_mode, STUB_DROP);
+  r = hc_post(hc, "{}", 2, &n);
+  CHECK(r && strcmp(r, "{\"ok\":2}") == 0);
+  usleep(20000);
+  atomic_store(&g_mode, STUB_LENGTH);
+  r = hc_post(hc, "{}", 2, &n);
+  CHECK(r && strcmp(r, "{\"ok\":2}") == 0);
+  CHECK(atomic_load(&g_accepts) == 2);
+
+  // Connection: close is honoured without a failed request
+  atomic_store(&g_mode, STUB_CLOSE);
+  CHECK(hc_post(hc, "{}", 2, &n) != NULL);
+  atomic_store(&g_mode, STUB_LENGTH);
+  CHECK(hc_post(hc, "{}", 2, &n) != NULL);
+  CHECK(atomic_load(&g_accepts) == 3);
+
+  // base64 embeddings: [1.0, -2.5]
+  strcpy(g_body, "{\"data\":[{\"object\":\"embedding\",\"embedding\":\"AACAPwAAIMA=\",\"index\":0}]}");
+  CHECK(hc_embed(hc, "{}", 2, v, 8) == 2 && v[0] == 1.0f && v[1] == -2.5f);
+  CHECK(hc_embed(hc, "{}", 2, v, 1) == -1);
+
+  // error paths
+  atomic_store(&g_mode, STUB_ERROR);
+  CHECK(hc_post(hc, "{}", 2, &n) == NULL);
+  CHECK(strstr(hc_error(hc), "HTTP 500") && strstr(hc_error(hc), "too large"));
+  CHECK(hc_embed(hc, "{}", 2, v, 8) == -1);
+
+  atomic_store(&g_mode, STUB_TRUNCATE);
+  CHECK(hc_post(hc, "{}", 2, &n) == NULL && strstr(hc_error(hc), "truncated"));
+
+  strcpy(g_body, "{\"data\":[]}");
+  atomic_store(&g_mode, STUB_LENGTH);
+  CHECK(hc_embed(hc, "{}", 2, v, 8) == -1 && strstr(hc_error(hc), "no embedding"));
+
+  // async embed completes through the I/O thread
+  strcpy(g_body, "{\"data\":[{\"embedding\":[0.25,4],\"index\":0}]}");
+  HcJob *j = hc_embed_async(hc, "{}", 2, 8);
+  CHECK(j != NULL);
+  int dim = HC_JOB_RUNNING;
+  for(int i = 0; j && i < 200 && (dim = hc_job_result(j, v)) == HC_JOB_RUNNING; i++) usleep(10000);
+  CHECK(dim == 2 && v[0] == 0.25f && v[1] == 4.0f);
+  hc_job_release(j);
+  hc_close(hc);
+
+  // nobody listening: a port bound but never put in listen state
+  struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t al = sizeof a;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK(fd >= 0 && bind(fd, (struct sockaddr*)&a, sizeof a) == 0 &&
+        getsockname(fd, (struct sockaddr*)&a, &al) == 0);
+  snprintf(url, sizeof url, "http://127.0.0.1:%d/", ntohs(a.sin_port));
+  hc = hc_open(url);
+  CHECK(hc_post(hc, "{}", 2, &n) == NULL && strstr(hc_error(hc), "connect"));
+  hc_close(hc);
+  close(fd);
+}
+
+/* ---------------------------------------------------------------------
+ * Float parser: every value must match strtof (correct rounding)
+ * ------------------------------------------------------------------- */
+
+static void test_floats(void){
+  static const char *lit[] = {
+    "0", "-0", "1", "1.5", "-0.25", "3e2", "0.1", "16777217", "3.4028235e38",
+    "1e-45", "1.17549435e-38", "7.038531e-26", "0.30000001192092896", "123456789",
+    "-2.5E-3", "9.999999e-1", "1e39", "2.2250738585072014e-308",
+  };
+  enum { NL = sizeof lit / sizeof lit[0] };
+  char js[1024] = "[";
+  for(int i = 0; i < NL; i++){ strcat(js, lit[i]); strcat(js, i + 1 < NL ? ", " : "]"); }
+  float out[NL];
+  const char *stop;
+  CHECK(jf_parse_floats(js, js + strlen(js), out, NL, &stop) == NL && *stop == 0);
+  for(int i = 0; i < NL; i++){
+    float want = strtof(lit[i], NULL);
+    if(memcmp(&out[i], &want, 4) != 0){
+      fprintf(stderr, "  %s: got %.9g want %.9g\n", lit[i], out[i], want);
+      g_failed++;
+    }
+  }
+
+  // random decimals at float precision and beyond
+  uint64_t s = 88172645463325252ull;
+  char num[64], arr[96];
+  for(int i = 0; i < 100000; i++){
+    s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+    snprintf(num, sizeof num, "%.*e", 1 + (int)(s % 17),
+             (double)(int64_t)(s >> 11) * 1e-15 * ((s >> 3) % 7 ? 1 : 1e-30));
+    snprintf(arr, sizeof arr, "[%s]", num);
+    float got, want = strtof(num, NULL);
+    if(jf_parse_floats(arr, arr + strlen(arr), &got, 1, NULL) != 1 || memcmp(&got, &want, 4) != 0){
+      fprintf(stderr, "  %s: got %.9g want %.9g\n", num, got, want);
+      g_failed++;
+      break;
+    }
+  }
+
+  // length beyond cap, malformed arrays
+  const char *big = "[1, 2, 3, 4]";
+  CHECK(jf_parse_floats(big, big + strlen(big), out, 2, NULL) == 4 && out[1] == 2.0f);
+  const char *bad[] = { "[1,,2]", "[1 2]", "[1,", "[-]", "[1e]", "[.5]" };
+  for(size_t i = 0; i < sizeof bad / sizeof bad[0]; i++)
+    CHECK(jf_parse_floats(bad[i], bad[i] + strlen(bad[i]), out, NL, NULL) == -1);
+
+  const char *doc = "{\"object\":\"list\",\"data\":[{\"embedding\":[1,2],\"index\":0},"
+                    "{\"index\":1,\"embedding\":[-3.5]}],\"model\":\"m\"}";
+  CHECK(jf_embedding(doc, strlen(doc), 1, out, NL) == 1 && out[0] == -3.5f);
+  CHECK(jf_embedding(doc, strlen(doc), 2, out, NL) == -1);
+}
+
+/* ---------------------------------------------------------------------
+ * base64 (RFC 4648 section 10 vectors, and the SIMD block path)
+ * ------------------------------------------------------------------- */
+
+static size_t b64_encode(const uint8_t *in, size_t n, char *out){
+  static const char A[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for(size_t i = 0; i < n; i += 3){
+    uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < n ? in[i+1] << 8 : 0) | (i + 2 < n ? in[i+2] : 0);
+    out[o++] = A[v >> 18 & 63];
+    out[o++] = A[v >> 12 & 63];
+    out[o++] = i + 1 < n ? A[v >> 6 & 63] : '=';
+    out[o++] = i + 2 < n ? A[v & 63] : '=';
+  }
+  out[o] = 0;
+  return o;
+}
+
+static void test_base64(void){
+  static const char *rfc[][2] = {
+    { "", "" }, { "Zg==", "f" }, { "Zm8=", "fo" }, { "Zm9v", "foo" },
+    { "Zm9vYg==", "foob" }, { "Zm9vYmE=", "fooba" }, { "Zm9vYmFy", "foobar" },
+    { "Zm9vYg", "foob" },  // padding is optional
+  };
+  uint8_t out[4096];
+  for(size_t i = 0; i < sizeof rfc / sizeof rfc[0]; i++){
+    size_t n = strlen(rfc[i][0]);
+    int64_t k = b64_decode(rfc[i][0], n, out, sizeof out);
+    CHECK(k == (int64_t)strlen(rfc[i][1]) && memcmp(out, rfc[i][1], (size_t)k) == 0);
+    CHECK(b64_decoded_len(rfc[i][0], n) == strlen(rfc[i][1]));
+  }
+  CHECK(b64_decode("Zm9v!mFy", 8, out, sizeof out) == -1);
+  CHECK(b64_decode("Zm9vYmFy", 8, out, 5) == -1);
+
+  // every length up to a few SIMD blocks, and a bad byte in every position
+  uint8_t src[1500];
+  char enc[2048];
+  for(size_t i = 0; i < sizeof src; i++) src[i] = (uint8_t)(i * 131 + 7);
+  for(size_t n = 0; n <= sizeof src; n += n < 200 ? 1 : 97){
+    size_t e = b64_encode(src, n, enc);
+    int64_t k = b64_decode(enc, e, out, sizeof out);
+    if(k != (int64_t)n || memcmp(out, src, n) != 0){
+      fprintf(stderr, "  b64 round trip failed at %zu bytes\n", n);
+      g_failed++;
+    }
+  }
+  size_t e = b64_encode(src, 300, enc);
+  for(size_t i = 0; i < e; i++){
+    char c = enc[i];
+    enc[i] = '*';
+    if(b64_decode(enc, e, out, sizeof out) != -1){
+      fprintf(stderr, "  b64 accepted a bad byte at %zu\n", i);
+      g_failed++;
+    }
+    enc[i] = c;
+  }
+
+  float f[4];
+  CHECK(b64_decode_floats("AACAPwAAIMA=", 12, f, 4) == 2 && f[0] == 1.0f && f[1] == -2.5f);
+  CHECK(b64_decode_floats("AACAPwAAIMA=", 12, f, 1) == -1);
+  CHECK(b64_decode_floats("AACAPwA=", 8, f, 4) == -1);  // not whole floats
+}
+
+/* ---------------------------------------------------------------------
+ * Hashes: FIPS 180-2 vectors for SHA-256; pinned values for the 128-bit
+ * hash (stored as chunk ids, so a change must be deliberate)
+ * ------------------------------------------------------------------- */
+
+static void hex(const uint8_t *b, size_t n, char *out){
+  for(size_t i = 0; i < n; i++) sprintf(out + 2 * i, "%02x", b[i]);
+}
+
+static void test_hashes(void){
+  static const struct { const char *in; size_t reps; const char *want; } sha[] = {
+    { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+  };
+  uint8_t d[32];
+  char h[65];
+  for(size_t i = 0; i < sizeof sha / sizeof sha[0]; i++){
+    size_t n = strlen(sha[i].in) * sha[i].reps;
+    char *buf = malloc(n + 1);
+    for(size_t r = 0; r < sha[i].reps; r++) memcpy(buf + r * strlen(sha[i].in), sha[i].in, strlen(sha[i].in));
+    ch_sha256(buf, n, d);
+    hex(d, 32, h);
+    if(strcmp(h, sha[i].want) != 0){
+      fprintf(stderr, "  sha256 vector %zu: got %s\n", i, h);
+      g_failed++;
+    }
+    free(buf);
+  }
+
+  static const struct { size_t len; const char *want; } h128[] = {
+    {   0, "516c4068ec3a9fe69e08e0d3a004e237" },
+    {   3, "18791211b9c75d606ae6eef30890dceb" },
+    {  16, "b13836235af2bceb74b4470e7460a530" },
+    {  17, "5d8c829e9dccfe83a721fa04ae927687" },
+    { 128, "c29a67a0928cbb83a3ce14bf05d48f65" },
+    { 129, "8027abfc2e447de5379557e3e7dfe205" },
+    { 240, "523eea2c318fff61b1d956e10d80cc22" },
+    { 241, "f41e2b857af1fa996e41ad5e5f7220fe" },
+    { 300, "3adf7959508d4498b74eebc08ab85151" },
+  };
+  uint8_t buf[300];
+  for(int i = 0; i < 300; i++) buf[i] = (uint8_t)(i * 7 + 1);
+  for(size_t i = 0; i < sizeof h128 / sizeof h128[0]; i++){
+    ch_hash128(buf, h128[i].len, 0, d);
+    hex(d, 16, h);
+    if(strcmp(h, h128[i].want) != 0){
+      fprintf(stderr, "  hash128 len %zu: got %s\n", h128[i].len, h);
+      g_failed++;
+    }
+  }
+  ch_hash128("hello", 5, 42, d);
+  hex(d, 16, h);
+  CHECK(strcmp(h, "6352b14eaa080bd48ae33e871a2b0bf6") == 0);
+}
+
+/* ---------------------------------------------------------------------
+ * Search: every mode against a brute-force scan and a full sort
+ * ------------------------------------------------------------------- */
+
+static char g_dir[64];   // scratch directory, removed at exit
+
+static const char* tmp_path(const char *name){
+  static char buf[4][128];
+  static int k;
+  char *p = buf[k++ & 3];
+  snprintf(p, sizeof buf[0], "%s/%s", g_dir, name);
+  return p;
+}
+
+static uint64_t g_rng = 0x9e3779b97f4a7c15ull;
+
+static float frand(void){
+  g_rng ^= g_rng << 13; g_rng ^= g_rng >> 7; g_rng ^= g_rng << 17;
+  return (float)((g_rng >> 40) / (double)(1 << 24)) * 2.0f - 1.0f;
+}
+
+static void unit(float *v, uint32_t dim){
+  double n = 0;
+  for(uint32_t d = 0; d < dim; d++){ v[d] = frand(); n += (double)v[d] * v[d]; }
+  float inv = (float)(1.0 / sqrt(n));
+  for(uint32_t d = 0; d < dim; d++) v[d] *= inv;
+}
+
+// Write n random unit vectors to `path`; returns them (caller frees).
+static float* write_index(const char *path, uint32_t n, uint32_t dim){
+  float *emb = malloc((size_t)n * dim * sizeof(float));
+  ChunkWriter *cw = cw_open(path, "test-model", 0, 0, 0);
+  CHECK(cw != NULL);
+  if(!cw) return emb;
+  char text[32];
+  for(uint32_t i = 0; i < n; i++){
+    unit(emb + (size_t)i * dim, dim);
+    int tl = snprintf(text, sizeof text, "chunk %u", i);
+    CHECK(cw_add(cw, NULL, "", i & 1 ? "b.c" : "a.c", "c", i, i + 1, text, (size_t)tl,
+                 emb + (size_t)i * dim, dim) == 0);
+  }
+  CHECK(cw_finish(cw, NULL) == 0);
+  return emb;
+}
+
+typedef struct { double score; uint32_t idx; } Hit;
+
+static int hit_desc(const void *a, const void *b){
+  double x = ((const Hit*)a)->score, y = ((const Hit*)b)->score;
+  return (x < y) - (x > y);
+}
+
+// Top K of a full scan, best first.
+static void brute_top(const float *emb, uint32_t n, uint32_t dim, const float *q, uint32_t K, Hit *out){
+  Hit *all = malloc(n * sizeof(Hit));
+  for(uint32_t i = 0; i < n; i++){
+    double s = 0;
+    for(uint32_t d = 0; d < dim; d++) s += (double)q[d] * emb[(size_t)i * dim + d];
+    all[i] = (Hit){ s, i };
+  }
+  qsort(all, n, sizeof(Hit), hit_desc);
+  memcpy(out, all, K * sizeof(Hit));
+  free(all);
+}
+
+// Hits must be the reference ranking: same k-th score at every rank (ties
+// may swap slots) and each score the slot's own.
+static int same_top(const Hit *want, uint32_t K, const uint32_t *idxs, const double *scores, uint32_t n,
+                    const float *emb, uint32_t dim, const float *q){
+  if(n != K) return 0;
+  Hit got[64];
+  for(uint32_t j = 0; j < n; j++){
+    double s = 0;
+    for(uint32_t d = 0; d < dim; d++) s += (double)q[d] * emb[(size_t)idxs[j] * dim + d];
+    if(fabs(s - scores[j]) > 1e-5) return 0;
+    got[j] = (Hit){ scores[j], idxs[j] };
+  }
+  qsort(got, n, sizeof(Hit), hit_desc);
+  for(uint32_t j = 0; j < n; j++)
+    if(fabs(got[j].score - want[j].score) > 1e-5) return 0;
+  return 1;
+}
+
+static void test_search(void){
+  enum { N = 5000, D = 32, K = 10, Q = 200 };
+  const char *path = tmp_path("search.bin");
+  float *emb = write_index(path, N, D);
+  ChunkIndex *ci = ci_load(path);
+  CHECK(ci != NULL && ci_count(ci) == N && ci_get_dim(ci) == D);
+  if(!ci){ free(emb); return; }
+  CHECK(strcmp(ci_get_model(ci), "test-model") == 0);
+  CHECK(strcmp(ci_get_text(ci, 7), "chunk 7") == 0 && strcmp(ci_get_file(ci, 7), "b.c") == 0);
+  CHECK(ci_get_start(ci, 7) == 7 && ci_get_end(ci, 7) == 8 && ci_get_id_len(ci, 7) == 16);
+
+  float q[D];
+  Hit want[K];
+  uint32_t idxs[K];
+  double scores[K];
+  int bad_exact = 0, bad_deadline = 0, unsorted = 0;
+  uint32_t found = 0;
+  for(int t = 0; t < Q; t++){
+    unit(q, D);
+    brute_top(emb, N, D, q, K, want);
+    uint32_t n = ci_search(ci, q, D, K, idxs, scores);
+    bad_exact += !same_top(want, K, idxs, scores, n, emb, D, q);
+
+    n = ci_search_deadline(ci, q, D, K, 0, idxs, scores, NULL, NULL, NULL);
+    bad_deadline += !same_top(want, K, idxs, scores, n, emb, D, q);
+    for(uint32_t j = 1; j < n; j++) unsorted += scores[j] > scores[j-1];
+
+    // a generous budget rescores the whole candidate pool
+    n = ci_search_deadline(ci, q, D, K, 1000000, idxs, scores, NULL, NULL, NULL);
+    for(uint32_t j = 0; j < n; j++)
+      for(uint32_t w = 0; w < K; w++) found += idxs[j] == want[w].idx;
+  }
+  if(bad_exact) fprintf(stderr, "  ci_search: %d/%d queries off the reference top %d\n", bad_exact, Q, K);
+  if(bad_deadline) fprintf(stderr, "  ci_search_deadline(0): %d/%d queries off\n", bad_deadline, Q);
+  CHECK(bad_exact == 0);
+  CHECK(bad_deadline == 0 && unsorted == 0);
+  CHECK(found >= (uint32_t)(0.95 * Q * K));
+
+  // K larger than the index, and K == 0
+  CHECK(ci_search(ci, q, D, 0, idxs, scores) == 0);
+  uint32_t *all_i = malloc(N * 2 * sizeof(uint32_t));
+  double   *all_s = malloc(N * 2 * sizeof(double));
+  CHECK(ci_search(ci, q, D, N * 2, all_i, all_s) == N);
+  free(all_i); free(all_s);
+  ci_free(ci);
+  free(emb);
+}
+
+/* ---------------------------------------------------------------------
+ * Text chunker: windows cover every line, and chunking a file or the
+ * same text in memory gives the same windows
+ * ------------------------------------------------------------------- */
+
+static void test_chunker(void){
+  static char src[20000];
+  size_t len = 0;
+  uint32_t lines = 0;
+  for(int f = 0; f < 40; f++){
+    len += (size_t)sprintf(src + len, "function f%d(a, b)\n", f);
+    for(int k = 0; k < 6 + f % 5; k++, lines++)
+      len += (size_t)sprintf(src + len, "  local v%d = a * %d + b -- some words here\n", k, k);
+    len += (size_t)sprintf(src + len, "end\n\n");
+    lines += 3;
+  }
+  const char *path = tmp_path("plain.lua");
+  FILE *f = fopen(path, "wb");
+  CHECK(f && fwrite(src, 1, len, f) == len);
+  if(f) fclose(f);
+
+  const char *paths[] = { path, tmp_path("missing.lua") };
+  const char *texts[] = { src, "" };
+  size_t      lens[]  = { len, 0 };
+  ChunkPlan *a = tc_chunk_files(paths, 2, 64, 2);
+  ChunkPlan *b = tc_chunk_texts(texts, lens, 2, 64, 2);
+  CHECK(a && b);
+  if(!a || !b){ tc_free(a); tc_free(b); return; }
+  CHECK(tc_count(a) > 1 && tc_count(a) == tc_count(b));
+  uint32_t next = 1;
+  for(uint32_t i = 0; i < tc_count(a) && i < tc_count(b); i++){
+    CHECK(tc_file(a, i) == 0 && tc_file(b, i) == 0);
+    CHECK(tc_start(a, i) == tc_start(b, i) && tc_end(a, i) == tc_end(b, i));
+    CHECK(tc_start(a, i) <= next && tc_end(a, i) >= tc_start(a, i));
+    next = tc_end(a, i) + 1;
+  }
+  CHECK(next == lines + 1);
+  tc_free(a);
+  tc_free(b);
+}
+
+/* ---------------------------------------------------------------------
+ * Async search: results match the synchronous search, channels cancel
+ * superseded searches, a late cancel does not discard finished results
+ * ------------------------------------------------------------------- */
+
+static void test_async(void){
+  enum { D = 32, K = 10 };
+  ChunkIndex *ci = ci_load(tmp_path("search.bin"));
+  CHECK(ci != NULL);
+  if(!ci) return;
+  float q[D];
+  unit(q, D);
+  uint32_t want_i[K], got_i[K];
+  double   want_s[K], got_s[K];
+  uint32_t want = ci_search_deadline(ci, q, D, K, 0, want_i, want_s, NULL, NULL, NULL);
+
+  CiSearch *s = ci_search_async(ci, q, D, K, 0, 0);
+  CHECK(s != NULL);
+  ci_search_wait(s);
+  ci_search_cancel(s);   // after the fact: the results stand
+  CHECK(ci_search_result(s, got_i, got_s) == (int)want);
+  CHECK(memcmp(got_i, want_i, want * sizeof *got_i) == 0);
+  ci_search_release(s);
+
+  // a finished channel search is released with its last handle, and a
+  // newer search on the channel still runs normally
+  s = ci_search_async(ci, q, D, K, 7, 0);
+  ci_search_wait(s);
+  CHECK(ci_search_result(s, got_i, got_s) == (int)want);
+  ci_search_release(s);
+
+  // a burst on one channel: every search but the newest may be cancelled,
+  // and none may return anything but the exact hits
+  CiSearch *burst[8];
+  for(int i = 0; i < 8; i++) burst[i] = ci_search_async(ci, q, D, K, 7, i & 1 ? 0 : 1000000);
+  for(int i = 0; i < 8; i++){
+    ci_search_wait(burst[i]);
+    int r = ci_search_result(burst[i], got_i, got_s);
+    if(i == 7) CHECK(r == (int)want);
+    else       CHECK(r == CI_SEARCH_CANCELLED || r == (int)want);
+    if(r == (int)want) CHECK(memcmp(got_i, want_i, want * sizeof *got_i) == 0);
+    ci_search_release(burst[i]);
+  }
+
+  // provisional hits of a deadline search are published before the end
+  s = ci_search_async(ci, q, D, K, 0, 1000000);
+  ci_search_wait(s);
+  CHECK(ci_search_partial(s, got_i, got_s) == K);
+  CHECK(ci_search_result(s, got_i, got_s) == (int)want);
+  ci_search_release(s);
+
+  uint64_t v;
+  ci_async_drain();
+  CHECK(read(ci_async_fd(), &v, sizeof v) < 0);   // drained: not readable
+  ci_free(ci);
+}
+
+/* ---------------------------------------------------------------------
+ * Registry: ci_open shares one index per file, ci_close frees it with the
+ * last handle unless a budget keeps it cached, the budget evicts the
+ * least recently used
+ * ------------------------------------------------------------------- */
+
+static uint64_t cache_hits(ChunkIndex *ci){
+  CiStats st;
+  ci_stats_get(ci, &st);
+  return st.cache_hits;
+}
+
+static void test_registry(void){
+  enum { D = 32 };
+  const char *a_path = tmp_path("reg_a.bin"), *b_path = tmp_path("reg_b.bin");
+  free(write_index(a_path, 50, D));
+  free(write_index(b_path, 60, D));
+  char alias[160];
+  snprintf(alias, sizeof alias, "%s/./reg_a.bin", g_dir);
+
+  ChunkIndex *a = ci_open(a_path, 0), *a2 = ci_open(alias, 0);
+  CHECK(a != NULL && a == a2 && ci_count(a) == 50);
+  CHECK(cache_hits(a) == 1);
+  CHECK(ci_resident_bytes(a) >= 50 * D * sizeof(float));
+  ci_close(a2);
+  ci_close(a);
+  CHECK(ci_open(tmp_path("missing.bin"), 0) == NULL);
+
+  // no budget: the last close freed it, the next open loads afresh
+  a = ci_open(a_path, 0);
+  CHECK(a != NULL && cache_hits(a) == 0);
+  ci_close(a);
+
+  // with a budget closed indexes stay cached ...
+  ci_set_budget((size_t)1 << 30);
+  a = ci_open(a_path, 0);
+  ci_close(a);
+  a2 = ci_open(a_path, 0);
+  CHECK(a2 == a && cache_hits(a) == 1);
+  ci_close(a2);
+
+  // ... until it is exceeded: `a` is the least recently used and goes,
+  // `b` (the most recent) stays
+  ChunkIndex *b = ci_open(b_path, 0);
+  CHECK(b != NULL && ci_count(b) == 60);
+  ci_close(b);
+  ci_set_budget(1);
+  b = ci_open(b_path, 0);
+  CHECK(b != NULL && cache_hits(b) == 1);
+  a = ci_open(a_path, 0);
+  CHECK(a != NULL && cache_hits(a) == 0 && ci_count(a) == 50);
+  ci_close(a);
+  ci_close(b);
+  ci_set_budget(0);
+}
+
+/* ---------------------------------------------------------------------
+ * Writer resume: reopening at the last flushed offset drops what came
+ * after it and appends to the records before it
+ * ------------------------------------------------------------------- */
+
+static void test_resume(void){
+  enum { D = 16, N1 = 30, LOST = 7, N2 = 12 };
+  const char *path = tmp_path("resume.bin");
+  float emb[(N1 + N2) * D], lost[D];
+  char text[32];
+  ChunkWriter *cw = cw_open(path, "test-model", 0, 0, 256);
+  CHECK(cw != NULL);
+  if(!cw) return;
+  for(uint32_t i = 0; i < N1; i++){
+    unit(emb + i * D, D);
+    int tl = snprintf(text, sizeof text, "first %u", i);
+    CHECK(cw_add(cw, NULL, "", "r.c", "c", i, i, text, (size_t)tl, emb + i * D, D) == 0);
+  }
+  int64_t off = cw_flush(cw);
+  uint32_t count = cw_count(cw);
+  CHECK(off > 0 && count == N1 && cw_dim(cw) == D);
+  CHECK(cw_add(cw, NULL, "", "r.c", "c", 0, 0, "x", 1, emb, D - 1) == -1);   // dim mismatch
+  // records after the checkpoint, partly drained by the small buffer,
+  // then an unfinished close (a crash)
+  for(uint32_t i = 0; i < LOST; i++){
+    unit(lost, D);
+    CHECK(cw_add(cw, NULL, "", "lost.c", "c", i, i, "lost lost lost lost", 19, lost, D) == 0);
+  }
+  cw_close(cw);
+
+  cw = cw_open(path, "test-model", (uint64_t)off, count, 0);
+  CHECK(cw != NULL && cw_count(cw) == N1 && cw_dim(cw) == D);
+  if(!cw) return;
+  for(uint32_t i = N1; i < N1 + N2; i++){
+    unit(emb + i * D, D);
+    int tl = snprintf(text, sizeof text, "second %u", i);
+    CHECK(cw_add(cw, NULL, "", "r.c", "c", i, i, text, (size_t)tl, emb + i * D, D) == 0);
+  }
+  const char *final = tmp_path("resumed.bin");
+  CHECK(cw_finish(cw, final) == 0);
+
+  ChunkIndex *ci = ci_load(final);
+  CHECK(ci != NULL && ci_count(ci) == N1 + N2 && ci_get_dim(ci) == D);
+  if(!ci) return;
+  int bad = 0;
+  for(uint32_t i = 0; i < N1 + N2; i++){
+    snprintf(text, sizeof text, i < N1 ? "first %u" : "second %u", i);
+    bad += strcmp(ci_get_text(ci, i), text) != 0 || strcmp(ci_get_file(ci, i), "r.c") != 0;
+    // each stored vector is its own best match
+    uint32_t idx;
+    double score;
+    bad += ci_search(ci, emb + i * D, D, 1, &idx, &score) != 1 || idx != i || fabs(score - 1.0) > 1e-5;
+  }
+  CHECK(bad == 0);
+  ci_free(ci);
+}
+
+/* ---------------------------------------------------------------------
+ * Multi-index search: the merge of several indexes is the top K of their
+ * union
+ * ------------------------------------------------------------------- */
+
+static void test_multi(void){
+  enum { D = 32, K = 10, Q = 50 };
+  static const uint32_t n[3] = { 900, 1300, 40 };
+  float *emb[3];
+  ChunkIndex *cis[4];
+  char name[32];
+  for(int i = 0; i < 3; i++){
+    snprintf(name, sizeof name, "multi_%d.bin", i);
+    emb[i] = write_index(tmp_path(name), n[i], D);
+    cis[i] = ci_load(tmp_path(name));
+    CHECK(cis[i] != NULL);
+  }
+  free(write_index(tmp_path("multi_other.bin"), 20, D / 2));
+  cis[3] = ci_load(tmp_path("multi_other.bin"));   // other dim: skipped
+  if(!cis[0] || !cis[1] || !cis[2] || !cis[3]) goto out;
+
+  // reference: the union's embeddings in one array, slots offset per index
+  uint32_t total = n[0] + n[1] + n[2];
+  float *all = malloc((size_t)total * D * sizeof(float));
+  for(uint32_t i = 0, at = 0; i < 3; at += n[i++])
+    memcpy(all + (size_t)at * D, emb[i], (size_t)n[i] * D * sizeof(float));
+
+  float q[D];
+  Hit want[K];
+  uint32_t src[K], idxs[K];
+  double scores[K];
+  int bad = 0;
+  for(int t = 0; t < Q; t++){
+    unit(q, D);
+    brute_top(all, total, D, q, K, want);
+    uint32_t got = ci_search_multi(cis, 4, q, D, K, 0, src, idxs, scores);
+    for(uint32_t j = 0; j < got; j++){
+      bad += src[j] > 2;
+      idxs[j] += src[j] > 0 ? n[0] : 0;
+      idxs[j] += src[j] > 1 ? n[1] : 0;
+      if(j) bad += scores[j] > scores[j-1];
+    }
+    bad += !same_top(want, K, idxs, scores, got, all, D, q);
+  }
+  if(bad) fprintf(stderr, "  ci_search_multi: %d mismatches over %d queries\n", bad, Q);
+  CHECK(bad == 0);
+  free(all);
+out:
+  for(int i = 0; i < 4; i++) if(cis[i]) ci_free(cis[i]);
+  for(int i = 0; i < 3; i++) free(emb[i]);
+}
+
+/* ---------------------------------------------------------------------
+ * Directory walker: ignore rules, hidden and binary files
+ * ------------------------------------------------------------------- */
+
+static void put_file(const char *rel, const char *data, size_t len){
+  char p[192];
+  snprintf(p, sizeof p, "%s/walk/%s", g_dir, rel);
+  FILE *f = fopen(p, "wb");
+  CHECK(f != NULL);
+  if(f){ fwrite(data, 1, len, f); fclose(f); }
+}
+
+// The walk's paths joined with spaces.
+static void walk_list(uint32_t flags, char *out, size_t cap){
+  char root[128];
+  snprintf(root, sizeof root, "%s/walk", g_dir);
+  DirList *dl = dw_walk(root, flags);
+  CHECK(dl != NULL);
+  size_t len = 0;
+  out[0] = 0;
+  for(uint32_t i = 0; dl && i < dw_count(dl); i++)
+    len += (size_t)snprintf(out + len, cap - len, "%s%s%s", i ? " " : "", dw_path(dl, i),
+                            dw_type(dl, i) == DW_DIR ? "/" : "");
+  dw_free(dl);
+}
+
+static void test_dirwalk(void){
+  static const char *dirs[] = { "walk", "walk/.git", "walk/.hid", "walk/build", "walk/src",
+                                "walk/src/build", "walk/src/deep", "walk/src/sub" };
+  char p[192];
+  for(size_t i = 0; i < sizeof dirs / sizeof *dirs; i++){
+    snprintf(p, sizeof p, "%s/%s", g_dir, dirs[i]);
+    CHECK(mkdir(p, 0755) == 0);
+  }
+  const char *gi = "*.log\n!keep.log\nbuild/\n/top.txt\n**/deep/*.tmp\n";
+  put_file(".gitignore", gi, strlen(gi));
+  put_file("src/sub/.ignore", "*.md\n", 5);
+  put_file(".git/HEAD", "ref\n", 4);
+  put_file(".hid/h.c", "x\n", 2);
+  put_file("a.log", "x\n", 2);
+  put_file("keep.log", "x\n", 2);
+  put_file("top.txt", "x\n", 2);
+  put_file("build/o.c", "x\n", 2);
+  put_file("bin.dat", "a\0b", 3);
+  put_file("src/top.txt", "x\n", 2);
+  put_file("src/build/o.c", "x\n", 2);
+  put_file("src/deep/t.tmp", "x\n", 2);
+  put_file("src/deep/t.c", "x\n", 2);
+  put_file("src/sub/r.md", "x\n", 2);
+  put_file("src/sub/s.c", "x\n", 2);
+  put_file("src/r.md", "x\n", 2);
+
+  char got[1024];
+  static const char *want = "keep.log src/ src/deep/ src/deep/t.c src/r.md src/sub/ src/sub/s.c src/top.txt";
+  walk_list(0, got, sizeof got);
+  if(strcmp(got, want) != 0) fprintf(stderr, "  dw_walk: %s\n", got);
+  CHECK(strcmp(got, want) == 0);
+
+  // everything but .git
+  walk_list(DW_HIDDEN | DW_NO_IGNORE | DW_BINARY, got, sizeof got);
+  CHECK(strstr(got, ".git/") == NULL && strstr(got, ".hid/h.c") && strstr(got, "bin.dat")
+        && strstr(got, "a.log") && strstr(got, "build/o.c") && strstr(got, "src/build/o.c")
+        && strstr(got, "src/deep/t.tmp") && strstr(got, "src/sub/r.md"));
+}
+
+int main(void){
+  test_floats();
+  test_base64();
+  test_hashes();
+  test_http();
+
+  snprintf(g_dir, sizeof g_dir, "%s/test_chunks.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+  CHECK(mkdtemp(g_dir) != NULL);
+  test_search();
+  test_async();
+  test_chunker();
+  test_registry();
+  test_resume();
+  test_multi();
+  test_dirwalk();
+  char cmd[128];
+  snprintf(cmd, sizeof cmd, "rm -rf '%s'", g_dir);
+  if(system(cmd) != 0) fprintf(stderr, "could not remove %s\n", g_dir);
+  if(g_failed) fprintf(stderr, "%d check(s) failed\n", g_failed);
+  else         printf("all checks passed\n");
+  return g_failed != 0;
+}